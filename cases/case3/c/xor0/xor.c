@@ -25,7 +25,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "../../mlp.h"
+#include "../../../../src/mlp/c/mlp.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
@@ -44,6 +44,7 @@ int main(int argc, char ** argv)
 
 	/* Configuration of Training Data */
 	training * trainingData = (training*) malloc(sizeof(training));
+	trainingInit(trainingData);
 	trainingData->nlayers = 3;
 	trainingData->neurons = (int *) \
 	malloc(sizeof(int)*trainingData->nlayers);
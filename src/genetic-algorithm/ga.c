@@ -26,72 +26,108 @@
  */
 
 #include "ga.h"
+#include <pthread.h>
+#include <stdatomic.h>
 
-int ga_init(population * p, int var)
+/* Random stream of the thread in the fitness */
+static _Thread_local gaRandom * threadRandom = NULL;
+
+static uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/* State from splitmix64 of the seed */
+void randomSeed(gaRandom * r, uint64_t seed)
 {
-#if POPULATION_CONST == 1
-    p->chromosomes = (TYPE **) \
-        malloc(sizeof(TYPE*)*POPULATION_INIT);
-    if(p->chromosomes == NULL)
-            return 1;
-    
     int i;
-    for(i=0;i<POPULATION_INIT;i++)
-    { 
-        p->chromosomes[i] = (TYPE *) \
-            malloc(sizeof(TYPE)*var);
-        if(p->chromosomes[i] == NULL)
-            return 1;
+    uint64_t z;
+
+    for(i=0;i<4;i++)
+    {
+        seed += 0x9E3779B97F4A7C15ULL;
+        z = seed;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        r->s[i] = z ^ (z >> 31);
     }
+}
 
-    p->scores = (float *) \
-        malloc(sizeof(float)*POPULATION_INIT);
-    if(p->scores == NULL)
-        return 1;
+uint64_t randomNext(gaRandom * r)
+{
+    uint64_t * s = r->s;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
 
-	p->roulette_flags = (char *) \
-        malloc(sizeof(char)*POPULATION_INIT);
-    if(p->roulette_flags == NULL)
-        return 1;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
 
-#else
-    p->chromosomes = (TYPE **) \
-        malloc(sizeof(TYPE*)*POPULATION_MAX);
-    if(p->chromosomes == NULL)
-            return 1;
-    
+    return result;
+}
+
+void randomJump(gaRandom * r)
+{
+    static const uint64_t jump[4] = {0x180EC6D33CFD0ABAULL, \
+        0xD5A61266F0C9392CULL, 0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL};
+    uint64_t s[4] = {0, 0, 0, 0};
     int i;
-    for(i=0;i<POPULATION_MAX;i++)
+    int b;
+
+    for(i=0;i<4;i++)
     {
-        p->chromosomes[i] = (TYPE *) \
-            malloc(sizeof(TYPE)*var);
-        if(p->chromosomes[i] == NULL)
-            return 1;
+        for(b=0;b<64;b++)
+        {
+            if(jump[i] & ((uint64_t) 1 << b))
+            {
+                s[0] ^= r->s[0];
+                s[1] ^= r->s[1];
+                s[2] ^= r->s[2];
+                s[3] ^= r->s[3];
+            }
+            randomNext(r);
+        }
     }
+    memcpy(r->s,s,sizeof(s));
+}
 
-    p->scores = (float *) \
-        malloc(sizeof(float)*POPULATION_MAX);
-    if(p->scores == NULL)
-        return 1;
+float randomFloat(gaRandom * r)
+{
+    /* 24 bits of the float mantissa */
+    return (randomNext(r) >> 40) * (1.0f/16777216.0f);
+}
 
-	p->roulette_flags = (char *) \
-        malloc(sizeof(char)*POPULATION_MAX);
-    if(p->roulette_flags == NULL)
-        return 1;
+int randomInt(gaRandom * r, int n)
+{
+    /* Multiply and shift of 32 bits, no division */
+    return (int) (((randomNext(r) >> 32) * (uint64_t) n) >> 32);
+}
 
-#endif 
-    p->variables = var;
-    p->size = POPULATION_INIT;
-    p->elitSize = ceil(POPULATION_INIT*ELIT_PERCENT);
+gaRandom * ga_random(void)
+{
+    return threadRandom;
+}
 
+/* Initial population, all bits of the genes are random */
+static void initialGenes(population * p)
+{
+    int i;
     int v;
-    srand (time(NULL));
+
+    p->size = POPULATION_INIT;
+    for(i=0; i < p->capacity; i++)
+        p->index[i] = i;
+    ga_pointers(p);
+
 #if DEBUG_MODE == 1
     for(i=0; i < p->size; i++)
     {
-        for(v=0;v<var;v++)
+        for(v=0;v<p->variables;v++)
         {
-            p->chromosomes[i][v] = rand();
+            p->chromosomes[i][v] = (TYPE) randomNext(p->random);
             printf("Chromosome %d - x%d: %u\n", \
                 i,v+1,p->chromosomes[i][v]);
         }
@@ -99,24 +135,159 @@ int ga_init(population * p, int var)
     printf("\n");
 #else
     for(i=0; i < p->size; i++)
-        for(v=0;v<var;v++)
-            p->chromosomes[i][v] = rand();
+        for(v=0;v<p->variables;v++)
+            p->chromosomes[i][v] = (TYPE) randomNext(p->random);
 #endif
+}
 
-    return 0;
-}   
+/* Seed without GA_SEED: the time and a counter of the calls, so the
+ * populations of the same second differ */
+static uint64_t timeSeed(void)
+{
+    static uint64_t calls = 0;
+    calls++;
+    return (uint64_t) time(NULL) ^ (calls*0x9E3779B97F4A7C15ULL);
+}
 
-void ga_end(population * p)
+void ga_seed(population * p, uint64_t seed)
 {
     int i;
-#if POPULATION_CONST == 1 
-    for(i=0; i < POPULATION_INIT; i++)
+
+    randomSeed(&p->random[0],seed);
+    for(i=1;i<p->streams;i++)
+    {
+        p->random[i] = p->random[i-1];
+        randomJump(&p->random[i]);
+    }
+    initialGenes(p);
+}
+
+/* Fitness function of an evaluation, func or batch */
+typedef struct
+{
+    float (*func)(TYPE*);
+    gaBatch batch;
+    void * arg;
+    float * inf;
+    float * sup;
+} gaJob;
+
+/* Threads of the fitness, the calling thread is the thread 0 */
+typedef struct gaPool gaPool;
+
+typedef struct
+{
+    gaPool * pool;
+    int id;
+} gaWorker;
+
+struct gaPool
+{
+    int nthreads;
+    pthread_t * threads;
+    gaWorker * workers;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    long int generation;
+    int pending;
+    int quit;
+    gaJob * job;
+    population * p;
+    atomic_int next;
+};
+
+int ga_init(population * p, int var)
+{
+#if POPULATION_CONST == 1
+    int capacity = POPULATION_INIT;
 #else
-    for(i=0; i < POPULATION_MAX; i++)
+    int capacity = POPULATION_MAX;
 #endif
-    free(p->chromosomes[i]);
+    size_t bytes = sizeof(TYPE)*capacity*var;
+    void * genes = NULL;
+    void * next = NULL;
+
+    memset(p,0,sizeof(population));
+    if(posix_memalign(&genes,GA_ALIGN,bytes) || \
+        posix_memalign(&next,GA_ALIGN,bytes))
+    {
+        free(genes);
+        return 1;
+    }
+    p->genes = (TYPE *) genes;
+    p->next = (TYPE *) next;
+
+    p->chromosomes = (TYPE **) \
+        malloc(sizeof(TYPE*)*capacity);
+    p->index = (int *) \
+        malloc(sizeof(int)*capacity);
+    p->scores = (float *) \
+        malloc(sizeof(float)*capacity);
+    p->sortKeys = (uint32_t *) \
+        malloc(sizeof(uint32_t)*2*capacity);
+    p->sortIndex = (int *) \
+        malloc(sizeof(int)*capacity);
+    p->random = (gaRandom *) \
+        malloc(sizeof(gaRandom));
+    p->wheel = (float *) \
+        malloc(sizeof(float)*capacity);
+    p->alias = (int *) \
+        malloc(sizeof(int)*capacity);
+    p->picks = (int *) \
+        malloc(sizeof(int)*capacity);
+    if(p->chromosomes == NULL || p->index == NULL || \
+        p->scores == NULL || p->sortKeys == NULL || \
+        p->sortIndex == NULL || p->random == NULL || \
+        p->wheel == NULL || p->alias == NULL || p->picks == NULL)
+    {
+        ga_end(p);
+        return 1;
+    }
+
+    p->variables = var;
+    p->size = POPULATION_INIT;
+    p->capacity = capacity;
+    p->elitSize = ceil(POPULATION_INIT*ELIT_PERCENT);
+    p->selection = GA_SELECTION;
+    p->tournament = TOURNAMENT_SIZE;
+    p->parents = 0;
+    p->pick = 0;
+
+    /* The streams of the threads are seeded with the population */
+    p->streams = 1;
+    memset(p->random,0,sizeof(gaRandom));
+    if(ga_threads(p,FITNESS_THREADS,FITNESS_CHUNK))
+    {
+        ga_end(p);
+        return 1;
+    }
+    ga_seed(p,GA_SEED ? (uint64_t) GA_SEED : timeSeed());
+
+    return 0;
+}   
 
+void ga_end(population * p)
+{
+    ga_threads(p,1,0);
+    free(p->genes);
+    free(p->next);
+    free(p->chromosomes);
+    free(p->index);
     free(p->scores);
+    free(p->sortKeys);
+    free(p->sortIndex);
+    free(p->random);
+    free(p->wheel);
+    free(p->alias);
+    free(p->picks);
+}
+
+void ga_pointers(population * p)
+{
+    int i;
+    for(i=0; i < p->capacity; i++)
+        p->chromosomes[i] = p->genes + (size_t) p->index[i]*p->variables;
 }
 
 float normalize(population * p)
@@ -149,13 +320,248 @@ float normalize(population * p)
 	return sum;
 }
 
-void fitness(float(*func)(TYPE*),population * p)
+/* Scores of the positions [begin,end) */
+static void scoreRange(gaJob * job, population * p, int begin, int end, \
+    float * x, float * out)
+{
+    int i;
+    int n;
+
+    if(job->batch == NULL)
+    {
+        for(i=begin;i<end;i++) 
+            p->scores[i] = -1 * job->func(p->chromosomes[i]);
+        return;
+    }
+
+    /* Blocks of decoded variables */
+    for(;begin<end;begin+=n)
+    {
+        n = end - begin < GA_BATCH_BLOCK ? end - begin : GA_BATCH_BLOCK;
+        decode(p->chromosomes + begin,n,p->variables,job->inf,job->sup, \
+            x,GA_BATCH_BLOCK);
+        job->batch(x,n,GA_BATCH_BLOCK,out,job->arg);
+        for(i=0;i<n;i++)
+            p->scores[begin+i] = -1 * out[i];
+    }
+}
+
+/* Scores of the chromosomes of a thread */
+static void evaluate(gaJob * job, gaPool * pool, population * p, \
+    int id, int nthreads)
+{
+    int begin;
+    int end;
+    void * x = NULL;
+    void * out = NULL;
+
+    threadRandom = &p->random[id];
+
+    /* Memory of a block of the batch function */
+    if(job->batch != NULL && \
+        (posix_memalign(&x,GA_ALIGN,sizeof(float)*GA_BATCH_BLOCK*p->variables) \
+        || posix_memalign(&out,GA_ALIGN,sizeof(float)*GA_BATCH_BLOCK)))
+    {
+        /* Without memory the scores are the worst */
+        for(begin=0;begin<p->size;begin++)
+            p->scores[begin] = -INFINITY;
+        free(x);
+        return;
+    }
+
+    if(p->chunk <= 0 || pool == NULL)
+    {
+        /* Static: one block by thread */
+        begin = (int) ((long int) p->size*id/nthreads);
+        end = (int) ((long int) p->size*(id+1)/nthreads);
+        scoreRange(job,p,begin,end,(float *) x,(float *) out);
+    }
+    else
+    {
+        /* Dynamic: next chunk of the shared counter */
+        while((begin = atomic_fetch_add(&pool->next,p->chunk)) < p->size)
+        {
+            end = begin + p->chunk < p->size ? begin + p->chunk : p->size;
+            scoreRange(job,p,begin,end,(float *) x,(float *) out);
+        }
+    }
+
+    threadRandom = NULL;
+    free(x);
+    free(out);
+}
+
+static void * worker(void * arg)
+{
+    gaWorker * w = (gaWorker *) arg;
+    gaPool * pool = w->pool;
+    long int generation = 0;
+
+    while(1)
+    {
+        pthread_mutex_lock(&pool->lock);
+        while(!pool->quit && pool->generation == generation)
+            pthread_cond_wait(&pool->start,&pool->lock);
+        if(pool->quit)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        evaluate(pool->job,pool,pool->p,w->id,pool->nthreads);
+
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->pending == 0)
+            pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void poolDestroy(gaPool * pool)
 {
     int i;
-    for(i=0;i<p->size;i++) 
-        p->scores[i] = -1 * func(p->chromosomes[i]);
- 
-    quicksort(p->scores,p->chromosomes,p->variables,0,p->size-1);
+    if(pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for(i=1; i < pool->nthreads; i++)
+        pthread_join(pool->threads[i],NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool);
+}
+
+int ga_threads(population * p, int threads, int chunk)
+{
+    gaPool * pool;
+    int i;
+
+    gaRandom * random;
+
+    poolDestroy((gaPool *) p->pool);
+    p->pool = NULL;
+    p->chunk = chunk;
+    if(threads <= 1)
+        return 0;
+
+    /* One random stream by thread, jumps of the stream 0 */
+    if(threads > p->streams)
+    {
+        random = (gaRandom *) realloc(p->random,sizeof(gaRandom)*threads);
+        if(random == NULL)
+            return 1;
+        p->random = random;
+        for(i=p->streams;i<threads;i++)
+        {
+            p->random[i] = p->random[i-1];
+            randomJump(&p->random[i]);
+        }
+        p->streams = threads;
+    }
+
+    pool = (gaPool *) calloc(1,sizeof(gaPool));
+    if(pool == NULL)
+        return 1;
+    pool->threads = (pthread_t *) malloc(sizeof(pthread_t)*threads);
+    pool->workers = (gaWorker *) malloc(sizeof(gaWorker)*threads);
+    if(pool->threads == NULL || pool->workers == NULL)
+    {
+        free(pool->threads);
+        free(pool->workers);
+        free(pool);
+        return 1;
+    }
+    pthread_mutex_init(&pool->lock,NULL);
+    pthread_cond_init(&pool->start,NULL);
+    pthread_cond_init(&pool->done,NULL);
+
+    /* The calling thread is the thread 0 */
+    pool->nthreads = 1;
+    for(i=1; i < threads; i++)
+    {
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        if(pthread_create(&pool->threads[i],NULL,worker,&pool->workers[i]))
+        {
+            poolDestroy(pool);
+            return 1;
+        }
+        pool->nthreads++;
+    }
+
+    p->pool = pool;
+    return 0;
+}
+
+/* Scores of all chromosomes, in the threads of the pool */
+static void score(gaJob * job, population * p)
+{
+    gaPool * pool = (gaPool *) p->pool;
+
+    if(pool == NULL)
+    {
+        evaluate(job,NULL,p,0,1);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->job = job;
+    pool->p = p;
+    atomic_store(&pool->next,0);
+    pool->pending = pool->nthreads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    evaluate(job,pool,p,0,pool->nthreads);
+
+    pthread_mutex_lock(&pool->lock);
+    while(pool->pending > 0)
+        pthread_cond_wait(&pool->done,&pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Sort after the scores */
+static void rank(population * p)
+{
+    /* Selections by rank */
+    if(p->selection == GA_SELECT_NORMAL || p->selection == GA_SELECT_RANK)
+        sortScores(p->scores,p->index,p->size,p->sortKeys,p->sortIndex);
+    else
+        selectTop(p->scores,p->index,p->size, \
+            p->elitSize > 0 ? p->elitSize : 1,p->sortKeys,p->sortIndex);
+    ga_pointers(p);
+}
+
+void fitness(float(*func)(TYPE*),population * p)
+{
+    gaJob job;
+    job.func = func;
+    job.batch = NULL;
+    score(&job,p);
+    rank(p);
+}
+
+void fitnessBatch(gaBatch func, void * arg, float * inf, float * sup, \
+    population * p)
+{
+    gaJob job;
+    job.func = NULL;
+    job.batch = func;
+    job.arg = arg;
+    job.inf = inf;
+    job.sup = sup;
+    score(&job,p);
+    rank(p);
 }
 
 float quantized(TYPE chromosome)
@@ -180,66 +586,287 @@ float interpret(TYPE chromosome, float inf, float sup)
 	return (quantized(chromosome)*(sup-inf)+inf);
 }
 
+/* Bits in reverse order, the first bit has the largest weight */
+static TYPE reverse(TYPE c)
+{
+    c = ((c >> 1) & (TYPE) 0x5555555555555555ULL) | \
+        ((c & (TYPE) 0x5555555555555555ULL) << 1);
+    c = ((c >> 2) & (TYPE) 0x3333333333333333ULL) | \
+        ((c & (TYPE) 0x3333333333333333ULL) << 2);
+    c = ((c >> 4) & (TYPE) 0x0F0F0F0F0F0F0F0FULL) | \
+        ((c & (TYPE) 0x0F0F0F0F0F0F0F0FULL) << 4);
+#if UINT_SZ > 8
+    c = ((c >> 8) & (TYPE) 0x00FF00FF00FF00FFULL) | \
+        ((c & (TYPE) 0x00FF00FF00FF00FFULL) << 8);
+#endif
+#if UINT_SZ > 16
+    c = ((c >> 16) & (TYPE) 0x0000FFFF0000FFFFULL) | \
+        ((c & (TYPE) 0x0000FFFF0000FFFFULL) << 16);
+#endif
+#if UINT_SZ > 32
+    c = (c >> 32) | (c << 32);
+#endif
+    return c;
+}
+
+void decode(TYPE ** chromosomes, int n, int variables, float * inf, \
+    float * sup, float * x, int stride)
+{
+    int i;
+    int v;
+    double scale = ldexp(1.0,-UINT_SZ);
+    double half = ldexp(1.0,-(UINT_SZ+1));
+    double range;
+    float * xv;
+
+    /* Same value of quantized: bit i (from 0) has the weight 2^-(i+1) */
+    for(v=0;v<variables;v++)
+    {
+        xv = x + (size_t) v*stride;
+        range = (double) sup[v] - inf[v];
+        for(i=0;i<n;i++)
+        {
+            xv[i] = (float) (((double) reverse(chromosomes[i][v])*scale + \
+                half)*range + inf[v]);
+        }
+    }
+}
+
+int ga_selection(population * p, int method, int tournament)
+{
+    if(method < GA_SELECT_RANDOM || method > GA_SELECT_RANK)
+        return 1;
+    p->selection = method;
+    p->tournament = tournament < 2 ? TOURNAMENT_SIZE : tournament;
+    return 0;
+}
+
+/* Offset of the scores to be positive, like normalize */
+static float ga_offset(population * p, int n)
+{
+    int i;
+    float offset = 0;
+
+    for(i=0;i<n;i++)
+    {
+        if(p->scores[i] < offset)
+            offset = p->scores[i];
+    }
+    return offset;
+}
+
+/* Cumulative scores in the wheel */
+/* Return the total, 0 = all scores are equal */
+static float cumulative(population * p, int n)
+{
+    int i;
+    float offset = ga_offset(p,n);
+    double sum = 0;
+
+    for(i=0;i<n;i++)
+    {
+        sum += p->scores[i] - offset;
+        p->wheel[i] = (float) sum;
+    }
+    return (float) sum;
+}
+
+/* Walker's alias method, Vose's construction */
+/* The stacks of small and large probabilities share picks */
+static void aliasPrepare(population * p, int n)
+{
+    int i;
+    int l;
+    int g;
+    int small = 0;
+    int large = n;
+    float * q = p->wheel;
+    float offset = ga_offset(p,n);
+    double total = 0;
+
+    for(i=0;i<n;i++)
+        total += p->scores[i] - offset;
+    for(i=0;i<n;i++)
+    {
+        q[i] = total > 0 ? (float) ((p->scores[i] - offset) * n / total) : 1;
+        p->alias[i] = i;
+        if(q[i] < 1)
+            p->picks[small++] = i;
+        else
+            p->picks[--large] = i;
+    }
+
+    while(small > 0 && large < n)
+    {
+        l = p->picks[--small];
+        g = p->picks[large];
+        p->alias[l] = g;
+        q[g] = (q[g] + q[l]) - 1;
+        if(q[g] < 1)
+        {
+            large++;
+            p->picks[small++] = g;
+        }
+    }
+
+    /* Rounding leftovers are certain */
+    while(small > 0)
+        q[p->picks[--small]] = 1;
+    while(large < n)
+        q[p->picks[large++]] = 1;
+}
+
+/* Stochastic universal sampling of m parents, shuffled in pairs */
+static void susPrepare(population * p, int n, int m)
+{
+    int i;
+    int j;
+    float total = cumulative(p,n);
+    float step;
+    float pointer;
+
+    if(total <= 0)
+    {
+        for(j=0;j<m;j++)
+            p->picks[j] = randomInt(p->random,n);
+        return;
+    }
+
+    step = total / m;
+    pointer = randomFloat(p->random) * step;
+    i = 0;
+    for(j=0;j<m;j++)
+    {
+        while(i < n-1 && p->wheel[i] <= pointer)
+            i++;
+        p->picks[j] = i;
+        pointer += step;
+    }
+
+    /* Fisher-Yates, the pointers are ordered */
+    for(j=m-1;j>0;j--)
+        swapInt(p->picks,j,randomInt(p->random,j+1));
+}
+
+void selectPrepare(population * p, int n)
+{
+    p->parents = p->size;
+    p->pick = 0;
+    if(n > p->size)
+        n = p->size;
+
+    switch(p->selection)
+    {
+    case GA_SELECT_ROULETTE:
+        cumulative(p,p->parents);
+        break;
+    case GA_SELECT_ALIAS:
+        aliasPrepare(p,p->parents);
+        break;
+    case GA_SELECT_SUS:
+        susPrepare(p,p->parents,n);
+        p->pick = n;
+        break;
+    default:
+        break;
+    }
+}
+
 int selection(population * p, int begin, int end)
 {
-#if SELECTION_RANDOM == 1
+    int n = p->parents;
+    int sel;
+    int i;
+    int l;
+    int r;
+    float roulette;
+    double x;
 
-    swapTypeMatrix( p->chromosomes , p->variables, begin , \
-        ( (rand() % (end+1-begin)) + begin ) );
+    switch(p->selection)
+    {
+    case GA_SELECT_RANDOM:
 
-	return 0;
+        swapInt( p->index , begin , \
+            ( randomInt(p->random,end+1-begin) + begin ) );
 
-#elif SELECTION_NORMAL == 1
+        return begin;
 
-    float x1 = (float) rand()/RAND_MAX;
-    float x2 = (float) rand()/RAND_MAX;
-    float s = x1*x1+x2*x2;
-    while (s >= 1 || s == 0)
+    case GA_SELECT_NORMAL:
     {
-        x1 = (float) rand()/RAND_MAX; 
-        x2 = (float) rand()/RAND_MAX;    
-        s = x1*x1+x2*x2;
+        float x1 = randomFloat(p->random);
+        float x2 = randomFloat(p->random);
+        float s = x1*x1+x2*x2;
+        while (s >= 1 || s == 0)
+        {
+            x1 = randomFloat(p->random); 
+            x2 = randomFloat(p->random);    
+            s = x1*x1+x2*x2;
+        }
+        
+        float randnorm = x1 * sqrt( -2.0 * log(s) / s ); 
+        sel = (end+1)-ceil( (randnorm /4) * (end-begin+1) );
+        if(sel < begin)
+            sel = begin;
+        if(sel > end)
+            sel = end;
+        swapInt(p->index,begin,sel);
+
+        return begin;
     }
-    
-    float randnorm = x1 * sqrt( -2.0 * log(s) / s ); 
-    int sel = (end+1)-ceil( (randnorm /4) * (end-begin+1) );
-    swapTypeMatrix(p->chromosomes,p->variables,begin,sel);
 
-	return 0;
+    case GA_SELECT_ROULETTE:
 
-#elif SELECTION_ROULETTE == 1
+        if(p->wheel[n-1] <= 0)
+            return randomInt(p->random,n);
 
-	float roulette;
-	int i;
-	int sel = -1;
+        /* First cumulative score above the roulette */
+        roulette = randomFloat(p->random) * p->wheel[n-1];
+        l = 0;
+        r = n-1;
+        while(l < r)
+        {
+            sel = l + (r-l)/2;
+            if(p->wheel[sel] > roulette)
+                r = sel;
+            else
+                l = sel + 1;
+        }
+        return l;
 
-	while ((p->roulette_flags[sel] != 0) || (sel < 0))
-	{
-		roulette = ((float) rand())/ ((float)RAND_MAX);
+    case GA_SELECT_ALIAS:
 
-		for(i=end;i>begin;i--) 
-		{
-			sel = i;
-			if( (roulette > p->scores[sel-1]) && \
-			(roulette <= p->scores[sel]) )
-				break;
-		}
-		if( roulette <= p->scores[1] )
-			sel = 0;
-	}
-	
-	if ( roulette <= p->scores[1] )
-	{
-		p->roulette_flags[0] = 1;
-		return 0;
-	}
-	else
-	{
-		p->roulette_flags[sel] = 1;
-		return sel;
-	}
+        sel = randomInt(p->random,n);
+        if(randomFloat(p->random) < p->wheel[sel])
+            return sel;
+        return p->alias[sel];
 
-#endif
+    case GA_SELECT_SUS:
+
+        if(p->pick > 0)
+            return p->picks[--p->pick];
+        return randomInt(p->random,n);
+
+    case GA_SELECT_TOURNAMENT:
+
+        sel = randomInt(p->random,n);
+        for(i=1;i<p->tournament;i++)
+        {
+            r = randomInt(p->random,n);
+            if(p->scores[r] > p->scores[sel])
+                sel = r;
+        }
+        return sel;
+
+    case GA_SELECT_RANK:
+
+        /* Weight i+1 at the position i, inverse of (i+1)(i+2)/2 */
+        x = randomFloat(p->random) * ((double) n * (n+1) / 2);
+        sel = (int) ((sqrt(8*x + 1) - 1) / 2);
+        return sel < n ? sel : n-1;
+
+    default:
+        return begin;
+    }
 }
 
 void crossover(population * p)
@@ -278,94 +905,69 @@ void crossover(population * p)
     #endif
 #endif
 
-#if SELECTION_ROULETTE == 1
-	float totalScore = normalize(p);
-	
-	int j;
-	float sum = 0.0;
-	for(j=0;j<p->size;j++)
-	{
-		p->scores[j] = sum + p->scores[j]/totalScore;
-		sum = p->scores[j];
-		p->roulette_flags[j] = 0;
-	}
-#endif
-
     int selA;
     int selB;
-    TYPE * childrenA = \
-        (TYPE*) malloc(sizeof(TYPE)*p->variables);
-    TYPE * childrenB = \
-        (TYPE*) malloc(sizeof(TYPE)*p->variables);   
+    TYPE * parentA;
+    TYPE * parentB;
+    TYPE * childrenA;
+    TYPE * childrenB;
+    TYPE * swap;
+
+    /* The next generation starts as a copy of the current one */
+    memcpy(p->next,p->genes,sizeof(TYPE)*p->capacity*p->variables);
 
     int i,v;
-    int sizeAdd;
     int total = (int) ( (p->size - p->elitSize) * CROSSOVER_RATE);
-	int end = p->size - p->elitSize;
+	int end = p->size - p->elitSize - 1;
+    selectPrepare(p,(total/2)*2);
     for(i=0; i < total/2; i++) 
     {
+        selA = selection(p,i*2,end);
+        selB = selection(p,i*2+1,end);
+        parentA = p->genes + (size_t) p->index[selA]*p->variables;
+        parentB = p->genes + (size_t) p->index[selB]*p->variables;
 
-#if SELECTION_ROULETTE == 1
-		selA = selection(p,0,end);
-		selB = selection(p,0,end);
-#else
+        /* Children replace the parents or are added to the population */
         selA = i*2;
         selB = selA+1;
-        selection(p,selA,end);
-        selection(p,selB,end);
-#endif
-        for(v=0;v < p->variables; v++)
-        {
-            childrenA[v] = (p->chromosomes[selA][v] & maskA) | \
-				(p->chromosomes[selB][v] & maskB);
-            childrenB[v] = (p->chromosomes[selB][v] & maskA) | \
-                (p->chromosomes[selA][v] & maskB);
-        }
-		mutation(childrenA,p->variables);
-        mutation(childrenB,p->variables);
-#if POPULATION_CONST == 1
-        for(v=0;v < p->variables; v++)
-        {
-            p->chromosomes[selA][v] = childrenA[v];
-            p->chromosomes[selB][v] = childrenB[v];
-        }
-#else
-        sizeAdd = 0;
+#if POPULATION_CONST == 0
         if(p->size < POPULATION_MAX-1)
         {
             p->size += 2;
-            sizeAdd = 1;
+            selA = p->size-2;
+            selB = p->size-1;
         }
-
+#endif
+        childrenA = p->next + (size_t) p->index[selA]*p->variables;
+        childrenB = p->next + (size_t) p->index[selB]*p->variables;
         for(v=0;v < p->variables; v++)
-        {   
-            if(sizeAdd)
-            {
-                p->chromosomes[p->size-2][v] = childrenA[v];
-                p->chromosomes[p->size-1][v] = childrenB[v];
-                sizeAdd = 0;
-            }
-            else
-            {
-                p->chromosomes[selA][v] = childrenA[v];
-                p->chromosomes[selB][v] = childrenB[v];
-            }
-        }                
-#endif 
+        {
+            childrenA[v] = (parentA[v] & maskA) | \
+				(parentB[v] & maskB);
+            childrenB[v] = (parentB[v] & maskA) | \
+                (parentA[v] & maskB);
+        }
+		mutation(childrenA,p->variables,p->random);
+        mutation(childrenB,p->variables,p->random);
 	}
+
+    swap = p->genes;
+    p->genes = p->next;
+    p->next = swap;
+    ga_pointers(p);
 }
 
-void mutation(TYPE * chromosome, int var)
+void mutation(TYPE * chromosome, int var, gaRandom * r)
 {
     int v;
-    TYPE mask = 1;
-    float rnd = ( ((float)rand())/((float) RAND_MAX));
+    TYPE mask;
+    float rnd = randomFloat(r);
 
 	for(v=0; v<var; v++)
     {
 		if(rnd <= (MUTATION_PROBABILITY/var) )
 		{
-			mask = mask << ( rand() % UINT_SZ );
+			mask = ((TYPE) 1) << randomInt(r,UINT_SZ);
 
 			if(chromosome[v] & mask)
 			{
@@ -410,45 +1012,144 @@ void swapFloat(float * a, int pos1, int pos2)
     a[pos2] = sw;    
 }
 
-void swapTypeMatrix(TYPE ** a, int y, int pos1, int pos2)
+void swapInt(int * a, int pos1, int pos2)
 {
-    int j;
-    TYPE sw;
-    for (j=0;j<y;j++)
-    {
-        sw = a[pos1][j];
-        a[pos1][j] = a[pos2][j];
-        a[pos2][j] = sw;
-    }    
-}
-
-int partition(float* A, TYPE ** B, int y, int l, int r)
-{                                      
-    int i = l-1;
-    int j;                  
-    for(j=l; j<r; j++)    
-    {                              
-        if(compare(A[j],A[r]) != 1)    
-        {                      
-            i++;
-            swapFloat(A,i,j);
-            swapTypeMatrix(B,y,i,j);         
-        }                   
-    }
-    swapFloat(A,i+1,r);
-    swapTypeMatrix(B,y,i+1,r);
-       
-    return (i+1);
+    int sw = a[pos1];
+    a[pos1] = a[pos2];
+    a[pos2] = sw;    
 }
 
-void quicksort(float * A,TYPE ** B, int y, int l, int r)
-{                      
-    int p;              
-    if (l < r)                  
-    {                  
-        p = partition(A,B,y,l,r);       
-        quicksort(A,B,y,l,p-1);    
-        quicksort(A,B,y,p+1, r);  
-    }                  
+/* Unsigned key with the order of the float */
+static uint32_t floatKey(float f)
+{
+    uint32_t u;
+    memcpy(&u,&f,sizeof(u));
+    return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
 }
 
+static float keyFloat(uint32_t u)
+{
+    float f;
+    u = (u & 0x80000000u) ? (u & 0x7FFFFFFFu) : ~u;
+    memcpy(&f,&u,sizeof(f));
+    return f;
+}
+
+void sortScores(float * A, int * B, int n, uint32_t * keys, int * tmp)
+{
+    uint32_t * k = keys;
+    uint32_t * kt = keys + n;
+    uint32_t * ksw;
+    int * b = B;
+    int * bt = tmp;
+    int * bsw;
+    int count[256];
+    int shift;
+    int i;
+    int c;
+    int sum;
+
+    if(n < 2)
+        return;
+
+    for(i=0; i<n; i++)
+        k[i] = floatKey(A[i]);
+
+    /* Stable counting sort by byte, least significant first */
+    for(shift=0; shift<32; shift+=8)
+    {
+        memset(count,0,sizeof(count));
+        for(i=0; i<n; i++)
+            count[(k[i]>>shift) & 0xFF]++;
+
+        /* All keys with the same byte, common after the convergence */
+        if(count[(k[0]>>shift) & 0xFF] == n)
+            continue;
+
+        sum = 0;
+        for(i=0; i<256; i++)
+        {
+            c = count[i];
+            count[i] = sum;
+            sum += c;
+        }
+        for(i=0; i<n; i++)
+        {
+            c = (k[i]>>shift) & 0xFF;
+            kt[count[c]] = k[i];
+            bt[count[c]] = b[i];
+            count[c]++;
+        }
+        ksw = k;
+        k = kt;
+        kt = ksw;
+        bsw = b;
+        b = bt;
+        bt = bsw;
+    }
+
+    if(b != B)
+        memcpy(B,b,sizeof(int)*n);
+    for(i=0; i<n; i++)
+        A[i] = keyFloat(k[i]);
+}
+
+void selectTop(float * A, int * B, int n, int k, uint32_t * keys, int * tmp)
+{
+    int target = n - k;
+    int l = 0;
+    int r = n - 1;
+    int lt;
+    int gt;
+    int i;
+    uint32_t seed = 2463534242u;
+    float pivot;
+
+    if(k >= n)
+    {
+        sortScores(A,B,n,keys,tmp);
+        return;
+    }
+
+    /* Quickselect with three-way partition, equal scores end the loop */
+    /* The pivot is at a pseudo-random position (xorshift), sorted or
+     * partitioned scores of the last generation are not a worst case */
+    while(l < r)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        pivot = A[l + (int) (seed % (uint32_t) (r-l+1))];
+
+        lt = l;
+        gt = r;
+        i = l;
+        while(i <= gt)
+        {
+            if(A[i] < pivot)
+            {
+                swapFloat(A,i,lt);
+                swapInt(B,i,lt);
+                lt++;
+                i++;
+            }
+            else if(A[i] > pivot)
+            {
+                swapFloat(A,i,gt);
+                swapInt(B,i,gt);
+                gt--;
+            }
+            else
+                i++;
+        }
+
+        if(target < lt)
+            r = lt - 1;
+        else if(target > gt)
+            l = gt + 1;
+        else
+            break;
+    }
+
+    sortScores(A + target,B + target,k,keys,tmp);
+}
@@ -33,6 +33,7 @@
 #include <math.h>
 #include <inttypes.h>
 #include <time.h>
+#include <string.h>
 
 
 /* Prints enabled/disabled */
@@ -69,15 +70,63 @@
 #endif
 /**************************/
 
+/* Seed of the random numbers, 0 = time and a counter of ga_init */
+#ifndef GA_SEED
+    #define GA_SEED 0
+#endif
+
+/* RANDOM NUMBERS */
+/* xoshiro256** generator, one independent stream by thread */
+typedef struct
+{
+    uint64_t s[4];
+} gaRandom;
+
+/* Alignment in bytes of the genes buffers */
+#ifndef GA_ALIGN
+    #define GA_ALIGN 64
+#endif
+
 /* POPULATION STRUCT */
+/* The genes of all chromosomes are in one aligned buffer, 'variables'
+ * genes by chromosome, and 'next' is the buffer of the next generation.
+ * index[pos] is the row of the chromosome at the position 'pos', sorting
+ * and selection move the indexes, never the genes.
+ * chromosomes[pos] points to the genes of the position, updated by
+ * fitness and crossover.
+ * sortKeys (2 X capacity) and sortIndex are the memory of the sorts.
+ * pool = threads of the fitness (NULL = serial), chunk of ga_threads.
+ * random = 'streams' random streams, the stream 0 is used by the GA and
+ * by the calling thread in the fitness, the stream i by the thread i.
+ * selection = GA_SELECT_* method, tournament = chromosomes by tournament,
+ * parents = chromosomes of the last selectPrepare, wheel = cumulative
+ * scores or probabilities of the alias method, alias = aliases, picks =
+ * parents of the stochastic universal sampling (pick = remaining).
+ */
 typedef struct
 {
     TYPE ** chromosomes;
+    TYPE * genes;
+    TYPE * next;
+    int * index;
     float * scores;
+    uint32_t * sortKeys;
+    int * sortIndex;
+    void * pool;
+    int chunk;
+    gaRandom * random;
+    int streams;
     int variables;
     int size;
+    int capacity;
     int elitSize;
-	char * roulette_flags;
+    int selection;
+    int tournament;
+    int parents;
+    int pick;
+    float * wheel;
+    int * alias;
+    int * picks;
 } population;
 
 /* STOPPING CRITERION */
@@ -111,6 +160,50 @@ typedef struct
 #ifndef SELECTION_RANDOM
     #define SELECTION_RANDOM 0
 #endif
+#ifndef SELECTION_ALIAS
+    #define SELECTION_ALIAS 0
+#endif
+#ifndef SELECTION_SUS
+    #define SELECTION_SUS 0
+#endif
+#ifndef SELECTION_TOURNAMENT
+    #define SELECTION_TOURNAMENT 0
+#endif
+#ifndef SELECTION_RANK
+    #define SELECTION_RANK 0
+#endif
+
+/* SELECTION CONFIGURATION */
+#ifndef TOURNAMENT_SIZE
+    #define TOURNAMENT_SIZE 2
+#endif
+
+/* Selection methods, also at runtime by ga_selection */
+/* Random and normal switch a chromosome to the position of the child,
+ * the others return a parent of the whole population (with repetition) */
+#define GA_SELECT_RANDOM 0      /* Uniform, educational */
+#define GA_SELECT_NORMAL 1      /* Normal distribution over the ranks */
+#define GA_SELECT_ROULETTE 2    /* Binary search of the cumulative scores */
+#define GA_SELECT_ALIAS 3       /* Roulette by Walker's alias method */
+#define GA_SELECT_SUS 4         /* Stochastic universal sampling */
+#define GA_SELECT_TOURNAMENT 5  /* Best of TOURNAMENT_SIZE chromosomes */
+#define GA_SELECT_RANK 6        /* Roulette with weights 1..size of ranks */
+
+#if SELECTION_RANDOM == 1
+    #define GA_SELECTION GA_SELECT_RANDOM
+#elif SELECTION_NORMAL == 1
+    #define GA_SELECTION GA_SELECT_NORMAL
+#elif SELECTION_ALIAS == 1
+    #define GA_SELECTION GA_SELECT_ALIAS
+#elif SELECTION_SUS == 1
+    #define GA_SELECTION GA_SELECT_SUS
+#elif SELECTION_TOURNAMENT == 1
+    #define GA_SELECTION GA_SELECT_TOURNAMENT
+#elif SELECTION_RANK == 1
+    #define GA_SELECTION GA_SELECT_RANK
+#else
+    #define GA_SELECTION GA_SELECT_ROULETTE
+#endif
 
 /* CROSSOVER TYPES */
 #ifndef CROSSOVER_ONE_POINT
@@ -135,6 +228,17 @@ typedef struct
     #define MUTATION_PROBABILITY 0.015
 #endif
 
+/* PARALLEL FITNESS */
+/* Threads evaluating the fitness function, 1 = serial */
+#ifndef FITNESS_THREADS
+    #define FITNESS_THREADS 1
+#endif
+/* Chromosomes by chunk of the dynamic scheduling,
+ * 0 = static scheduling (one contiguous block by thread) */
+#ifndef FITNESS_CHUNK
+    #define FITNESS_CHUNK 0
+#endif
+
 /* Initialization */
 int ga_init(population * p, int var);
 
@@ -144,9 +248,61 @@ void ga_end(population * p);
 /* Normalize the scores and return the SUM */
 float normalize(population * p);
 
+/* Chromosomes by block of the batch fitness */
+#ifndef GA_BATCH_BLOCK
+    #define GA_BATCH_BLOCK 256
+#endif
+
+/* Batch fitness function */
+/* x[v*stride + i] = variable v of the chromosome i of the block (i < n),
+ * decoded like interpret, scores[i] = value of the chromosome i (lower
+ * is better, like the fitness function). stride = GA_BATCH_BLOCK, the
+ * loops over i can be vectorized. arg = argument of fitnessBatch. */
+typedef void (*gaBatch)(float * x, int n, int stride, float * scores, \
+    void * arg);
+
+/* Seed the stream and jump it 2^128 numbers, next streams */
+void randomSeed(gaRandom * r, uint64_t seed);
+void randomJump(gaRandom * r);
+
+/* Random 64 bits, float in [0,1) and integer in [0,n) */
+uint64_t randomNext(gaRandom * r);
+float randomFloat(gaRandom * r);
+int randomInt(gaRandom * r, int n);
+
+/* Stream of the calling thread in the fitness (NULL outside) */
+/* The numbers only repeat with the same seed, threads and static
+ * scheduling (FITNESS_CHUNK 0) */
+gaRandom * ga_random(void);
+
+/* Seed all streams of the population and draw the initial population
+ * again (POPULATION_INIT chromosomes), ga_init uses GA_SEED */
+void ga_seed(population * p, uint64_t seed);
+
+/* Threads of the fitness, replaces FITNESS_THREADS and FITNESS_CHUNK */
+/* threads <= 1 evaluates in the calling thread */
+/* Return 0 = success, 1 = error (the evaluation stays serial) */
+int ga_threads(population * p, int threads, int chunk);
+
 /* Fitness */
+/* With threads, 'func' is called at the same time from several threads,
+ * each call with a different chromosome and in any order. It must only
+ * read the chromosome, it must not write global or static data without
+ * its own locks and it must not use rand() or other functions with
+ * hidden global state. */
+/* Sort the population by score with the best at size-1, without normal
+ * and rank selections only the elit is sorted at the end */
 void fitness(float(*func)(TYPE*), population * p);
 
+/* Fitness by blocks of GA_BATCH_BLOCK chromosomes in SoA layout */
+/* inf, sup = range of each variable, same contract of fitness */
+void fitnessBatch(gaBatch func, void * arg, float * inf, float * sup, \
+    population * p);
+
+/* Decode the variables of n chromosomes to x[v*stride + i] */
+void decode(TYPE ** chromosomes, int n, int variables, float * inf, \
+    float * sup, float * x, int stride);
+
 /* Convert binary value to float in a range */
 /* Based on quantized value */
 float interpret(TYPE chromosome, float inf, float sup);
@@ -154,24 +310,41 @@ float interpret(TYPE chromosome, float inf, float sup);
 /* Crossover */
 void crossover(population * p);
 
+/* Method of the selection, GA_SELECT_*, and chromosomes by tournament */
+/* tournament < 2 = TOURNAMENT_SIZE */
+/* Return 0 = success, 1 = unknown method */
+int ga_selection(population * p, int method, int tournament);
+
+/* Prepare the selection of n parents (n <= size) in the population */
+/* O(size), then each selection is O(1), O(log size) for the roulette */
+/* Called by crossover, before the selection */
+void selectPrepare(population * p, int n);
+
 /* Selection */
 /* Select a chromosome in the interval */
-/* Return the the index for roulette */
-/* Switch with begin position for normal and random */
+/* Return the position of the parent: switched with begin position for
+ * normal and random, in the whole population for the other methods */
 int selection(population * p, int begin, int end);
 
 /* Mutation */
-void mutation(TYPE * chromosome, int var);
+void mutation(TYPE * chromosome, int var, gaRandom * r);
 
 /* Print population */
 void printPopulation(float(*func)(TYPE*),population * p);
 
-/* Quick Sort, modified to keep the order of the chromosomes */
+/* Point chromosomes[pos] to the row index[pos] of the genes */
+void ga_pointers(population * p);
+
+/* Radix sort of the scores A[0..n-1], ascending, moving the indexes B */
+/* keys = 2*n keys, tmp = n indexes */
+void sortScores(float * A, int * B, int n, uint32_t * keys, int * tmp);
+
+/* Put the k largest scores sorted in A[n-k..n-1], the others in any order */
+void selectTop(float * A, int * B, int n, int k, uint32_t * keys, int * tmp);
+
 int compare(float a, float b);
 void swapFloat(float * a, int pos1, int pos2);
-void swapTypeMatrix(TYPE ** a, int y, int pos1, int pos2);
-int partition(float * A, TYPE ** B, int y, int l, int r);
-void quicksort(float * A, TYPE ** B, int y, int l, int r);
+void swapInt(int * a, int pos1, int pos2);
  
 #endif /* _GA_H */
 
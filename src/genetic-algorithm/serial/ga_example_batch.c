@@ -0,0 +1,108 @@
+/* This file is part of gal software */
+
+#include "ga.h"
+#ifdef __unix__
+    #include <sys/time.h>
+#endif
+
+#define LIMIT_INFERIOR -100.0
+#define LIMIT_SUPERIOR 100.0
+#define VAR 2
+
+#define REPEAT 200
+
+/* Optimize Schaffer F6 function */
+/* Min in x1 = 0.0 and x2 = 0.0 */
+float my_fitness(TYPE * c)
+{
+    float x1 = interpret(c[0],LIMIT_INFERIOR,LIMIT_SUPERIOR);
+    float x2 = interpret(c[1],LIMIT_INFERIOR,LIMIT_SUPERIOR);
+
+	float xpow2 = x1*x1;
+	float ypow2 = x2*x2;
+	float up = sin(sqrt(xpow2 + ypow2));
+	float down = 1.0 + 0.001 * (xpow2 + ypow2);
+
+	return 0.5 + (up*up - 0.5) / (down * down);
+}
+
+/* Same function for a block of decoded chromosomes */
+void my_fitness_batch(float * x, int n, int stride, float * scores, \
+    void * arg)
+{
+    int i;
+    float * x1 = x;
+    float * x2 = x + stride;
+    float r2;
+    float up;
+    float down;
+
+    for(i=0;i<n;i++)
+    {
+        r2 = x1[i]*x1[i] + x2[i]*x2[i];
+        up = sinf(sqrtf(r2));
+        down = 1.0f + 0.001f*r2;
+        scores[i] = 0.5f + (up*up - 0.5f) / (down*down);
+    }
+}
+
+static double seconds(void)
+{
+#ifdef __unix__
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec + t.tv_usec/1000000.0;
+#else
+    return ((double) clock())/CLOCKS_PER_SEC;
+#endif
+}
+
+int main(int argc, char ** argv)
+{
+    float inf[VAR] = {LIMIT_INFERIOR, LIMIT_INFERIOR};
+    float sup[VAR] = {LIMIT_SUPERIOR, LIMIT_SUPERIOR};
+    double t;
+    double single;
+    double batch;
+    int i;
+
+    population popul;
+    if(ga_init(&popul,VAR))
+    {
+        printf("Memory error in initialization.\n");
+        return 2;
+    }
+
+    /* Same population with both interfaces */
+    t = seconds();
+    for(i=0;i<REPEAT;i++)
+        fitness(my_fitness,&popul);
+    single = seconds() - t;
+
+    t = seconds();
+    for(i=0;i<REPEAT;i++)
+        fitnessBatch(my_fitness_batch,NULL,inf,sup,&popul);
+    batch = seconds() - t;
+
+    printf("Fitness of %d chromosomes, %d times\n",popul.size,REPEAT);
+    printf("One by call: %.6fs\nBatch: %.6fs\n",single,batch);
+
+    /* GA with the batch fitness */
+    for(i=0;i<STOP_GENERATIONS;i++)
+    {
+        fitnessBatch(my_fitness_batch,NULL,inf,sup,&popul);
+        crossover(&popul);
+    }
+    fitnessBatch(my_fitness_batch,NULL,inf,sup,&popul);
+
+    printf("\nBest Solution:\nx1: %f , x2: %f\ny = %f\n", \
+        interpret(popul.chromosomes[popul.size-1][0], \
+        LIMIT_INFERIOR,LIMIT_SUPERIOR), \
+        interpret(popul.chromosomes[popul.size-1][1], \
+        LIMIT_INFERIOR,LIMIT_SUPERIOR), \
+        my_fitness(popul.chromosomes[popul.size-1]));
+
+    ga_end(&popul);
+
+    return 0;
+}
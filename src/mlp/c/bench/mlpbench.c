@@ -0,0 +1,464 @@
+/* MLP Benchmark
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../mlp_thread.h"
+#include "../mlp_pipeline.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Minimum seconds of each measure, split among the runs */
+#ifndef BENCH_SECONDS
+	#define BENCH_SECONDS 0.2
+#endif
+
+/* Runs of each measure, the best is kept */
+#ifndef BENCH_REPEAT
+	#define BENCH_REPEAT 3
+#endif
+
+/* Single-sample inferences of the latency percentiles */
+#ifndef BENCH_SAMPLES
+	#define BENCH_SAMPLES 2000
+#endif
+
+/* Examples of the synthetic data set */
+#define BENCH_EXAMPLES 1024
+#define BENCH_INPUTS 32
+#define BENCH_OUTPUTS 4
+#define BENCH_MAX 256
+
+/* Sweep */
+static const int widths[] = {16, 64, 256};
+static const int depths[] = {1, 2, 4};
+static const int batches[] = {16, 64, 256};
+static const int threads[] = {1, 2, 4};
+#define NELEM(a) ((int) (sizeof(a)/sizeof(a[0])))
+
+/* Result of a benchmark, unit "us" is lower-is-better and
+ * "samples/s" is higher-is-better
+ */
+typedef struct
+{
+	char name[64];
+	char * unit;
+	double value;
+} benchResult;
+
+/* Batch split among the threads of a pool */
+typedef struct
+{
+	double *** weights;
+	training * tr;
+	double ** in;
+	int first;
+	int count;
+	double ** out;
+} benchTask;
+
+static double benchClock(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+static int compareDouble(const void * a, const void * b)
+{
+	double x = *(const double*) a;
+	double y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+static void batchTask(void * varg, int id, int nthreads)
+{
+	benchTask * t = (benchTask*) varg;
+	int begin;
+	int end;
+
+	poolRange(t->count,id,nthreads,&begin,&end);
+	if(end > begin)
+	{
+		outMLPBatch(t->weights,t->tr,"sigmoid",t->in,t->first+begin, \
+		end-begin,t->out+begin);
+	}
+}
+
+/* Append a result */
+static void benchAdd(benchResult * r, int * n, char * unit, double value, \
+const char * fmt, int a, int b, int c, int d)
+{
+	snprintf(r[*n].name,sizeof(r[*n].name),fmt,a,b,c,d);
+	r[*n].unit = unit;
+	r[*n].value = value;
+	fprintf(stderr,"%-32s %14.3f %s\n",r[*n].name,value,unit);
+	(*n)++;
+}
+
+/* Training samples/s of the pipeline with the given stages (threads) */
+static double benchTraining(double *** weights, training * tr, int stages)
+{
+	double * hist;
+	double t;
+	double best = 0;
+	long int samples = tr->examples;
+	int run = 0;
+	int out = dup(STDOUT_FILENO);
+	int null = open("/dev/null",O_WRONLY);
+
+	/* Silence the progress of the training (DEBUG_MODE) */
+	fflush(stdout);
+	if(null >= 0)
+		dup2(null,STDOUT_FILENO);
+
+	/* Double the examples until a run is long enough */
+	while(run < BENCH_REPEAT)
+	{
+		tr->maxIteration = samples;
+		t = benchClock();
+		hist = trainingMLPPipeline(weights,tr,"sigmoid",stages,8,4);
+		t = benchClock() - t;
+		free(hist);
+		if(hist == NULL)
+			break;
+		if(t < BENCH_SECONDS/BENCH_REPEAT)
+		{
+			samples *= 2;
+			continue;
+		}
+		if(samples/t > best)
+			best = samples/t;
+		run++;
+	}
+
+	fflush(stdout);
+	if(out >= 0)
+	{
+		dup2(out,STDOUT_FILENO);
+		close(out);
+	}
+	if(null >= 0)
+		close(null);
+
+	return best;
+}
+
+/* Batched inference samples/s */
+static double benchBatch(double *** weights, training * tr, mlpPool * pool, \
+int batch, double ** out)
+{
+	long int samples;
+	int first = 0;
+	int run;
+	double start;
+	double t;
+	double best = 0;
+	benchTask task;
+
+	task.weights = weights;
+	task.tr = tr;
+	task.in = tr->x;
+	task.out = out;
+	task.count = batch;
+	for(run=0; run<BENCH_REPEAT; run++)
+	{
+		samples = 0;
+		start = benchClock();
+		do
+		{
+			task.first = first;
+			if(pool == NULL)
+				outMLPBatch(weights,tr,"sigmoid",tr->x,first,batch,out);
+			else
+				poolRun(pool,batchTask,&task);
+			samples += batch;
+			first = (first + batch) % tr->examples;
+			t = benchClock() - start;
+		}
+		while(t < BENCH_SECONDS/BENCH_REPEAT);
+		if(samples/t > best)
+			best = samples/t;
+	}
+
+	return best;
+}
+
+/* Single-sample latency percentiles in us, after a warm-up pass the
+ * best of BENCH_REPEAT passes for each percentile
+ */
+static void benchLatency(double *** weights, training * tr, double * out, \
+double * p50, double * p90, double * p99)
+{
+	int i;
+	int run;
+	double t;
+	double * lat = (double*) malloc(sizeof(double)*BENCH_SAMPLES);
+	if(lat == NULL)
+		return;
+
+	*p50 = INFINITY;
+	*p90 = INFINITY;
+	*p99 = INFINITY;
+	for(run=-1; run<BENCH_REPEAT; run++)
+	{
+		for(i=0; i<BENCH_SAMPLES; i++)
+		{
+			t = benchClock();
+			outMLP(weights,tr,"sigmoid",tr->x,i % tr->examples,out);
+			lat[i] = 1e6*(benchClock() - t);
+		}
+		/* Warm-up */
+		if(run < 0)
+			continue;
+		qsort(lat,BENCH_SAMPLES,sizeof(double),compareDouble);
+		*p50 = fmin(*p50,lat[BENCH_SAMPLES/2]);
+		*p90 = fmin(*p90,lat[(int) (0.90*BENCH_SAMPLES)]);
+		*p99 = fmin(*p99,lat[(int) (0.99*BENCH_SAMPLES)]);
+	}
+
+	free(lat);
+}
+
+/* Write the results as JSON, one benchmark by line */
+static int benchWrite(char * filename, benchResult * r, int n)
+{
+	int i;
+	FILE * f = strcmp(filename,"-") ? fopen(filename,"w") : stdout;
+	if(f == NULL)
+		return 1;
+
+	fprintf(f,"{\n  \"benchmarks\": [\n");
+	for(i=0; i<n; i++)
+	{
+		fprintf(f,"    {\"name\": \"%s\", \"unit\": \"%s\", " \
+		"\"value\": %.6g}%s\n",r[i].name,r[i].unit,r[i].value, \
+		i < n-1 ? "," : "");
+	}
+	fprintf(f,"  ]\n}\n");
+
+	if(f != stdout)
+		fclose(f);
+	return 0;
+}
+
+/* Value of a benchmark in a JSON written by benchWrite
+ * return 0 = found, 1 = not found
+ */
+static int benchFind(char * filename, char * name, double * value)
+{
+	char line[256];
+	char key[64];
+	char * p;
+	FILE * f = fopen(filename,"r");
+	if(f == NULL)
+		return 1;
+
+	while(fgets(line,sizeof(line),f) != NULL)
+	{
+		p = strstr(line,"\"name\": \"");
+		if(p == NULL || sscanf(p+9,"%63[^\"]",key) != 1 || strcmp(key,name))
+			continue;
+		p = strstr(line,"\"value\": ");
+		if(p != NULL && sscanf(p+9,"%lf",value) == 1)
+		{
+			fclose(f);
+			return 0;
+		}
+	}
+	fclose(f);
+	return 1;
+}
+
+/* Compare with the baseline
+ * return number of regressions beyond 'threshold' (fraction)
+ */
+static int benchCompare(char * filename, benchResult * r, int n, \
+double threshold)
+{
+	int i;
+	int regressions = 0;
+	double base;
+	double change;
+	int lower;
+
+	fprintf(stderr,"\nBaseline %s, threshold %.1f%%\n",filename, \
+	100*threshold);
+	for(i=0; i<n; i++)
+	{
+		if(benchFind(filename,r[i].name,&base) || base <= 0)
+		{
+			fprintf(stderr,"%-32s %14s\n",r[i].name,"new");
+			continue;
+		}
+		/* Positive change is better */
+		lower = strcmp(r[i].unit,"us") == 0;
+		change = lower ? (base - r[i].value)/base : (r[i].value - base)/base;
+		fprintf(stderr,"%-32s %+13.1f%% %s\n",r[i].name,100*change, \
+		change < -threshold ? "REGRESSION" : "");
+		if(change < -threshold)
+			regressions++;
+	}
+
+	return regressions;
+}
+
+int main(int argc, char ** argv)
+{
+	benchResult * r;
+	int n = 0;
+	int w;
+	int d;
+	int b;
+	int t;
+	int stages;
+	int trained;
+	int l;
+	int e;
+	int j;
+	int processors = mlpThreads();
+	int regressions;
+	int neurons[8];
+	double bias[8];
+	double threshold = 0.1;
+	double p50 = 0;
+	double p90 = 0;
+	double p99 = 0;
+	double *** weights;
+	double ** out;
+	mlpPool * pool;
+	training tr;
+
+	if(argc < 2)
+	{
+		fprintf(stderr,"Usage: %s output.json|- [baseline.json] " \
+		"[threshold(%%)]\n",argv[0]);
+		return 1;
+	}
+	if(argc > 3)
+		threshold = atof(argv[3])/100;
+
+	r = (benchResult*) malloc(sizeof(benchResult)*NELEM(widths)* \
+	NELEM(depths)*(3 + NELEM(threads)*(1 + NELEM(batches))));
+
+	/* Synthetic data set */
+	memset(&tr,0,sizeof(training));
+	tr.ninputs = BENCH_INPUTS;
+	tr.neurons = neurons;
+	tr.bias = bias;
+	tr.alpha = 1e-4;
+	tr.lrate = 0.1;
+	tr.acceptedError = 0;
+	tr.examples = BENCH_EXAMPLES;
+	tr.x = matrixAlloc(BENCH_EXAMPLES,BENCH_INPUTS);
+	tr.reference = matrixAlloc(BENCH_EXAMPLES,BENCH_OUTPUTS);
+	out = matrixAlloc(BENCH_MAX,BENCH_OUTPUTS);
+	if(r == NULL || tr.x == NULL || tr.reference == NULL || out == NULL)
+	{
+		fprintf(stderr,"Memory error.\n");
+		return 2;
+	}
+	srand(1);
+	for(e=0; e<BENCH_EXAMPLES; e++)
+	{
+		for(j=0; j<BENCH_INPUTS; j++)
+			tr.x[e][j] = (double) rand()/RAND_MAX;
+		for(j=0; j<BENCH_OUTPUTS; j++)
+			tr.reference[e][j] = rand() % 2;
+	}
+
+	for(w=0; w<NELEM(widths); w++)
+	{
+		for(d=0; d<NELEM(depths); d++)
+		{
+			/* Hidden layers of 'width' neurons and the output layer */
+			tr.nlayers = depths[d] + 1;
+			for(l=0; l<depths[d]; l++)
+			{
+				neurons[l] = widths[w];
+				bias[l] = -1;
+			}
+			neurons[l] = BENCH_OUTPUTS;
+			bias[l] = -1;
+			/* Same weights in each run (initMLP prints them) */
+			weights = weightsAlloc(neurons,tr.nlayers,tr.ninputs);
+			if(weights == NULL)
+			{
+				fprintf(stderr,"Memory error.\n");
+				return 2;
+			}
+			for(j=0; j<weightsCount(neurons,tr.nlayers,tr.ninputs); j++)
+				weights[0][0][j] = (double) rand()/RAND_MAX - 0.5;
+
+			benchLatency(weights,&tr,out[0],&p50,&p90,&p99);
+			benchAdd(r,&n,"us",p50,"latency_p50/w%d/d%d",widths[w], \
+			depths[d],0,0);
+			benchAdd(r,&n,"us",p90,"latency_p90/w%d/d%d",widths[w], \
+			depths[d],0,0);
+			benchAdd(r,&n,"us",p99,"latency_p99/w%d/d%d",widths[w], \
+			depths[d],0,0);
+
+			/* Threads up to the number of processors */
+			trained = 0;
+			for(t=0; t<NELEM(threads) && threads[t]<=processors; t++)
+			{
+				pool = threads[t] > 1 ? poolCreate(threads[t]) : NULL;
+				for(b=0; b<NELEM(batches); b++)
+				{
+					benchAdd(r,&n,"samples/s", \
+					benchBatch(weights,&tr,pool,batches[b],out), \
+					"infer/w%d/d%d/b%d/t%d",widths[w],depths[d],batches[b], \
+					threads[t]);
+				}
+				poolDestroy(pool);
+
+				/* The pipeline runs at most one stage per layer */
+				stages = threads[t] < tr.nlayers ? threads[t] : tr.nlayers;
+				if(stages > trained)
+				{
+					benchAdd(r,&n,"samples/s",benchTraining(weights,&tr, \
+					stages),"train/w%d/d%d/t%d",widths[w],depths[d], \
+					stages,0);
+					trained = stages;
+				}
+			}
+
+			weightsFree(weights,neurons,tr.nlayers);
+		}
+	}
+
+	if(benchWrite(argv[1],r,n))
+	{
+		fprintf(stderr,"Error writing %s\n",argv[1]);
+		return 2;
+	}
+
+	regressions = argc > 2 ? benchCompare(argv[2],r,n,threshold) : 0;
+	if(regressions)
+		fprintf(stderr,"%d regressions\n",regressions);
+
+	free(r);
+	return regressions ? 3 : 0;
+}
@@ -26,18 +26,42 @@
  */
 
 #include "mlp.h"
+#ifdef MLP_LOADER
+#include "mlp_loader.h"
+#endif
 
 /* Integer Vector Rand Permutation */
 /* The pseudo-random number generator must be initialized */
 void vperm(int * a, int sz)
 {
 	int i;
-	int m = ceil(sz/2);
 	int sw;
 	int r;
-	for(i=0; i<m; i++)
+	/* Fisher-Yates */
+	for(i=sz-1; i>0; i--)
+	{
+		r = rand() % (i+1);
+		sw = a[i];
+		a[i] = a[r];
+		a[r] = sw;
+	}
+}
+
+/* Rand permutation of the examples of a workspace */
+static void workspacePerm(mlpWorkspace * ws, int * a, int sz)
+{
+	int i;
+	int sw;
+	int r;
+	if(ws->seed == NULL)
 	{
-		r = rand() % sz;
+		vperm(a,sz);
+		return;
+	}
+	/* Fisher-Yates */
+	for(i=sz-1; i>0; i--)
+	{
+		r = rand_r(ws->seed) % (i+1);
 		sw = a[i];
 		a[i] = a[r];
 		a[r] = sw;
@@ -105,77 +129,139 @@ void sigmoid(double ** ori, double ** dest, int layer,  double sz)
 		dest[layer][i]= 1.0/(1.0+exp(-1.0*ori[layer][i]));
 }
 
-/* Layer 0 Out */
-void layerOut0(double ** dest, double bias, \
-double ** examples, int example, int ninputs, \
-double *** weights, int nneurons, int activation)
+/* Activation function of a sum */
+double activationOut(double sum, int activation)
+{
+	switch(activation)
+	{
+		case 1:
+			return 1.0/(1.0+exp(-1.0*sum));
+		default:
+			return 1.0/(1.0+exp(-1.0*sum));
+	}
+}
+
+/* Out of the neurons [begin,end) of a layer for the input vector 'in' */
+void neuronsOut(double * dest, double bias, double * in, int nin, \
+double ** weights, int begin, int end, int activation)
 {
 	int i;
 	int j;
 	double sum;
-	
-	for(i=0; i<(nneurons); i++)
+	double * w;
+
+	for(i=begin; i<end; i++)
 	{
-		sum = 0;
-		for(j=0; j<(ninputs+1); j++)
-		{
-			if (j)
-			{
-				sum += examples[example][j-1] * weights[0][i][j];
-			}
-			else
-			{
-				sum += bias * weights[0][i][j];
-			}
-		}
-		dest[0][i] = sum;
-	}	
+		w = weights[i];
+		sum = bias * w[0];
+		for(j=0; j<nin; j++)
+			sum += in[j] * w[j+1];
 
-	switch(activation)
-	{	
-		case 1:
-			sigmoid(dest,dest,0,nneurons);
-			break;
-		default:
-			sigmoid(dest,dest,0,nneurons);
-			break;
-	}	
+		dest[i] = activationOut(sum,activation);
+	}
 }
 
-/* Layer 1 and Following Out */
-void layersOut(double ** dest, double bias, int nOutsPrev, \
-double *** weights, int layer, int nneurons, int activation)
+/* Out of a layer for 'count' input vectors */
+void layerOutBatch(double * dest, double * in, int count, double bias, \
+double ** weights, int nin, int neurons, int activation)
 {
+	int e;
 	int i;
 	int j;
-	double sum;
-	
-	for(i=0; i<(nneurons); i++)
+	double s0;
+	double s1;
+	double s2;
+	double s3;
+	double wj;
+	double * w;
+	double * x0;
+	double * x1;
+	double * x2;
+	double * x3;
+
+	/* Four examples by pass over the weights of a neuron */
+	for(e=0; e+4<=count; e+=4)
 	{
-		sum = 0;
-		for(j=0; j<(nOutsPrev+1); j++)
+		x0 = in + e*nin;
+		x1 = x0 + nin;
+		x2 = x1 + nin;
+		x3 = x2 + nin;
+		for(i=0; i<neurons; i++)
 		{
-			if (j)
-			{
-				sum += dest[layer-1][j-1]*weights[layer][i][j];
-			}
-			else
+			w = weights[i];
+			s0 = bias * w[0];
+			s1 = s0;
+			s2 = s0;
+			s3 = s0;
+			for(j=0; j<nin; j++)
 			{
-				sum += bias*weights[layer][i][j];
+				wj = w[j+1];
+				s0 += x0[j] * wj;
+				s1 += x1[j] * wj;
+				s2 += x2[j] * wj;
+				s3 += x3[j] * wj;
 			}
+			dest[e*neurons + i] = activationOut(s0,activation);
+			dest[(e+1)*neurons + i] = activationOut(s1,activation);
+			dest[(e+2)*neurons + i] = activationOut(s2,activation);
+			dest[(e+3)*neurons + i] = activationOut(s3,activation);
 		}
-		dest[layer][i] = sum;
-	}	
+	}
 
-	switch(activation)
-	{	
-		case 1:
-			sigmoid(dest,dest,layer,nneurons);
-			break;
-		default:
-			sigmoid(dest,dest,layer,nneurons);
-			break;
-	}	
+	for(; e<count; e++)
+	{
+		neuronsOut(dest + e*neurons,bias,in + e*nin,nin, \
+		weights,0,neurons,activation);
+	}
+}
+
+/* Layer 0 Out */
+void layerOut0(double ** dest, double bias, \
+double ** examples, int example, int ninputs, \
+double *** weights, int nneurons, int activation)
+{
+	neuronsOut(dest[0],bias,examples[example],ninputs, \
+	weights[0],0,nneurons,activation);
+}
+
+/* Out of the neurons [begin,end) of the first layer for a CSR row */
+void neuronsOutSparse(double * dest, double bias, mlpCSR * in, int row, \
+double ** weights, int begin, int end, int activation)
+{
+	int i;
+	int k;
+	int first = in->ptr[row];
+	int last = in->ptr[row+1];
+	int * col = in->col;
+	double * val = in->val;
+	double sum;
+	double * w;
+
+	for(i=begin; i<end; i++)
+	{
+		w = weights[i];
+		sum = bias * w[0];
+		for(k=first; k<last; k++)
+			sum += val[k] * w[col[k]+1];
+
+		dest[i] = activationOut(sum,activation);
+	}
+}
+
+/* Out of first layer for a CSR row */
+void layerOut0Sparse(double ** dest, double bias, mlpCSR * examples, \
+int example, double *** weights, int nneurons, int activation)
+{
+	neuronsOutSparse(dest[0],bias,examples,example, \
+	weights[0],0,nneurons,activation);
+}
+
+/* Layer 1 and Following Out */
+void layersOut(double ** dest, double bias, int nOutsPrev, \
+double *** weights, int layer, int nneurons, int activation)
+{
+	neuronsOut(dest[layer],bias,dest[layer-1],nOutsPrev, \
+	weights[layer],0,nneurons,activation);
 }
 
 /* Error = (desired output) - (reference output) */
@@ -227,9 +313,6 @@ double ** df, int layer, int neurons)
 void weightsCopy(double *** ori, double *** dest,\
 int * neurons, int nlayers, int ninputs)
 {
-	double *** weights = (double***) \
-	weightsAlloc(neurons, nlayers, ninputs);
-	
 	int layer;
 	int neuron;
 	int weight;	
@@ -314,6 +397,129 @@ double ** ref, int example, int neurons, int ninputs)
 		}
 	}	
 }
+/* Update layer 0 for a CSR row, only the bias and nonzero columns */
+void updateLayer0Sparse(double *** weights,double alpha, \
+double *** weightsPast, double lrate, double ** gs, double bias, \
+mlpCSR * examples, int example, int neurons)
+{
+	int neuron;
+	int k;
+	int w;
+	int first = examples->ptr[example];
+	int last = examples->ptr[example+1];
+	double g;
+	for(neuron=0; neuron<neurons; neuron++)
+	{
+		g = lrate*gs[0][neuron];
+		weights[0][neuron][0] = weights[0][neuron][0] + \
+		alpha * weightsPast[0][neuron][0] + g*bias;
+		for(k=first; k<last; k++)
+		{
+			w = examples->col[k]+1;
+			weights[0][neuron][w] = weights[0][neuron][w] + \
+			alpha * weightsPast[0][neuron][w] + g*examples->val[k];
+		}
+	}
+}
+
+/* Copy Weights, in layer 0 only the bias and the nonzero columns of
+ * a CSR row
+ */
+void weightsCopySparse(double *** ori, double *** dest, int * neurons, \
+int nlayers, mlpCSR * examples, int example)
+{
+	int layer;
+	int neuron;
+	int k;
+	int w;
+	for(neuron=0; neuron<neurons[0]; neuron++)
+	{
+		dest[0][neuron][0] = ori[0][neuron][0];
+		for(k=examples->ptr[example]; k<examples->ptr[example+1]; k++)
+		{
+			w = examples->col[k]+1;
+			dest[0][neuron][w] = ori[0][neuron][w];
+		}
+	}
+	for(layer=1; layer<nlayers; layer++)
+	{
+		for(neuron=0; neuron<neurons[layer]; neuron++)
+		{
+			memcpy(dest[layer][neuron],ori[layer][neuron], \
+			sizeof(double)*(neurons[layer-1]+1));
+		}
+	}
+}
+
+/* CSR matrix with 'nnz' nonzero elements */
+mlpCSR * csrAlloc(int rows, int cols, long int nnz)
+{
+	mlpCSR * m = (mlpCSR*) calloc(1,sizeof(mlpCSR));
+	if(m == NULL)
+		return NULL;
+
+	m->rows = rows;
+	m->cols = cols;
+	m->ptr = (int*) calloc(rows+1,sizeof(int));
+	m->col = (int*) malloc(sizeof(int)*(nnz > 0 ? nnz : 1));
+	m->val = (double*) malloc(sizeof(double)*(nnz > 0 ? nnz : 1));
+	if(m->ptr == NULL || m->col == NULL || m->val == NULL)
+	{
+		csrFree(m);
+		return NULL;
+	}
+
+	return m;
+}
+
+/* CSR matrix of the nonzero elements of a dense matrix */
+mlpCSR * csrFromDense(double ** x, int rows, int cols)
+{
+	int r;
+	int c;
+	long int nnz = 0;
+	mlpCSR * m;
+
+	for(r=0; r<rows; r++)
+	{
+		for(c=0; c<cols; c++)
+			nnz += x[r][c] != 0.0;
+	}
+
+	m = csrAlloc(rows,cols,nnz);
+	if(m == NULL)
+		return NULL;
+
+	nnz = 0;
+	for(r=0; r<rows; r++)
+	{
+		for(c=0; c<cols; c++)
+		{
+			if(x[r][c] != 0.0)
+			{
+				m->col[nnz] = c;
+				m->val[nnz] = x[r][c];
+				nnz++;
+			}
+		}
+		m->ptr[r+1] = nnz;
+	}
+
+	return m;
+}
+
+/* Deallocate a CSR matrix */
+void csrFree(mlpCSR * m)
+{
+	if(m == NULL)
+		return;
+
+	free(m->ptr);
+	free(m->col);
+	free(m->val);
+	free(m);
+}
+
 /* SUM WtGs = sum of (next layer G * next layer weights) */
 /* Ignore the weights relative to bias */
 void sumWtGs(double ** wgs, double *** weights, double ** gs, \
@@ -323,129 +529,358 @@ int nextLayer, int neuronsNextLayer, int neurons)
 	int weight;
 	for(weight=1; weight<(neurons+1); weight++)
 	{
-		wgs[nextLayer-1][weight] = 0; 
+		wgs[nextLayer-1][weight-1] = 0; 
 		for(neuron=0; neuron<(neuronsNextLayer); neuron++)
 		{
-			wgs[nextLayer-1][weight-1] += gs[nextLayer][weight] * \
+			wgs[nextLayer-1][weight-1] += gs[nextLayer][neuron] * \
 			weights[nextLayer][neuron][weight];
 		}
 	}
 }
 
-/* Memory Allocation of the Weights */
-double *** weightsAlloc(int * neurons, int nlayers, int ninputs)
+/* Number of weights of the MLP */
+long int weightsCount(int * neurons, int nlayers, int ninputs)
+{
+	int layer;
+	long int count = 0;
+	for(layer=0; layer<nlayers; layer++)
+	{
+		if(layer)
+			count += (long int) neurons[layer]*(neurons[layer-1]+1);
+		else
+			count += (long int) neurons[layer]*(ninputs+1);
+	}
+
+	return count;
+}
+
+/* Index of the weights over a contiguous block of memory */
+double *** weightsMap(double * data, int * neurons, int nlayers, \
+int ninputs)
 {
 	int layer;
 	int neuron;
-	int weight;
-	
+	int nin;
+
+	if(data == NULL)
+		return NULL;
+
 	double *** weights =\
 	(double ***) malloc(sizeof(double**)*nlayers); 
 	if(weights == NULL)
 		return NULL;
 
 	for(layer=0; layer<nlayers; layer++)
-    {
+	{
 		weights[layer] = \
 		(double **) malloc(sizeof(double*)*neurons[layer]); 
 		if(weights[layer] == NULL)
+		{
+			weightsUnmap(weights,layer);
 			return NULL;
+		}
 
+		nin = layer ? neurons[layer-1] : ninputs;
 		for(neuron=0; neuron<neurons[layer]; neuron++)
 		{
-			if(layer)
-			{
-				weights[layer][neuron] = (double *) \
-				malloc(sizeof(double)*(neurons[layer-1]+1));
-			}
-			else
-			{
-				weights[layer][neuron] = (double *) \
-				malloc(sizeof(double)*(ninputs+1));
-				
-			}
-			if(weights[layer][neuron] == NULL)
-				return NULL;
+			weights[layer][neuron] = data;
+			data += nin+1;
 		}
-    }
+	}
 	
 	return weights;
 }
 
-/* Deallocate memory of a traning struct */
-void trainingDestruct(training * tr)
-{	
-	int i;
-	free(tr->neurons);
-	free(tr->bias);
-	for(i=1; i<tr->examples; i++)
-	{
-		free(tr->x[i]);
-		free(tr->reference[i]);
-	}
-	free(tr->x);
-	free(tr->reference);	
-	free(tr);
+/* Deallocate the index of the weights, keep the block of memory */
+void weightsUnmap(double *** weights, int nlayers)
+{
+	int layer;
+	if(weights == NULL)
+		return;
+
+	for(layer=0; layer<nlayers; layer++)
+		free(weights[layer]);
+	free(weights);
 }
 
-/* Print the training struct */
-void trainingPrint(training * tr)
+/* Memory Allocation of the Weights */
+/* All weights are in one block, layer by layer and neuron by neuron */
+double *** weightsAlloc(int * neurons, int nlayers, int ninputs)
 {
-	int i;
-	printf("Training Data\n\n");
-	printf(">> Architecture\n");
-	printf("Layers: %d\n",tr->nlayers);
-	for(i=0; i<tr->nlayers; i++)
-	{
-		if(tr->neurons[i] == 1)
-		{
-			printf("\tLayer %d: 1 neuron\n",i);
-		}
-		else
-		{
-			printf("\tLayer %d: %d neurons\n",i,tr->neurons[i]);
-		}
-	}
+	double * data = (double*) \
+	malloc(sizeof(double)*weightsCount(neurons,nlayers,ninputs));
+	double *** weights = weightsMap(data,neurons,nlayers,ninputs);
+	if(weights == NULL)
+		free(data);
 
-	for(i=0; i<tr->nlayers; i++)
-		printf("\tBias of Layer %d: %f\n",i,tr->bias[i]);
+	return weights;
+}
 
-	printf("Inputs: %d\n",tr->ninputs);
-	printf("\n>> Training Parameters\n");
-	printf("Alpha: %.4e\n",tr->alpha);
-	printf("Learning Rate: %.8f\n",tr->lrate);
-	printf("Accepted Error: %.4e\n",tr->acceptedError);
-	printf("Maximum Iteration: %ld\n",tr->maxIteration);
+/* Deallocate memory of the Weights */
+/* 'neurons' is not used with the block of weightsAlloc, it stays for
+ * compatibility with the callers
+ */
+void weightsFree(double *** weights, int * neurons, int nlayers)
+{
+	(void) neurons;
+	if(weights == NULL)
+		return;
+
+	free(weights[0][0]);
+	weightsUnmap(weights,nlayers);
 }
 
-/* MLP initialization */
-double *** initMLP(int * neurons, int nlayers, int ninputs)
+/* Set all weights to zero */
+void weightsZero(double *** weights, int * neurons, int nlayers, \
+int ninputs)
 {
-#ifdef DEBUG_MODE
-	printf("Initializing MLP weights\n");
-#endif
+	int layer;
+	int neuron;
+	int nin;
+	for(layer=0; layer<nlayers; layer++)
+	{
+		nin = layer ? neurons[layer-1] : ninputs;
+		for(neuron=0; neuron<neurons[layer]; neuron++)
+			memset(weights[layer][neuron],0,sizeof(double)*(nin+1));
+	}
+}
 
-	double *** weights = weightsAlloc(neurons, nlayers, ninputs);
-	
+void weightsMask(double *** weights, double *** mask, int * neurons, \
+int nlayers, int ninputs)
+{
 	int layer;
 	int neuron;
-	int weight;	
-	srand(time(NULL));
+	int w;
+	int nin;
 	for(layer=0; layer<nlayers; layer++)
 	{
+		nin = layer ? neurons[layer-1] : ninputs;
 		for(neuron=0; neuron<neurons[layer]; neuron++)
 		{
-			if(layer)
-			{
-				for(weight=0; weight<(neurons[layer-1]+1); weight++)
-				{
-					weights[layer][neuron][weight] =\
-					(double) rand()/RAND_MAX;
-					#ifdef DEBUG_MODE
-						printf("Layer %d - Neuron %d",layer,neuron);
-						printf(" - Weight %d: %.6f\n",\
-						weight,weights[layer][neuron][weight]);
-					#endif
+			for(w=0; w<=nin; w++)
+				weights[layer][neuron][w] *= mask[layer][neuron][w];
+		}
+	}
+}
+
+/* Local gradient of the last layer for the output 'y' */
+void outputGradient(double * gs, double * ref, double * y, \
+int outs, int activation)
+{
+	int i;
+	switch(activation)
+	{
+		case 1:
+			for(i=0; i<outs; i++)
+				gs[i] = (ref[i] - y[i]) * y[i] * (1 - y[i]);
+			break;
+		default:
+			for(i=0; i<outs; i++)
+				gs[i] = (ref[i] - y[i]) * y[i] * (1 - y[i]);
+			break;
+	}
+}
+
+/* Accumulate the update of a layer: step += gs * [bias in] */
+void layerAccumulate(double ** step, double * gs, double bias, \
+double * in, int nin, int neurons)
+{
+	int neuron;
+	int weight;
+	double g;
+	double * s;
+	for(neuron=0; neuron<neurons; neuron++)
+	{
+		g = gs[neuron];
+		s = step[neuron];
+		s[0] += g * bias;
+		for(weight=0; weight<nin; weight++)
+			s[weight+1] += g * in[weight];
+	}
+}
+
+/* Local gradient of the previous layer: df(yprev) * SUM(gs * weights) */
+/* Ignore the weights relative to bias */
+void layerBackward(double * gsPrev, double ** weights, double * gs, \
+double * yprev, int nprev, int neurons, int activation)
+{
+	int neuron;
+	int weight;
+	double g;
+	double * w;
+
+	for(weight=0; weight<nprev; weight++)
+		gsPrev[weight] = 0;
+
+	for(neuron=0; neuron<neurons; neuron++)
+	{
+		g = gs[neuron];
+		w = weights[neuron] + 1;
+		for(weight=0; weight<nprev; weight++)
+			gsPrev[weight] += g * w[weight];
+	}
+
+	switch(activation)
+	{
+		case 1:
+			for(weight=0; weight<nprev; weight++)
+				gsPrev[weight] *= yprev[weight] * (1 - yprev[weight]);
+			break;
+		default:
+			for(weight=0; weight<nprev; weight++)
+				gsPrev[weight] *= yprev[weight] * (1 - yprev[weight]);
+			break;
+	}
+}
+
+/* Apply an accumulated update of a layer and clear it */
+void layerApply(double ** weights, double ** delta, double ** step, \
+double lrate, double alpha, int count, int nin, int neurons)
+{
+	int neuron;
+	int weight;
+	double rate = lrate / count;
+	for(neuron=0; neuron<neurons; neuron++)
+	{
+		for(weight=0; weight<(nin+1); weight++)
+		{
+			delta[neuron][weight] = rate * step[neuron][weight] + \
+			alpha * delta[neuron][weight];
+			weights[neuron][weight] += delta[neuron][weight];
+			step[neuron][weight] = 0;
+		}
+	}
+}
+
+/* Propagation and back propagation of one example */
+double exampleAccumulate(double *** weights, double *** step, \
+training * trainingData, int activation, double * x, double * ref, \
+double ** yout, double * gs, double * gsPrev)
+{
+	int nlayers = trainingData->nlayers;
+	int * neurons = trainingData->neurons;
+	int ninputs = trainingData->ninputs;
+	double * bias = trainingData->bias;
+	int outs = neurons[nlayers-1];
+
+	int layer;
+	int i;
+	double serror = 0;
+	double d;
+	double * tmp;
+
+	/* Propagation */
+	neuronsOut(yout[0],bias[0],x,ninputs,weights[0],0,neurons[0], \
+	activation);
+	for(layer=1; layer<nlayers; layer++)
+	{
+		neuronsOut(yout[layer],bias[layer],yout[layer-1], \
+		neurons[layer-1],weights[layer],0,neurons[layer],activation);
+	}
+
+	for(i=0; i<outs; i++)
+	{
+		d = ref[i] - yout[nlayers-1][i];
+		serror += d*d;
+	}
+
+	/* Backpropagation */
+	outputGradient(gs,ref,yout[nlayers-1],outs,activation);
+	for(layer=nlayers-1; layer>0; layer--)
+	{
+		layerAccumulate(step[layer],gs,bias[layer],yout[layer-1], \
+		neurons[layer-1],neurons[layer]);
+		layerBackward(gsPrev,weights[layer],gs,yout[layer-1], \
+		neurons[layer-1],neurons[layer],activation);
+		tmp = gs;
+		gs = gsPrev;
+		gsPrev = tmp;
+	}
+	layerAccumulate(step[0],gs,bias[0],x,ninputs,neurons[0]);
+
+	return serror/outs;
+}
+
+/* Default values of a training struct */
+void trainingInit(training * tr)
+{
+	memset(tr,0,sizeof(training));
+}
+
+/* Deallocate memory of a traning struct */
+void trainingDestruct(training * tr)
+{	
+	int i;
+	free(tr->neurons);
+	free(tr->bias);
+	for(i=1; i<tr->examples; i++)
+	{
+		free(tr->x[i]);
+		free(tr->reference[i]);
+	}
+	free(tr->x);
+	free(tr->reference);	
+	free(tr);
+}
+
+/* Print the training struct */
+void trainingPrint(training * tr)
+{
+	int i;
+	printf("Training Data\n\n");
+	printf(">> Architecture\n");
+	printf("Layers: %d\n",tr->nlayers);
+	for(i=0; i<tr->nlayers; i++)
+	{
+		if(tr->neurons[i] == 1)
+		{
+			printf("\tLayer %d: 1 neuron\n",i);
+		}
+		else
+		{
+			printf("\tLayer %d: %d neurons\n",i,tr->neurons[i]);
+		}
+	}
+
+	for(i=0; i<tr->nlayers; i++)
+		printf("\tBias of Layer %d: %f\n",i,tr->bias[i]);
+
+	printf("Inputs: %d\n",tr->ninputs);
+	printf("\n>> Training Parameters\n");
+	printf("Alpha: %.4e\n",tr->alpha);
+	printf("Learning Rate: %.8f\n",tr->lrate);
+	printf("Accepted Error: %.4e\n",tr->acceptedError);
+	printf("Maximum Iteration: %ld\n",tr->maxIteration);
+}
+
+/* MLP initialization */
+double *** initMLP(int * neurons, int nlayers, int ninputs)
+{
+#ifdef DEBUG_MODE
+	printf("Initializing MLP weights\n");
+#endif
+
+	double *** weights = weightsAlloc(neurons, nlayers, ninputs);
+	
+	int layer;
+	int neuron;
+	int weight;	
+	srand(time(NULL));
+	for(layer=0; layer<nlayers; layer++)
+	{
+		for(neuron=0; neuron<neurons[layer]; neuron++)
+		{
+			if(layer)
+			{
+				for(weight=0; weight<(neurons[layer-1]+1); weight++)
+				{
+					weights[layer][neuron][weight] =\
+					(double) rand()/RAND_MAX;
+					#ifdef DEBUG_MODE
+						printf("Layer %d - Neuron %d",layer,neuron);
+						printf(" - Weight %d: %.6f\n",\
+						weight,weights[layer][neuron][weight]);
+					#endif
 				}
 			}
 			else
@@ -470,9 +905,176 @@ double *** initMLP(int * neurons, int nlayers, int ninputs)
 	return weights;
 }
 
+/* Take 'bytes' of the arena aligned to MLP_ARENA_ALIGN,
+ * with base NULL only count the bytes
+ */
+static void * arenaTake(char * base, size_t * used, size_t bytes)
+{
+	size_t at = (*used + MLP_ARENA_ALIGN-1)/MLP_ARENA_ALIGN*MLP_ARENA_ALIGN;
+	*used = at + bytes;
+	return base ? base + at : NULL;
+}
+
+/* Vector by layer in the arena, neurons[layer] elements */
+static double ** arenaLayers(char * base, size_t * used, int * neurons, \
+int nlayers)
+{
+	int i;
+	double ** v = (double**) arenaTake(base,used,sizeof(double*)*nlayers);
+	double * data;
+	for(i=0; i<nlayers; i++)
+	{
+		data = (double*) arenaTake(base,used,sizeof(double)*neurons[i]);
+		if(base)
+			v[i] = data;
+	}
+	return v;
+}
+
+/* Weights in the arena, same layout of weightsMap */
+static double *** arenaWeights(char * base, size_t * used, int * neurons, \
+int nlayers, int ninputs)
+{
+	int layer;
+	int neuron;
+	int nin;
+	double *** w = (double***) \
+	arenaTake(base,used,sizeof(double**)*nlayers);
+	double ** rows;
+	double * data;
+	for(layer=0; layer<nlayers; layer++)
+	{
+		rows = (double**) \
+		arenaTake(base,used,sizeof(double*)*neurons[layer]);
+		if(base)
+			w[layer] = rows;
+	}
+	data = (double*) arenaTake(base,used, \
+	sizeof(double)*weightsCount(neurons,nlayers,ninputs));
+	if(base)
+	{
+		for(layer=0; layer<nlayers; layer++)
+		{
+			nin = layer ? neurons[layer-1] : ninputs;
+			for(neuron=0; neuron<neurons[layer]; neuron++)
+			{
+				w[layer][neuron] = data;
+				data += nin+1;
+			}
+		}
+	}
+	return w;
+}
+
+/* Buffers of the workspace over the arena 'base' (NULL only counts)
+ * return bytes of the arena
+ */
+static size_t workspaceLayout(mlpWorkspace * ws, char * base, \
+training * trainingData)
+{
+	int nlayers = trainingData->nlayers;
+	int * neurons = trainingData->neurons;
+	int ninputs = trainingData->ninputs;
+	int examples = trainingData->examples;
+	size_t used = 0;
+
+	ws->weightsPast = arenaWeights(base,&used,neurons,nlayers,ninputs);
+	ws->weightsSwap = arenaWeights(base,&used,neurons,nlayers,ninputs);
+	ws->yout = arenaLayers(base,&used,neurons,nlayers);
+	ws->weightsBest = trainingData->validation > 0 ? \
+	arenaWeights(base,&used,neurons,nlayers,ninputs) : NULL;
+	ws->error = (double*) \
+	arenaTake(base,&used,sizeof(double)*neurons[nlayers-1]);
+	ws->df = arenaLayers(base,&used,neurons,nlayers);
+	ws->gs = arenaLayers(base,&used,neurons,nlayers);
+	ws->wgs = arenaLayers(base,&used,neurons,nlayers-1);
+	ws->xidx = (int*) arenaTake(base,&used,sizeof(int)*examples);
+	ws->histSize = trainingData->maxIteration/examples + 1;
+	ws->mseHist = (double*) \
+	arenaTake(base,&used,sizeof(double)*ws->histSize);
+
+	return used;
+}
+
+/* Bytes of the training workspace */
+size_t workspaceSize(training * trainingData)
+{
+	mlpWorkspace ws;
+	return workspaceLayout(&ws,NULL,trainingData);
+}
+
+/* Create a training workspace */
+mlpWorkspace * workspaceCreate(training * trainingData)
+{
+	mlpWorkspace * ws = (mlpWorkspace*) calloc(1,sizeof(mlpWorkspace));
+	if(ws == NULL)
+		return NULL;
+
+	if(workspaceFit(ws,trainingData))
+	{
+		workspaceDestroy(ws);
+		return NULL;
+	}
+
+	return ws;
+}
+
+/* Fit the workspace to a training, grow the arena if needed */
+int workspaceFit(mlpWorkspace * ws, training * trainingData)
+{
+	void * arena;
+	size_t size = workspaceSize(trainingData);
+
+	if(size > ws->size)
+	{
+		free(ws->arena);
+		ws->arena = NULL;
+		ws->size = 0;
+		if(posix_memalign(&arena,MLP_ARENA_ALIGN,size))
+			return 1;
+		ws->arena = (char*) arena;
+		ws->size = size;
+	}
+
+	ws->used = workspaceLayout(ws,ws->arena,trainingData);
+	return 0;
+}
+
+/* Deallocate the workspace */
+void workspaceDestroy(mlpWorkspace * ws)
+{
+	if(ws == NULL)
+		return;
+
+	free(ws->arena);
+	free(ws);
+}
+
 /* MLP Training */
 double * trainingMLP(double *** weights, training * trainingData, \
 char * activation)
+{
+	double * hist;
+	double * mse_hist = NULL;
+	mlpWorkspace * ws = workspaceCreate(trainingData);
+	if(ws == NULL)
+		return NULL;
+
+	hist = trainingMLPWorkspace(weights,trainingData,activation,ws);
+	if(hist != NULL)
+	{
+		mse_hist = (double*) malloc(sizeof(double)*((long int) hist[0]+1));
+		if(mse_hist != NULL)
+			memcpy(mse_hist,hist,sizeof(double)*((long int) hist[0]+1));
+	}
+
+	workspaceDestroy(ws);
+	return mse_hist;
+}
+
+/* MLP Training over a workspace */
+double * trainingMLPWorkspace(double *** weights, training * trainingData, \
+char * activation, mlpWorkspace * ws)
 {
 	int nlayers = trainingData->nlayers;
 	int * neurons = trainingData->neurons;
@@ -487,80 +1089,48 @@ char * activation)
 	long int maxIteration = trainingData->maxIteration;
 
 	int layer;
-	int neuron;
-	int weight;
 	int i;
-	int j;
 	int actv = getActv(activation);
 
-	/* Memory of past weights and swap weights */
-	double *** weightsPast = weightsAlloc(neurons, nlayers, ninputs);
-	double *** weightsSwap = weightsAlloc(neurons, nlayers, ninputs);
-	for(layer=0; layer<nlayers; layer++)
-	{
-		for(neuron=0; neuron<neurons[layer]; neuron++)
-		{
-			if(layer)
-			{
-				for(weight=0; weight<(neurons[layer-1]+1); weight++)
-					weightsPast[layer][neuron][weight] = 0;
-			}
-			else
-			{
-				for(weight=0; weight<(ninputs+1); weight++)
-					weightsPast[layer][neuron][weight] = 0;
-			}
-		}
-	}	
-
-	if(weightsPast == NULL)
+	if(workspaceFit(ws,trainingData))
 		return NULL;
 
-	/* Memory for layers outputs */
-	double ** yout = (double**) malloc(sizeof(double*)*nlayers);
-	for(i=0; i<nlayers; i++)
-		yout[i] = (double*) malloc(sizeof(double)*neurons[i]);
-		
-	/* Memory for last layers outputs of the examples */
-	double ** youtLastLayers = (double**) \
-	malloc(sizeof(double*)*examples);
-	for(i=0; i<examples; i++)
-	{
-		youtLastLayers[i] = (double*) \
-		malloc(sizeof(double)*neurons[nlayers-1]);
-	}
+	/* Past weights and swap weights */
+	double *** weightsPast = ws->weightsPast;
+	double *** weightsSwap = ws->weightsSwap;
+	weightsZero(weightsPast,neurons,nlayers,ninputs);
+	if(ws->mask != NULL)
+		weightsMask(weights,ws->mask,neurons,nlayers,ninputs);
 
+	/* Layers outputs */
+	double ** yout = ws->yout;
+		
 	/* MLP error */
-	double * error = (double*) \
-	malloc(sizeof(double)*neurons[nlayers-1]);
+	double * error = ws->error;
 
 	/* Derivative of the activation function */
-	double ** df = (double**) \
-	malloc(sizeof(double*)*nlayers);
-	for(i=0; i<nlayers; i++)
-		df[i] = (double*) malloc(sizeof(double)*neurons[i]);
+	double ** df = ws->df;
 
 	/* Local gradient. */
 	/* Last layer = Error * df.	*/
 	/* Others layers = df * SUM */
 	/* SUM = sum of (next layer G * next layer weights) */
-	double ** gs = (double**) \
-	malloc(sizeof(double*)*nlayers);
-	for(i=0; i<nlayers; i++)
-		gs[i] = (double*) malloc(sizeof(double)*neurons[i]);
+	double ** gs = ws->gs;
 	
 	/* SUM WtGs = sum of (next layer G * next layer weights) */
 	/* Ignore the weights relative to bias */
-	double ** wgs = (double**) \
-	malloc(sizeof(double*)*nlayers-1);
-	for(i=0; i<(nlayers-1); i++)
-		wgs[i] = (double*) malloc(sizeof(double)*neurons[i]);
+	double ** wgs = ws->wgs;
 
 	/* Mean Square Error */
 	double mse = acceptedError+1;
+	mlpMetrics metrics;
+
+	/* Early stopping by the MSE of the validation set */
+	double bestMse = INFINITY;
+	int stall = 0;
 
 	/* Index of examples */
-	int * xidx = (int*) malloc(sizeof(int)*examples);
+	int * xidx = ws->xidx;
 	for(i=0; i<examples; i++)
 		xidx[i] = i;
 	
@@ -569,11 +1139,27 @@ char * activation)
 	long int counter = 0;
 	/* The position 0 of mse_hist is the last position of history */
 	long int mse_counter = 1;
-	double * mse_hist = (double*) \
-	malloc(sizeof(double)*floor(maxIteration/examples));
+	double * mse_hist = ws->mseHist;
 	int progress = 0;
 	int displayStep = ceil(0.05*maxIteration);
-	vperm(xidx,examples);
+	/* Rows of the current example: xs[xi] (or sx row xi), rs[xi] */
+	double ** xs = x;
+	double ** rs = ref;
+	mlpCSR * sx = trainingData->xSparse;
+	int xi = 0;
+#ifdef MLP_LOADER
+	/* Shuffled batches staged by a background thread (dense inputs) */
+	mlpLoader * loader = NULL;
+	loaderBuffer * batch = NULL;
+	if(sx == NULL)
+	{
+		loader = loaderCreate(trainingData,MLP_LOADER_BATCH, \
+		(unsigned int) (ws->seed != NULL ? rand_r(ws->seed) : rand()));
+		if(loader == NULL)
+			return NULL;
+	}
+#endif
+	workspacePerm(ws,xidx,examples);
 	while(mse > acceptedError && counter < maxIteration)
 	{
 		/* Iteration Number */
@@ -581,12 +1167,34 @@ char * activation)
 		
 		/* Number of Training Example */
 		ex = (ex % examples)+1;
+#ifdef MLP_LOADER
+		if(loader != NULL)
+		{
+			if(batch == NULL || ++xi == batch->count)
+			{
+				batch = loaderNext(loader);
+				xs = batch->x;
+				rs = batch->reference;
+				xi = 0;
+			}
+		}
+		else
+#endif
+		xi = xidx[ex-1];
 
 		/* Propagation */	
 		
 		/* Out of first layer */
-		layerOut0(yout,bias[0],x,xidx[(ex-1)],ninputs,\
-		weights,neurons[0],actv);
+		if(sx != NULL)
+		{
+			layerOut0Sparse(yout,bias[0],sx,xi,weights, \
+			neurons[0],actv);
+		}
+		else
+		{
+			layerOut0(yout,bias[0],xs,xi,ninputs,\
+			weights,neurons[0],actv);
+		}
 
 		for(layer=1; layer<nlayers; layer++)
 		{
@@ -600,7 +1208,7 @@ char * activation)
 		/* Neuron Update = learning-rate*G*y(layer-1) */
 
 		/* Error = yref - y */
-		errorMLP(error,ref,xidx[(ex-1)],yout,nlayers-1, \
+		errorMLP(error,rs,xi,yout,nlayers-1, \
 		neurons[nlayers-1]);
 		
 		/* Derivative of the activation function = df */
@@ -610,7 +1218,10 @@ char * activation)
 		gradientLast(gs,error,df,nlayers-1,neurons[nlayers-1]);
 
 		/* Save weights in swap weights*/
-		weightsCopy(weights,weightsSwap,neurons,nlayers,ninputs);
+		if(sx != NULL)
+			weightsCopySparse(weights,weightsSwap,neurons,nlayers,sx,xi);
+		else
+			weightsCopy(weights,weightsSwap,neurons,nlayers,ninputs);
 
 		/* Update layer */
 		updateLayer(weights,alpha,weightsPast, lrate, gs, \
@@ -637,32 +1248,63 @@ char * activation)
 				lrate, gs, bias[i], yout, i, neurons[i], \
 				neurons[i-1]);
 			}
+			else if(sx != NULL)
+			{
+				updateLayer0Sparse(weights,alpha,weightsPast, \
+				lrate, gs, bias[i], sx, xi, neurons[i]);
+			}
 			else
 			{
 				updateLayer0(weights,alpha,weightsPast, \
-				lrate, gs, bias[i], x, xidx[ex-1], \
+				lrate, gs, bias[i], xs, xi, \
 				neurons[i], ninputs);
 			}
 		}
 
-		/* Save past weights */
-		weightsCopy(weightsSwap,weightsPast,neurons,nlayers,ninputs);
+		/* Pruned weights do not grow back */
+		if(ws->mask != NULL)
+			weightsMask(weights,ws->mask,neurons,nlayers,ninputs);
 
-		/* Save output of the examples */
-		for(i=0; i<neurons[nlayers-1]; i++)
-			youtLastLayers[xidx[ex-1]][i] = yout[nlayers-1][i];
+		/* Save past weights */
+		if(sx != NULL)
+			weightsCopySparse(weightsSwap,weightsPast,neurons,nlayers,sx,xi);
+		else
+			weightsCopy(weightsSwap,weightsPast,neurons,nlayers,ninputs);
 
 		/* Mean Square Error. */
 		if (ex == examples)
 		{
-			/* MSE */
-			mse = mseb(ref,youtLastLayers, \
-			examples,neurons[nlayers-1]);
+			/* MSE with the weights of the end of the epoch */
+			if(workspaceEvaluate(ws,weights,trainingData,activation, \
+			sx != NULL ? NULL : x,ref,examples,&metrics))
+				break;
+			mse = metrics.mse;
 			/* Change order of training set */
-			vperm(xidx,examples);
+			workspacePerm(ws,xidx,examples);
 			/* Save history of MSE */
 			mse_hist[mse_counter] = mse;
 			mse_counter += 1;
+
+			/* Early stopping, keep the best weights */
+			if(trainingData->validation > 0)
+			{
+				if(workspaceEvaluate(ws,weights,trainingData, \
+				activation,trainingData->xValidation, \
+				trainingData->refValidation, \
+				trainingData->validation,&metrics))
+					break;
+				if(metrics.mse < bestMse)
+				{
+					bestMse = metrics.mse;
+					stall = 0;
+					weightsCopy(weights,ws->weightsBest,neurons, \
+					nlayers,ninputs);
+				}
+				else if(++stall >= trainingData->patience)
+				{
+					break;
+				}
+			}
 		}
 
 		/* Display the progress */
@@ -676,34 +1318,28 @@ char * activation)
 		progress += 1;
 #endif
 	}
+#ifdef MLP_LOADER
+	loaderDestroy(loader);
+#endif
+	if(trainingData->validation > 0 && bestMse < INFINITY)
+		weightsCopy(ws->weightsBest,weights,neurons,nlayers,ninputs);
 
 	/* Add in the position '0' the 'mse_counter'-1 
 	 * to identify the last position of history
 	 */
 	mse_hist[0] = mse_counter-1;
 
-	/* Deallocate memory */
-	// weightsPast
-	// yout
-	// youtLastLayers
-	// error
-	// gs
-	// df
-	// wgs
-	// xidx
-
 	/* Return history of MSE */
 	return mse_hist;
 }
 
-/* Output of MLP */
-void outMLP(double *** weights, training * trainingData, \
-char * activation, double ** in, int pos, double * out)
+/* Output of MLP for a dense row in[pos] or a CSR row 'sparse' pos */
+static void outRow(double *** weights, training * trainingData, \
+char * activation, double ** in, mlpCSR * sparse, int pos, double * out)
 {
 	int nlayers = trainingData->nlayers;
 	int * neurons = trainingData->neurons;
 	int ninputs = trainingData->ninputs;
-	double alpha = trainingData->alpha;
 	double * bias = trainingData->bias;
 
 	int layer;
@@ -718,8 +1354,16 @@ char * activation, double ** in, int pos, double * out)
 	/* Propagation */	
 		
 	/* Out of first layer */
-	layerOut0(yout,bias[0],in,pos,ninputs,\
-	weights,neurons[0],actv);
+	if(sparse != NULL)
+	{
+		layerOut0Sparse(yout,bias[0],sparse,pos,weights, \
+		neurons[0],actv);
+	}
+	else
+	{
+		layerOut0(yout,bias[0],in,pos,ninputs,\
+		weights,neurons[0],actv);
+	}
 
 	for(layer=1; layer<nlayers; layer++)
 	{
@@ -739,11 +1383,409 @@ char * activation, double ** in, int pos, double * out)
 	free(yout);
 }
 
+/* Output of MLP */
+void outMLP(double *** weights, training * trainingData, \
+char * activation, double ** in, int pos, double * out)
+{
+	outRow(weights,trainingData,activation,in,NULL,pos,out);
+}
+
+/* Output of MLP for a CSR row */
+void outMLPSparse(double *** weights, training * trainingData, \
+char * activation, mlpCSR * in, int pos, double * out)
+{
+	outRow(weights,trainingData,activation,NULL,in,pos,out);
+}
+
+/* Output of MLP for a batch of dense rows in[] or CSR rows 'sparse' */
+static void outBatch(double *** weights, training * trainingData, \
+char * activation, double ** in, mlpCSR * sparse, int first, int count, \
+double ** out)
+{
+	int nlayers = trainingData->nlayers;
+	int * neurons = trainingData->neurons;
+	int ninputs = trainingData->ninputs;
+	double * bias = trainingData->bias;
+
+	int layer;
+	int e;
+	int n;
+	int block;
+	int width = ninputs;
+	int actv = getActv(activation);
+	double * a;
+	double * b;
+	double * tmp;
+
+	for(layer=0; layer<nlayers; layer++)
+	{
+		if(neurons[layer] > width)
+			width = neurons[layer];
+	}
+
+	/* Memory for the outputs of a block of examples */
+	a = (double*) malloc(sizeof(double)*MLP_BATCH_BLOCK*width);
+	b = (double*) malloc(sizeof(double)*MLP_BATCH_BLOCK*width);
+	if(a == NULL || b == NULL)
+	{
+		free(a);
+		free(b);
+		for(e=0; e<count; e++)
+		{
+			outRow(weights,trainingData,activation,in,sparse,first+e, \
+			out[e]);
+		}
+		return;
+	}
+
+	for(block=0; block<count; block+=MLP_BATCH_BLOCK)
+	{
+		n = count - block;
+		if(n > MLP_BATCH_BLOCK)
+			n = MLP_BATCH_BLOCK;
+
+		/* Propagation */
+		if(sparse != NULL)
+		{
+			/* Sparse rows times the dense weights of layer 0 */
+			for(e=0; e<n; e++)
+			{
+				neuronsOutSparse(b + e*neurons[0],bias[0],sparse, \
+				first+block+e,weights[0],0,neurons[0],actv);
+			}
+		}
+		else
+		{
+			for(e=0; e<n; e++)
+			{
+				memcpy(a + e*ninputs,in[first+block+e], \
+				sizeof(double)*ninputs);
+			}
+			layerOutBatch(b,a,n,bias[0],weights[0],ninputs, \
+			neurons[0],actv);
+		}
+		for(layer=1; layer<nlayers; layer++)
+		{
+			tmp = a;
+			a = b;
+			b = tmp;
+			layerOutBatch(b,a,n,bias[layer],weights[layer], \
+			neurons[layer-1],neurons[layer],actv);
+		}
+
+		/* Copy output of last layer to out */
+		for(e=0; e<n; e++)
+		{
+			memcpy(out[block+e],b + e*neurons[nlayers-1], \
+			sizeof(double)*neurons[nlayers-1]);
+		}
+	}
+
+	free(a);
+	free(b);
+}
+
+/* Output of MLP for a batch of inputs */
+void outMLPBatch(double *** weights, training * trainingData, \
+char * activation, double ** in, int first, int count, double ** out)
+{
+	outBatch(weights,trainingData,activation,in,NULL,first,count,out);
+}
+
+/* Output of MLP for a batch of CSR rows */
+void outMLPBatchSparse(double *** weights, training * trainingData, \
+char * activation, mlpCSR * in, int first, int count, double ** out)
+{
+	outBatch(weights,trainingData,activation,NULL,in,first,count,out);
+}
+
+/* Sums of the metrics of a block of 'n' examples
+ * y, r = outputs and references, n X outs contiguous
+ * The squared errors are summed in four lanes without branches, which
+ * the compiler vectorizes. The cross entropy has its own loop with the
+ * clamps by fmin/fmax, log is only vectorized with -ffast-math (vector
+ * math library)
+ */
+static void metricsBlock(mlpMetrics * metrics, double * y, double * r, \
+int n, int outs)
+{
+	long int size = (long int) n*outs;
+	long int i;
+	int e;
+	int o;
+	int k;
+	int yo;
+	int ro;
+	double d;
+	double p;
+	double se[4] = {0.0, 0.0, 0.0, 0.0};
+	double ce = 0.0;
+
+	for(i=0; i+4<=size; i+=4)
+	{
+		for(k=0; k<4; k++)
+			se[k] += (r[i+k] - y[i+k])*(r[i+k] - y[i+k]);
+	}
+	for(; i<size; i++)
+	{
+		d = r[i] - y[i];
+		se[0] += d*d;
+	}
+	metrics->mse += (se[0] + se[1]) + (se[2] + se[3]);
+
+	for(i=0; i<size; i++)
+	{
+		p = fmin(fmax(y[i],MLP_EVAL_EPSILON),1.0-MLP_EVAL_EPSILON);
+		ce -= r[i]*log(p) + (1.0-r[i])*log(1.0-p);
+	}
+	metrics->crossEntropy += ce;
+
+	/* Hit: same side of 0.5 with one output, same largest output else */
+	for(e=0; e<n; e++, y+=outs, r+=outs)
+	{
+		if(outs == 1)
+		{
+			metrics->accuracy += (y[0] >= 0.5) == (r[0] >= 0.5);
+			continue;
+		}
+		yo = 0;
+		ro = 0;
+		for(o=1; o<outs; o++)
+		{
+			if(y[o] > y[yo])
+				yo = o;
+			if(r[o] > r[ro])
+				ro = o;
+		}
+		metrics->accuracy += yo == ro;
+	}
+}
+
+/* Evaluation of a set of examples */
+int evalMLP(double *** weights, training * trainingData, \
+char * activation, double ** x, double ** ref, int first, int count, \
+mlpMetrics * metrics)
+{
+	int outs = trainingData->neurons[trainingData->nlayers-1];
+	int block;
+	int n;
+	int e;
+	double * y = (double*) malloc(sizeof(double)*MLP_BATCH_BLOCK*outs);
+	double * r = (double*) malloc(sizeof(double)*MLP_BATCH_BLOCK*outs);
+	double ** rows = (double**) malloc(sizeof(double*)*MLP_BATCH_BLOCK);
+
+	memset(metrics,0,sizeof(mlpMetrics));
+	if(y == NULL || r == NULL || rows == NULL)
+	{
+		free(y);
+		free(r);
+		free(rows);
+		return 1;
+	}
+	for(e=0; e<MLP_BATCH_BLOCK; e++)
+		rows[e] = y + e*outs;
+
+	for(block=0; block<count; block+=MLP_BATCH_BLOCK)
+	{
+		n = count - block;
+		if(n > MLP_BATCH_BLOCK)
+			n = MLP_BATCH_BLOCK;
+
+		if(x != NULL)
+		{
+			outMLPBatch(weights,trainingData,activation,x, \
+			first+block,n,rows);
+		}
+		else
+		{
+			outMLPBatchSparse(weights,trainingData,activation, \
+			trainingData->xSparse,first+block,n,rows);
+		}
+		for(e=0; e<n; e++)
+			memcpy(r + e*outs,ref[first+block+e],sizeof(double)*outs);
+		metricsBlock(metrics,y,r,n,outs);
+	}
+
+	/* Means by example and output */
+	metrics->examples = count;
+	if(count > 0)
+	{
+		metrics->mse /= (double) count*outs;
+		metrics->crossEntropy /= (double) count*outs;
+		metrics->accuracy /= count;
+	}
+
+	free(y);
+	free(r);
+	free(rows);
+	return 0;
+}
+
+/* Merge the metrics 'b' in 'a' */
+void metricsMerge(mlpMetrics * a, mlpMetrics * b)
+{
+	long int n = a->examples + b->examples;
+	if(n == 0)
+		return;
+
+	a->mse = (a->mse*a->examples + b->mse*b->examples)/n;
+	a->crossEntropy = (a->crossEntropy*a->examples + \
+	b->crossEntropy*b->examples)/n;
+	a->accuracy = (a->accuracy*a->examples + b->accuracy*b->examples)/n;
+	a->examples = n;
+}
+
+/* Evaluation by the evaluator of the workspace */
+int workspaceEvaluate(mlpWorkspace * ws, double *** weights, \
+training * trainingData, char * activation, double ** x, double ** ref, \
+int count, mlpMetrics * metrics)
+{
+	if(ws->evaluate != NULL)
+	{
+		return ws->evaluate(ws->evaluateArg,weights,trainingData, \
+		activation,x,ref,count,metrics);
+	}
+
+	return evalMLP(weights,trainingData,activation,x,ref,0,count,metrics);
+}
+
+/* Write the configuration lines of a model file */
+void saveMLPConf(FILE * f, training * trainingData)
+{
+	int l;
+	int nlayers = trainingData->nlayers;
+
+	fprintf(f,"%d\n",nlayers);
+	for(l=0; l<nlayers; l++)
+		fprintf(f,l ? " %d" : "%d",trainingData->neurons[l]);
+	fprintf(f,"\n%d\n",trainingData->ninputs);
+	for(l=0; l<nlayers; l++)
+		fprintf(f,l ? " %.17g" : "%.17g",trainingData->bias[l]);
+	fprintf(f,"\n%.17g\n%.17g\n%.17g\n%ld\n",trainingData->alpha, \
+	trainingData->lrate,trainingData->acceptedError, \
+	trainingData->maxIteration);
+}
+
+/* Read the configuration lines of a model file */
+int loadMLPConf(FILE * f, training * trainingData)
+{
+	int l;
+	int ok;
+
+	if(fscanf(f,"%d",&trainingData->nlayers) != 1 || \
+	trainingData->nlayers < 1)
+		return 1;
+
+	trainingData->neurons = (int*) \
+	malloc(sizeof(int)*trainingData->nlayers);
+	trainingData->bias = (double*) \
+	malloc(sizeof(double)*trainingData->nlayers);
+	ok = trainingData->neurons != NULL && trainingData->bias != NULL;
+	for(l=0; ok && l<trainingData->nlayers; l++)
+		ok = fscanf(f,"%d",&trainingData->neurons[l]) == 1 && \
+		trainingData->neurons[l] > 0;
+	ok = ok && fscanf(f,"%d",&trainingData->ninputs) == 1 && \
+	trainingData->ninputs > 0;
+	for(l=0; ok && l<trainingData->nlayers; l++)
+		ok = fscanf(f,"%lf",&trainingData->bias[l]) == 1;
+	ok = ok && fscanf(f,"%lf %lf %lf %ld",&trainingData->alpha, \
+	&trainingData->lrate,&trainingData->acceptedError, \
+	&trainingData->maxIteration) == 4;
+
+	if(!ok)
+	{
+		free(trainingData->neurons);
+		free(trainingData->bias);
+		trainingData->neurons = NULL;
+		trainingData->bias = NULL;
+		return 1;
+	}
+
+	return 0;
+}
+
 /* Save training data and weights of MLP in a file */
-void saveMLP(char * filename, training * trainingData, \
+int saveMLP(char * filename, training * trainingData, \
 double *** weights)
 {
+	int nlayers = trainingData->nlayers;
+	int * neurons = trainingData->neurons;
+	int ninputs = trainingData->ninputs;
+
+	int l;
+	int n;
+	int w;
+	int nin;
+	FILE * f = fopen(filename,"w");
+	if(f == NULL)
+		return 1;
+
+	fprintf(f,"%s\n",MLP_FILE_MAGIC);
+	saveMLPConf(f,trainingData);
+
+	for(l=0; l<nlayers; l++)
+	{
+		nin = l ? neurons[l-1] : ninputs;
+		for(n=0; n<neurons[l]; n++)
+		{
+			for(w=0; w<(nin+1); w++)
+				fprintf(f,w ? " %.17g" : "%.17g",weights[l][n][w]);
+			fprintf(f,"\n");
+		}
+	}
+
+	if(fclose(f) != 0)
+		return 1;
+
+	return 0;
+}
+
+/* Load the configuration and weights of MLP from a file */
+double *** loadMLP(char * filename, training * trainingData)
+{
+	char magic[32];
+	int ok = 1;
+	long int k;
+	long int count;
+	double *** weights;
+	FILE * f = fopen(filename,"r");
+	if(f == NULL)
+		return NULL;
 
+	memset(trainingData,0,sizeof(training));
+	if(fscanf(f,"%31s",magic) != 1 || strcmp(magic,MLP_FILE_MAGIC) != 0)
+	{
+		fclose(f);
+		return NULL;
+	}
+	ok = loadMLPConf(f,trainingData) == 0;
+
+	weights = NULL;
+	if(ok)
+	{
+		weights = weightsAlloc(trainingData->neurons, \
+		trainingData->nlayers,trainingData->ninputs);
+	}
+	if(weights != NULL)
+	{
+		count = weightsCount(trainingData->neurons, \
+		trainingData->nlayers,trainingData->ninputs);
+		for(k=0; ok && k<count; k++)
+			ok = fscanf(f,"%lf",&weights[0][0][k]) == 1;
+	}
+	fclose(f);
+
+	if(!ok || weights == NULL)
+	{
+		weightsFree(weights,trainingData->neurons,trainingData->nlayers);
+		free(trainingData->neurons);
+		free(trainingData->bias);
+		trainingData->neurons = NULL;
+		trainingData->bias = NULL;
+		return NULL;
+	}
+
+	return weights;
 }
 
 /* Load the examples, references and configuration from files. */
@@ -31,6 +31,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 #include <time.h>
 
 /* Prints enabled/disabled */
@@ -38,6 +39,36 @@
     #define DEBUG_MODE
 #endif
 
+/* Examples by block in batch mode */
+#ifndef MLP_BATCH_BLOCK
+	#define MLP_BATCH_BLOCK 64
+#endif
+
+/* Alignment (bytes) of the buffers of the training workspace */
+#ifndef MLP_ARENA_ALIGN
+	#define MLP_ARENA_ALIGN 64
+#endif
+
+/* Bound of the outputs in the logarithms of the cross-entropy */
+#ifndef MLP_EVAL_EPSILON
+	#define MLP_EVAL_EPSILON 1e-12
+#endif
+
+/* First line of the files of saveMLP */
+#define MLP_FILE_MAGIC "MLP1"
+
+/* Sparse matrix in CSR format: the nonzero elements of the row r are
+ * val[k] in the column col[k] for k in [ptr[r],ptr[r+1])
+ */
+typedef struct
+{
+	int rows;
+	int cols;
+	int * ptr;
+	int * col;
+	double * val;
+} mlpCSR;
+
 /* Vector Rand Permutation */
 void vperm(int * a, int sz);
 
@@ -54,6 +85,24 @@ int getActv(char * name);
 /* Sigmoid function */
 void sigmoid(double ** ori, double ** dest, int layer, double sz);
 
+/* Activation function (id of getActv) of the sum of a neuron */
+double activationOut(double sum, int activation);
+
+/* Out of the neurons [begin,end) of a layer for the input vector 'in'
+ * dest = outputs of the layer
+ * in = outputs of the previous layer (or the example), 'nin' elements
+ * weights = weights of the layer, neurons X (nin+1), bias weight first
+ */
+void neuronsOut(double * dest, double bias, double * in, int nin, \
+double ** weights, int begin, int end, int activation);
+
+/* Out of a layer for 'count' input vectors
+ * dest = count X neurons
+ * in = count X nin
+ */
+void layerOutBatch(double * dest, double * in, int count, double bias, \
+double ** weights, int nin, int neurons, int activation);
+
 /* Layer 0 Out  */
 void layerOut0(double ** dest, double bias, \
 double ** examples, int example, int ninputs, \
@@ -93,15 +142,105 @@ void updateLayer0(double *** weights,double alpha, \
 double *** weightsPast, double lrate, double ** gs, double bias, \
 double ** ref, int example, int neurons, int ninputs);
 
+/* Out of the neurons [begin,end) of the first layer for the CSR row
+ * 'row' of 'in', only the nonzero columns
+ */
+void neuronsOutSparse(double * dest, double bias, mlpCSR * in, int row, \
+double ** weights, int begin, int end, int activation);
+
+/* Out of first layer for a CSR row */
+void layerOut0Sparse(double ** dest, double bias, mlpCSR * examples, \
+int example, double *** weights, int nneurons, int activation);
+
+/* Update Layer 0 for a CSR row, only the weights of the bias and of
+ * the nonzero columns. The weights of the other columns do not get the
+ * term alpha*weightsPast of the dense update, at their next nonzero
+ * they get it once with the past weights of their last update, so the
+ * training with CSR inputs equals the dense training only for alpha = 0
+ */
+void updateLayer0Sparse(double *** weights,double alpha, \
+double *** weightsPast, double lrate, double ** gs, double bias, \
+mlpCSR * examples, int example, int neurons);
+
+/* Copy Weights, in layer 0 only the bias and the nonzero columns of
+ * the CSR row 'example'
+ */
+void weightsCopySparse(double *** ori, double *** dest, int * neurons, \
+int nlayers, mlpCSR * examples, int example);
+
+/* CSR matrix rows X cols with space for 'nnz' nonzero elements,
+ * ptr is zeroed. return NULL in error
+ */
+mlpCSR * csrAlloc(int rows, int cols, long int nnz);
+
+/* CSR matrix of the nonzero elements of a dense matrix rows X cols */
+mlpCSR * csrFromDense(double ** x, int rows, int cols);
+
+/* Deallocate a CSR matrix */
+void csrFree(mlpCSR * m);
+
 /* SUM WtGs = sum of (next layer G * next layer weights) */
 /* Ignore the weights relative to bias */
 void sumWtGs(double ** wgs, double *** weights, double ** gs, \
 int nextLayer, int neuronsNextLayer, int neurons);
 
+/* Number of weights of the MLP */
+long int weightsCount(int * neurons, int nlayers, int ninputs);
+
+/* Index of the weights over a contiguous block of memory 'data'
+ * with weightsCount elements, layer by layer and neuron by neuron.
+ * weights[0][0] is 'data'.
+ */
+double *** weightsMap(double * data, int * neurons, int nlayers, \
+int ninputs);
+
+/* Deallocate the index of the weights, keep the block of memory */
+void weightsUnmap(double *** weights, int nlayers);
+
 /* Memory Allocation of the Weights */
+/* All weights are in one block, see weightsMap */
 double *** weightsAlloc(int * neurons, int nlayers, int ninputs);
 
+/* Deallocate memory of the Weights ('neurons' is not used) */
+void weightsFree(double *** weights, int * neurons, int nlayers);
+
+/* Set all weights to zero */
+void weightsZero(double *** weights, int * neurons, int nlayers, \
+int ninputs);
+
+/* Multiply the weights by a mask with the same shape (0 = pruned) */
+void weightsMask(double *** weights, double *** mask, int * neurons, \
+int nlayers, int ninputs);
+
+/* Mini-batch training kernels.
+ * The update of a batch is accumulated in 'step' (same shape of the
+ * weights) and applied with momentum:
+ *   delta = lrate*step/count + alpha*delta
+ *   weights = weights + delta
+ */
+
+/* Local gradient of the last layer = (ref - y) * df */
+void outputGradient(double * gs, double * ref, double * y, \
+int outs, int activation);
+
+/* Accumulate the update of a layer: step += gs * [bias in] */
+void layerAccumulate(double ** step, double * gs, double bias, \
+double * in, int nin, int neurons);
+
+/* Local gradient of the previous layer: df(yprev) * SUM(gs * weights) */
+/* Ignore the weights relative to bias */
+void layerBackward(double * gsPrev, double ** weights, double * gs, \
+double * yprev, int nprev, int neurons, int activation);
+
+/* Apply an accumulated update of a layer and clear it */
+void layerApply(double ** weights, double ** delta, double ** step, \
+double lrate, double alpha, int count, int nin, int neurons);
+
 /* Training data structure */
+/* The struct must be initialized by trainingInit before the fields are
+ * set, the optional fields (validation, patience, xSparse) keep safe
+ * defaults.
+ */
 typedef struct
 {
 	int nlayers;
@@ -115,8 +254,80 @@ typedef struct
 	double lrate;
 	double acceptedError;
 	long int maxIteration;
+	/* Validation set of the early stopping, validation = 0 disables it.
+	 * The rows are not deallocated by trainingDestruct.
+	 */
+	double ** xValidation;
+	double ** refValidation;
+	int validation;
+	/* Epochs without a better validation MSE before the stop */
+	int patience;
+	/* Sparse inputs, when not NULL the rows of x are not used. The
+	 * training equals the dense training only for alpha = 0 (see
+	 * updateLayer0Sparse)
+	 */
+	mlpCSR * xSparse;
 } training;
 
+/* Metrics of an evaluation, means by example (and output) */
+typedef struct
+{
+	double mse;
+	double crossEntropy;
+	double accuracy;
+	long int examples;
+} mlpMetrics;
+
+/* Evaluation of the examples 0 until 'count'-1 of x/ref
+ * arg = argument of the evaluator
+ * return 0 = success, 1 = error
+ */
+typedef int (*mlpEvaluator)(void * arg, double *** weights, \
+training * trainingData, char * activation, double ** x, double ** ref, \
+int count, mlpMetrics * metrics);
+
+/* Training workspace of trainingMLP, all buffers in one aligned arena */
+typedef struct
+{
+	char * arena;
+	size_t size;
+	size_t used;
+	double *** weightsPast;
+	double *** weightsSwap;
+	double *** weightsBest;
+	double ** yout;
+	double * error;
+	double ** df;
+	double ** gs;
+	double ** wgs;
+	int * xidx;
+	double * mseHist;
+	long int histSize;
+	/* Evaluation of the epochs, NULL uses evalMLP */
+	mlpEvaluator evaluate;
+	void * evaluateArg;
+	/* Mask of the weights applied after each update (0 = the weight
+	 * stays zero), NULL trains all weights. Not deallocated by
+	 * workspaceDestroy.
+	 */
+	double *** mask;
+	/* Seed of the order of the examples (rand_r), NULL uses rand */
+	unsigned int * seed;
+} mlpWorkspace;
+
+/* Propagation and back propagation of one example 'x' with desired
+ * output 'ref', accumulating the update of all layers in 'step'.
+ * yout = outputs by layer
+ * gs, gsPrev = memory with the size of the widest layer
+ * return the squared error of the example divided by the outputs
+ */
+double exampleAccumulate(double *** weights, double *** step, \
+training * trainingData, int activation, double * x, double * ref, \
+double ** yout, double * gs, double * gsPrev);
+
+/* Default values of a training struct, optional features disabled */
+void trainingInit(training * tr);
+
 /* Deallocate memory of a traning struct */
 void trainingDestruct(training * tr);
 
@@ -145,22 +356,107 @@ double *** initMLP(int * neurons, int nlayers, int ninputs);
  * lrate = learning-rate 
  * acceptedError = acceptable error 
  * maxIteration = maximum iteration 
+ * xSparse = CSR inputs (optional), the first layer only visits the
+ *   nonzero columns
+ * xValidation, refValidation, validation, patience = early stopping,
+ *   the training stops after 'patience' epochs without a better
+ *   validation MSE and the weights of the best epoch are kept
  * activation = activation function 
  *   'sigmoid', ...
+ * The MSE of each epoch is computed with the weights of the end of
+ * the epoch.
  * return History of MSE, the position 0 is the size of history
+ *   (deallocate with free), NULL in error
  */
 double * trainingMLP(double *** weights, training * trainingData, \
 char * activation);
 
+/* Bytes of the arena of the workspace of a training configuration */
+size_t workspaceSize(training * trainingData);
+
+/* Create a training workspace for 'trainingData', NULL in error */
+mlpWorkspace * workspaceCreate(training * trainingData);
+
+/* Fit the workspace to 'trainingData', the arena only grows
+ * return 0 = success, 1 = error
+ */
+int workspaceFit(mlpWorkspace * ws, training * trainingData);
+
+/* Deallocate the workspace */
+void workspaceDestroy(mlpWorkspace * ws);
+
+/* Same of trainingMLP over a reusable workspace, the buffers of the
+ * training are not allocated again.
+ * return History of MSE in the workspace, valid until the next use
+ */
+double * trainingMLPWorkspace(double *** weights, training * trainingData, \
+char * activation, mlpWorkspace * ws);
+
 /* Output of MLP */
 /* The 'in' is a matrix of inputs X 'pos' */
 void outMLP(double *** weights, training * trainingData, \
 char * activation, double ** in, int pos, double * out);
 
-/* Save training data and weights of MLP in a file */
-void saveMLP(char * filename, training * trainingData, \
+/* Output of MLP for a batch of inputs */
+/* The 'in' is a matrix of inputs X 'first' until 'first'+'count'-1 */
+/* The 'out' is a matrix 'count' X outputs */
+void outMLPBatch(double *** weights, training * trainingData, \
+char * activation, double ** in, int first, int count, double ** out);
+
+/* Output of MLP for the CSR row 'pos' of 'in' */
+void outMLPSparse(double *** weights, training * trainingData, \
+char * activation, mlpCSR * in, int pos, double * out);
+
+/* Output of MLP for the CSR rows 'first' until 'first'+'count'-1 */
+/* The 'out' is a matrix 'count' X outputs */
+void outMLPBatchSparse(double *** weights, training * trainingData, \
+char * activation, mlpCSR * in, int first, int count, double ** out);
+
+/* Evaluation of the examples 'first' until 'first'+'count'-1 of x/ref
+ * by batches of MLP_BATCH_BLOCK: MSE, cross-entropy (outputs in [0,1])
+ * and accuracy (output above 0.5 with one output, largest output else)
+ * x = NULL uses the CSR rows of trainingData->xSparse
+ * return 0 = success, 1 = error
+ */
+int evalMLP(double *** weights, training * trainingData, \
+char * activation, double ** x, double ** ref, int first, int count, \
+mlpMetrics * metrics);
+
+/* Merge the metrics 'b' in 'a', weighted by the examples */
+void metricsMerge(mlpMetrics * a, mlpMetrics * b);
+
+/* Evaluation by the evaluator of the workspace (evalMLP if NULL) */
+int workspaceEvaluate(mlpWorkspace * ws, double *** weights, \
+training * trainingData, char * activation, double ** x, double ** ref, \
+int count, mlpMetrics * metrics);
+
+/* Write the configuration lines (0 until 7 of the configuration file
+ * of loadExamplesFromFile) of a model file
+ */
+void saveMLPConf(FILE * f, training * trainingData);
+
+/* Read the configuration lines of a model file, 'neurons' and 'bias'
+ * are allocated
+ * return 0 on success, 1 in error
+ */
+int loadMLPConf(FILE * f, training * trainingData);
+
+/* Save training data and weights of MLP in a file
+ * The format is the 'MLP_FILE_MAGIC' line, the lines 0 until 7 of the
+ * configuration file of loadExamplesFromFile and the weights, one
+ * line by neuron, layer by layer.
+ * return 0 on success, 1 in error
+ */
+int saveMLP(char * filename, training * trainingData, \
 double *** weights);
 
+/* Load the configuration and weights of MLP from a file of saveMLP
+ * The training parameters are loaded in 'trainingData', without
+ * examples ('x' and 'reference' are NULL).
+ * return weights, NULL in error
+ */
+double *** loadMLP(char * filename, training * trainingData);
+
 /* Load the examples, references and configuration from files.
  * 
  * The format for the inputs file is a matrix examples X inputs, 
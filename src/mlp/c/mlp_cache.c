@@ -0,0 +1,399 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mlp_cache.h"
+
+/* Hash of an input row, multiply and xor-shift by double */
+uint64_t cacheHash(double * in, int n)
+{
+	int i;
+	uint64_t x;
+	uint64_t h = 0x9e3779b97f4a7c15ULL ^ (uint64_t) n;
+
+	for(i=0; i<n; i++)
+	{
+		memcpy(&x,&in[i],sizeof(x));
+		h ^= x;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 32;
+	}
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 29;
+
+	return h;
+}
+
+/* Shard of a hash, high bits (the low bits select the bucket) */
+static cacheShard * cacheShardOf(mlpCache * cache, uint64_t h)
+{
+	return &cache->shards[(h >> 40) % cache->nshards];
+}
+
+/* Empty shard */
+static void shardClear(cacheShard * s)
+{
+	int i;
+	for(i=0; i<=s->mask; i++)
+		s->buckets[i] = -1;
+	s->used = 0;
+	s->head = -1;
+	s->tail = -1;
+	s->generation += 1;
+}
+
+/* Move the entry 'e' to the front of the LRU list */
+static void shardTouch(cacheShard * s, int e)
+{
+	if(s->head == e)
+		return;
+
+	/* Unlink */
+	if(s->prev[e] >= 0)
+		s->next[s->prev[e]] = s->next[e];
+	if(s->next[e] >= 0)
+		s->prev[s->next[e]] = s->prev[e];
+	if(s->tail == e)
+		s->tail = s->prev[e];
+
+	/* Front */
+	s->prev[e] = -1;
+	s->next[e] = s->head;
+	if(s->head >= 0)
+		s->prev[s->head] = e;
+	s->head = e;
+	if(s->tail < 0)
+		s->tail = e;
+}
+
+/* Entry of the row 'in' with hash 'h', -1 if absent */
+static int shardFind(cacheShard * s, uint64_t h, double * in, int n)
+{
+	int e = s->buckets[h & s->mask];
+	while(e >= 0)
+	{
+		if(s->hash[e] == h && \
+		memcmp(s->keys + (long int) e*n,in,sizeof(double)*n) == 0)
+			return e;
+		e = s->chain[e];
+	}
+	return -1;
+}
+
+/* Remove the entry 'e' of its chain */
+static void shardUnchain(cacheShard * s, int e)
+{
+	int * link = &s->buckets[s->hash[e] & s->mask];
+	while(*link != e)
+		link = &s->chain[*link];
+	*link = s->chain[e];
+}
+
+/* Save a row, the least recently used is replaced if full */
+static void shardInsert(cacheShard * s, uint64_t h, double * in, int n, \
+double * out, int outs)
+{
+	int e;
+	if(shardFind(s,h,in,n) >= 0)
+		return;
+
+	if(s->used < s->capacity)
+	{
+		e = s->used++;
+		s->prev[e] = -1;
+		s->next[e] = -1;
+	}
+	else
+	{
+		e = s->tail;
+		shardUnchain(s,e);
+	}
+
+	s->hash[e] = h;
+	memcpy(s->keys + (long int) e*n,in,sizeof(double)*n);
+	memcpy(s->values + (long int) e*outs,out,sizeof(double)*outs);
+	s->chain[e] = s->buckets[h & s->mask];
+	s->buckets[h & s->mask] = e;
+	shardTouch(s,e);
+}
+
+/* Look up a row, copy the outputs in 'out' if present
+ * return 1 = hit, 0 = miss, '*generation' of the shard
+ */
+static int shardLookup(cacheShard * s, uint64_t h, double * in, int n, \
+double * out, int outs, long int * generation)
+{
+	int e;
+	pthread_mutex_lock(&s->lock);
+	e = shardFind(s,h,in,n);
+	if(e >= 0)
+	{
+		memcpy(out,s->values + (long int) e*outs,sizeof(double)*outs);
+		shardTouch(s,e);
+		s->hits += 1;
+	}
+	else
+	{
+		s->misses += 1;
+	}
+	*generation = s->generation;
+	pthread_mutex_unlock(&s->lock);
+
+	return e >= 0;
+}
+
+/* Save a computed row if the shard was not invalidated meanwhile */
+static void shardSave(cacheShard * s, uint64_t h, double * in, int n, \
+double * out, int outs, long int generation)
+{
+	pthread_mutex_lock(&s->lock);
+	if(s->generation == generation)
+		shardInsert(s,h,in,n,out,outs);
+	pthread_mutex_unlock(&s->lock);
+}
+
+/* Create a cache */
+mlpCache * cacheCreate(double *** weights, training * trainingData, \
+char * activation, int capacity, int shards)
+{
+	int i;
+	int size;
+	int ok = 1;
+	cacheShard * s;
+	mlpCache * cache = (mlpCache*) calloc(1,sizeof(mlpCache));
+	if(cache == NULL)
+		return NULL;
+
+	if(shards <= 0)
+		shards = MLP_CACHE_SHARDS;
+	if(shards > capacity)
+		shards = capacity > 0 ? capacity : 1;
+	cache->weights = weights;
+	cache->trainingData = trainingData;
+	cache->activation = activation;
+	cache->ninputs = trainingData->ninputs;
+	cache->outs = trainingData->neurons[trainingData->nlayers-1];
+	cache->nshards = shards;
+	cache->shards = (cacheShard*) calloc(shards,sizeof(cacheShard));
+	if(cache->shards == NULL)
+	{
+		free(cache);
+		return NULL;
+	}
+
+	for(i=0; i<shards; i++)
+	{
+		s = &cache->shards[i];
+		s->capacity = capacity/shards + (i < capacity % shards);
+		if(s->capacity < 1)
+			s->capacity = 1;
+
+		/* Buckets, power of 2 >= 2*capacity */
+		size = 2;
+		while(size < 2*s->capacity)
+			size *= 2;
+		s->mask = size-1;
+		s->buckets = (int*) malloc(sizeof(int)*size);
+		s->chain = (int*) malloc(sizeof(int)*s->capacity);
+		s->prev = (int*) malloc(sizeof(int)*s->capacity);
+		s->next = (int*) malloc(sizeof(int)*s->capacity);
+		s->hash = (uint64_t*) malloc(sizeof(uint64_t)*s->capacity);
+		s->keys = (double*) \
+		malloc(sizeof(double)*s->capacity*cache->ninputs);
+		s->values = (double*) \
+		malloc(sizeof(double)*s->capacity*cache->outs);
+		pthread_mutex_init(&s->lock,NULL);
+		if(s->buckets == NULL || s->chain == NULL || s->prev == NULL || \
+		s->next == NULL || s->hash == NULL || s->keys == NULL || \
+		s->values == NULL)
+			ok = 0;
+		else
+			shardClear(s);
+	}
+
+	if(!ok)
+	{
+		cacheDestroy(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+/* Output of in[pos] */
+int cacheOut(mlpCache * cache, double ** in, int pos, double * out)
+{
+	long int generation;
+	uint64_t h = cacheHash(in[pos],cache->ninputs);
+	cacheShard * s = cacheShardOf(cache,h);
+
+	if(shardLookup(s,h,in[pos],cache->ninputs,out,cache->outs,&generation))
+		return 0;
+
+	if(cache->codebook != NULL)
+	{
+		if(codebookOutBatch(cache->codebook,cache->activation,in,pos,1,&out))
+			return 1;
+	}
+	else
+	{
+		outMLP(cache->weights,cache->trainingData,cache->activation, \
+		in,pos,out);
+	}
+	shardSave(s,h,in[pos],cache->ninputs,out,cache->outs,generation);
+
+	return 0;
+}
+
+/* Output of a batch */
+int cacheOutBatch(mlpCache * cache, double ** in, int first, int count, \
+double ** out)
+{
+	int e;
+	int m = 0;
+	int error = 0;
+	uint64_t * h = (uint64_t*) malloc(sizeof(uint64_t)*count);
+	long int * generation = (long int*) malloc(sizeof(long int)*count);
+	int * miss = (int*) malloc(sizeof(int)*count);
+	double ** rows = (double**) malloc(sizeof(double*)*count);
+	double ** outs = (double**) malloc(sizeof(double*)*count);
+	if(h == NULL || generation == NULL || miss == NULL || rows == NULL || \
+	outs == NULL)
+	{
+		free(h);
+		free(generation);
+		free(miss);
+		free(rows);
+		free(outs);
+		for(e=0; e<count; e++)
+			error |= cacheOut(cache,in,first+e,out[e]);
+		return error;
+	}
+
+	for(e=0; e<count; e++)
+	{
+		h[e] = cacheHash(in[first+e],cache->ninputs);
+		if(!shardLookup(cacheShardOf(cache,h[e]),h[e],in[first+e], \
+		cache->ninputs,out[e],cache->outs,&generation[e]))
+		{
+			miss[m] = e;
+			rows[m] = in[first+e];
+			outs[m] = out[e];
+			m++;
+		}
+	}
+
+	/* Forward pass only for the misses */
+	if(m > 0 && cache->codebook != NULL)
+	{
+		error = codebookOutBatch(cache->codebook,cache->activation, \
+		rows,0,m,outs);
+	}
+	else if(m > 0)
+	{
+		outMLPBatch(cache->weights,cache->trainingData, \
+		cache->activation,rows,0,m,outs);
+	}
+	for(e=0; e<m && !error; e++)
+	{
+		shardSave(cacheShardOf(cache,h[miss[e]]),h[miss[e]],rows[e], \
+		cache->ninputs,outs[e],cache->outs,generation[miss[e]]);
+	}
+
+	free(h);
+	free(generation);
+	free(miss);
+	free(rows);
+	free(outs);
+
+	return error;
+}
+
+/* Discard all rows */
+void cacheInvalidate(mlpCache * cache)
+{
+	int i;
+	for(i=0; i<cache->nshards; i++)
+	{
+		pthread_mutex_lock(&cache->shards[i].lock);
+		shardClear(&cache->shards[i]);
+		pthread_mutex_unlock(&cache->shards[i].lock);
+	}
+}
+
+/* New weights and invalidate */
+void cacheWeights(mlpCache * cache, double *** weights)
+{
+	cache->weights = weights;
+	cacheInvalidate(cache);
+}
+
+/* Compressed model and invalidate */
+void cacheCodebook(mlpCache * cache, mlpCodebook * codebook)
+{
+	cache->codebook = codebook;
+	cacheInvalidate(cache);
+}
+
+/* Hits and misses of all shards */
+void cacheStats(mlpCache * cache, long int * hits, long int * misses)
+{
+	int i;
+	*hits = 0;
+	*misses = 0;
+	for(i=0; i<cache->nshards; i++)
+	{
+		pthread_mutex_lock(&cache->shards[i].lock);
+		*hits += cache->shards[i].hits;
+		*misses += cache->shards[i].misses;
+		pthread_mutex_unlock(&cache->shards[i].lock);
+	}
+}
+
+/* Deallocate the cache */
+void cacheDestroy(mlpCache * cache)
+{
+	int i;
+	cacheShard * s;
+	if(cache == NULL)
+		return;
+
+	for(i=0; i<cache->nshards; i++)
+	{
+		s = &cache->shards[i];
+		pthread_mutex_destroy(&s->lock);
+		free(s->buckets);
+		free(s->chain);
+		free(s->prev);
+		free(s->next);
+		free(s->hash);
+		free(s->keys);
+		free(s->values);
+	}
+	free(cache->shards);
+	free(cache);
+}
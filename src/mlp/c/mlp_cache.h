@@ -0,0 +1,118 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MLP_CACHE_H
+#define _MLP_CACHE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "mlp.h"
+#include "mlp_codebook.h"
+
+/* Default number of shards of a cache */
+#ifndef MLP_CACHE_SHARDS
+	#define MLP_CACHE_SHARDS 16
+#endif
+
+/* Shard of the cache: hash table with chains and LRU list of entries,
+ * all links are indexes of the entries (-1 = none)
+ */
+typedef struct
+{
+	pthread_mutex_t lock;
+	int capacity;
+	int used;
+	int mask;
+	int * buckets;
+	int * chain;
+	int * prev;
+	int * next;
+	int head;
+	int tail;
+	uint64_t * hash;
+	double * keys;
+	double * values;
+	long int generation;
+	long int hits;
+	long int misses;
+} cacheShard;
+
+/* Bounded, sharded LRU cache of the outputs of an MLP by input row */
+typedef struct
+{
+	double *** weights;
+	/* Compressed model used instead of the weights (NULL = weights) */
+	mlpCodebook * codebook;
+	training * trainingData;
+	char * activation;
+	int ninputs;
+	int outs;
+	int nshards;
+	cacheShard * shards;
+} mlpCache;
+
+/* Hash of an input row */
+uint64_t cacheHash(double * in, int n);
+
+/* Create a cache of up to 'capacity' rows in front of the MLP
+ * shards = number of shards (locks), MLP_CACHE_SHARDS if <= 0
+ * return NULL in error
+ */
+mlpCache * cacheCreate(double *** weights, training * trainingData, \
+char * activation, int capacity, int shards);
+
+/* Output of in[pos], from the cache or computed by outMLP and saved
+ * return 0 = success, 1 = error
+ */
+int cacheOut(mlpCache * cache, double ** in, int pos, double * out);
+
+/* Output of in[first] until in[first+count-1], the misses are computed
+ * together by outMLPBatch (codebookOutBatch with a codebook)
+ * The 'out' is a matrix 'count' X outputs
+ * return 0 = success, 1 = error
+ */
+int cacheOutBatch(mlpCache * cache, double ** in, int first, int count, \
+double ** out);
+
+/* Discard all rows, the outputs computed before are not saved */
+void cacheInvalidate(mlpCache * cache);
+
+/* New weights (e.g. after online training) and invalidate */
+void cacheWeights(mlpCache * cache, double *** weights);
+
+/* Compute the misses with a compressed model (NULL = the weights) and
+ * invalidate
+ */
+void cacheCodebook(mlpCache * cache, mlpCodebook * codebook);
+
+/* Hits and misses of all shards */
+void cacheStats(mlpCache * cache, long int * hits, long int * misses);
+
+/* Deallocate the cache (not the weights) */
+void cacheDestroy(mlpCache * cache);
+
+#endif /* _MLP_CACHE_H */
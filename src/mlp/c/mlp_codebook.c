@@ -0,0 +1,542 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mlp_codebook.h"
+
+/* Order of doubles for qsort */
+static int doubleCompare(const void * a, const void * b)
+{
+	double x = *(const double*) a;
+	double y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+/* Index of the centroid nearest to v, 'c' sorted */
+static int codebookNearest(double * c, int k, double v)
+{
+	int lo = 0;
+	int hi = k-1;
+	int mid;
+
+	while(hi - lo > 1)
+	{
+		mid = (lo + hi)/2;
+		if(c[mid] <= v)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return fabs(v - c[lo]) <= fabs(c[hi] - v) ? lo : hi;
+}
+
+/* Index 't' of a row of indexes */
+static int codebookGet(uint8_t * row, int bits, int t)
+{
+	if(bits == 4)
+		return (row[t >> 1] >> ((t & 1) << 2)) & 15;
+	return row[t];
+}
+
+/* Set the index 't' of a row of indexes */
+static void codebookSet(uint8_t * row, int bits, int t, int v)
+{
+	if(bits == 4)
+	{
+		row[t >> 1] &= (t & 1) ? 0x0f : 0xf0;
+		row[t >> 1] |= v << ((t & 1) << 2);
+	}
+	else
+	{
+		row[t] = v;
+	}
+}
+
+/* 1D k-means, centroids 'c' sorted, linear initialization
+ * return 0 = success, 1 = memory error
+ */
+static int codebookKmeans(double * values, long int n, double * c, int k)
+{
+	int i;
+	int j;
+	long int e;
+	double min = values[0];
+	double max = values[0];
+	double * sums = (double*) calloc(k,sizeof(double));
+	long int * counts = (long int*) calloc(k,sizeof(long int));
+	if(sums == NULL || counts == NULL)
+	{
+		free(sums);
+		free(counts);
+		return 1;
+	}
+
+	for(e=1; e<n; e++)
+	{
+		if(values[e] < min)
+			min = values[e];
+		if(values[e] > max)
+			max = values[e];
+	}
+	for(j=0; j<k; j++)
+		c[j] = min + (max - min)*j/(k-1);
+
+	for(i=0; i<MLP_CODEBOOK_ITERATIONS; i++)
+	{
+		memset(sums,0,sizeof(double)*k);
+		memset(counts,0,sizeof(long int)*k);
+		for(e=0; e<n; e++)
+		{
+			j = codebookNearest(c,k,values[e]);
+			sums[j] += values[e];
+			counts[j]++;
+		}
+
+		/* Empty clusters keep their centroids */
+		for(j=0; j<k; j++)
+		{
+			if(counts[j])
+				c[j] = sums[j]/counts[j];
+		}
+		qsort(c,k,sizeof(double),doubleCompare);
+	}
+
+	free(sums);
+	free(counts);
+	return 0;
+}
+
+/* Net without layers */
+static mlpCodebook * codebookAlloc(training * trainingData)
+{
+	int nlayers = trainingData->nlayers;
+	mlpCodebook * net = (mlpCodebook*) calloc(1,sizeof(mlpCodebook));
+	if(net == NULL)
+		return NULL;
+
+	net->nlayers = nlayers;
+	net->ninputs = trainingData->ninputs;
+	net->neurons = trainingData->neurons;
+	net->bias = trainingData->bias;
+	net->k = (int*) calloc(nlayers,sizeof(int));
+	net->bits = (int*) calloc(nlayers,sizeof(int));
+	net->stride = (long int*) calloc(nlayers,sizeof(long int));
+	net->centroids = (double**) calloc(nlayers,sizeof(double*));
+	net->index = (uint8_t**) calloc(nlayers,sizeof(uint8_t*));
+	if(net->k == NULL || net->bits == NULL || net->stride == NULL || \
+	net->centroids == NULL || net->index == NULL)
+	{
+		codebookDestroy(net);
+		return NULL;
+	}
+
+	return net;
+}
+
+/* Memory of a layer with 'k' centroids */
+static int codebookLayerAlloc(mlpCodebook * net, int layer, int k)
+{
+	int nin = layer ? net->neurons[layer-1] : net->ninputs;
+
+	net->k[layer] = k;
+	net->bits[layer] = k <= 16 ? 4 : 8;
+	net->stride[layer] = net->bits[layer] == 4 ? (nin+2)/2 : nin+1;
+	net->centroids[layer] = (double*) malloc(sizeof(double)*k);
+	net->index[layer] = (uint8_t*) \
+	calloc(net->stride[layer]*net->neurons[layer],sizeof(uint8_t));
+	if(net->centroids[layer] == NULL || net->index[layer] == NULL)
+		return 1;
+
+	return 0;
+}
+
+/* Codebook of the weights */
+mlpCodebook * codebookCreate(double *** weights, training * trainingData, \
+int k)
+{
+	int layer;
+	int neuron;
+	int nin;
+	int w;
+	long int n;
+	double * values;
+	uint8_t * row;
+	mlpCodebook * net;
+
+	if(k < 2 || k > 256)
+		return NULL;
+
+	net = codebookAlloc(trainingData);
+	if(net == NULL)
+		return NULL;
+
+	for(layer=0; layer<net->nlayers; layer++)
+	{
+		nin = layer ? net->neurons[layer-1] : net->ninputs;
+		n = (long int) net->neurons[layer]*(nin+1);
+		if(codebookLayerAlloc(net,layer,k))
+		{
+			codebookDestroy(net);
+			return NULL;
+		}
+
+		/* Weights of the layer, bias weights included */
+		values = (double*) malloc(sizeof(double)*n);
+		if(values == NULL)
+		{
+			codebookDestroy(net);
+			return NULL;
+		}
+		for(neuron=0; neuron<net->neurons[layer]; neuron++)
+		{
+			memcpy(values + (long int) neuron*(nin+1), \
+			weights[layer][neuron],sizeof(double)*(nin+1));
+		}
+		if(codebookKmeans(values,n,net->centroids[layer],k))
+		{
+			free(values);
+			codebookDestroy(net);
+			return NULL;
+		}
+		free(values);
+
+		for(neuron=0; neuron<net->neurons[layer]; neuron++)
+		{
+			row = net->index[layer] + net->stride[layer]*neuron;
+			for(w=0; w<=nin; w++)
+			{
+				codebookSet(row,net->bits[layer],w, \
+				codebookNearest(net->centroids[layer],k, \
+				weights[layer][neuron][w]));
+			}
+		}
+	}
+
+	return net;
+}
+
+/* Bytes of the centroids and indexes */
+long int codebookBytes(mlpCodebook * net)
+{
+	int layer;
+	long int bytes = 0;
+	for(layer=0; layer<net->nlayers; layer++)
+	{
+		bytes += sizeof(double)*net->k[layer] + \
+		net->stride[layer]*net->neurons[layer];
+	}
+	return bytes;
+}
+
+/* Weights decoded from the codebook */
+double *** codebookDecode(mlpCodebook * net)
+{
+	int layer;
+	int neuron;
+	int nin;
+	int w;
+	uint8_t * row;
+	double *** weights = weightsAlloc(net->neurons,net->nlayers, \
+	net->ninputs);
+	if(weights == NULL)
+		return NULL;
+
+	for(layer=0; layer<net->nlayers; layer++)
+	{
+		nin = layer ? net->neurons[layer-1] : net->ninputs;
+		for(neuron=0; neuron<net->neurons[layer]; neuron++)
+		{
+			row = net->index[layer] + net->stride[layer]*neuron;
+			for(w=0; w<=nin; w++)
+			{
+				weights[layer][neuron][w] = net->centroids[layer] \
+				[codebookGet(row,net->bits[layer],w)];
+			}
+		}
+	}
+
+	return weights;
+}
+
+/* Out of a layer for 'count' input vectors
+ * dest = count X neurons, in = count X nin
+ */
+static void codebookLayerOut(mlpCodebook * net, int layer, double * dest, \
+double * in, int count, int activation)
+{
+	int nin = layer ? net->neurons[layer-1] : net->ninputs;
+	int neurons = net->neurons[layer];
+	int bits = net->bits[layer];
+	double bias = net->bias[layer];
+	double * lut = net->centroids[layer];
+	int e;
+	int i;
+	int j;
+	double s0;
+	double s1;
+	double s2;
+	double s3;
+	double wj;
+	uint8_t * row;
+	double * x0;
+	double * x1;
+	double * x2;
+	double * x3;
+
+	/* Four examples by pass over the indexes of a neuron */
+	for(e=0; e+4<=count; e+=4)
+	{
+		x0 = in + e*nin;
+		x1 = x0 + nin;
+		x2 = x1 + nin;
+		x3 = x2 + nin;
+		for(i=0; i<neurons; i++)
+		{
+			row = net->index[layer] + net->stride[layer]*i;
+			s0 = bias * lut[codebookGet(row,bits,0)];
+			s1 = s0;
+			s2 = s0;
+			s3 = s0;
+			for(j=0; j<nin; j++)
+			{
+				wj = lut[codebookGet(row,bits,j+1)];
+				s0 += x0[j] * wj;
+				s1 += x1[j] * wj;
+				s2 += x2[j] * wj;
+				s3 += x3[j] * wj;
+			}
+			dest[e*neurons + i] = activationOut(s0,activation);
+			dest[(e+1)*neurons + i] = activationOut(s1,activation);
+			dest[(e+2)*neurons + i] = activationOut(s2,activation);
+			dest[(e+3)*neurons + i] = activationOut(s3,activation);
+		}
+	}
+
+	for(; e<count; e++)
+	{
+		x0 = in + e*nin;
+		for(i=0; i<neurons; i++)
+		{
+			row = net->index[layer] + net->stride[layer]*i;
+			s0 = bias * lut[codebookGet(row,bits,0)];
+			for(j=0; j<nin; j++)
+				s0 += x0[j] * lut[codebookGet(row,bits,j+1)];
+			dest[e*neurons + i] = activationOut(s0,activation);
+		}
+	}
+}
+
+/* Output of the net for a batch */
+int codebookOutBatch(mlpCodebook * net, char * activation, double ** in, \
+int first, int count, double ** out)
+{
+	int nlayers = net->nlayers;
+	int * neurons = net->neurons;
+	int ninputs = net->ninputs;
+	int layer;
+	int e;
+	int n;
+	int block;
+	int width = ninputs;
+	int actv = getActv(activation);
+	double * a;
+	double * b;
+	double * tmp;
+
+	for(layer=0; layer<nlayers; layer++)
+	{
+		if(neurons[layer] > width)
+			width = neurons[layer];
+	}
+
+	/* Memory for the outputs of a block of examples */
+	a = (double*) malloc(sizeof(double)*MLP_BATCH_BLOCK*width);
+	b = (double*) malloc(sizeof(double)*MLP_BATCH_BLOCK*width);
+	if(a == NULL || b == NULL)
+	{
+		free(a);
+		free(b);
+		return 1;
+	}
+
+	for(block=0; block<count; block+=MLP_BATCH_BLOCK)
+	{
+		n = count - block;
+		if(n > MLP_BATCH_BLOCK)
+			n = MLP_BATCH_BLOCK;
+
+		for(e=0; e<n; e++)
+		{
+			memcpy(a + e*ninputs,in[first+block+e], \
+			sizeof(double)*ninputs);
+		}
+
+		/* Propagation */
+		for(layer=0; layer<nlayers; layer++)
+		{
+			codebookLayerOut(net,layer,b,a,n,actv);
+			tmp = a;
+			a = b;
+			b = tmp;
+		}
+
+		/* Copy output of last layer to out */
+		for(e=0; e<n; e++)
+		{
+			memcpy(out[block+e],a + e*neurons[nlayers-1], \
+			sizeof(double)*neurons[nlayers-1]);
+		}
+	}
+
+	free(a);
+	free(b);
+	return 0;
+}
+
+/* Save the compressed MLP */
+int codebookSave(char * filename, training * trainingData, \
+mlpCodebook * net)
+{
+	int layer;
+	int neuron;
+	int j;
+	long int b;
+	uint8_t * row;
+	FILE * f = fopen(filename,"w");
+	if(f == NULL)
+		return 1;
+
+	fprintf(f,"%s\n",MLP_CODEBOOK_MAGIC);
+	saveMLPConf(f,trainingData);
+	for(layer=0; layer<net->nlayers; layer++)
+	{
+		fprintf(f,"%d %d\n",net->k[layer],net->bits[layer]);
+		for(j=0; j<net->k[layer]; j++)
+			fprintf(f,j ? " %.17g" : "%.17g",net->centroids[layer][j]);
+		fprintf(f,"\n");
+		for(neuron=0; neuron<net->neurons[layer]; neuron++)
+		{
+			row = net->index[layer] + net->stride[layer]*neuron;
+			for(b=0; b<net->stride[layer]; b++)
+				fprintf(f,"%02x",row[b]);
+			fprintf(f,"\n");
+		}
+	}
+
+	if(fclose(f) != 0)
+		return 1;
+
+	return 0;
+}
+
+/* Load a compressed MLP */
+mlpCodebook * codebookLoad(char * filename, training * trainingData)
+{
+	char magic[32];
+	int layer;
+	int neuron;
+	int nin;
+	int k;
+	int bits;
+	int j;
+	int ok;
+	unsigned int byte;
+	long int b;
+	uint8_t * row;
+	mlpCodebook * net = NULL;
+	FILE * f = fopen(filename,"r");
+	if(f == NULL)
+		return NULL;
+
+	memset(trainingData,0,sizeof(training));
+	ok = fscanf(f,"%31s",magic) == 1 && \
+	strcmp(magic,MLP_CODEBOOK_MAGIC) == 0 && \
+	loadMLPConf(f,trainingData) == 0;
+	if(ok)
+	{
+		net = codebookAlloc(trainingData);
+		ok = net != NULL;
+	}
+
+	for(layer=0; ok && layer<trainingData->nlayers; layer++)
+	{
+		nin = layer ? trainingData->neurons[layer-1] : \
+		trainingData->ninputs;
+		ok = fscanf(f,"%d %d",&k,&bits) == 2 && k >= 2 && k <= 256 && \
+		bits == (k <= 16 ? 4 : 8) && codebookLayerAlloc(net,layer,k) == 0;
+		for(j=0; ok && j<k; j++)
+			ok = fscanf(f,"%lf",&net->centroids[layer][j]) == 1;
+		for(neuron=0; ok && neuron<trainingData->neurons[layer]; neuron++)
+		{
+			row = net->index[layer] + net->stride[layer]*neuron;
+			for(b=0; ok && b<net->stride[layer]; b++)
+			{
+				ok = fscanf(f,"%2x",&byte) == 1;
+				row[b] = byte;
+			}
+
+			/* Indexes inside the codebook */
+			for(j=0; ok && j<=nin; j++)
+				ok = codebookGet(row,bits,j) < k;
+		}
+	}
+	fclose(f);
+
+	if(!ok)
+	{
+		codebookDestroy(net);
+		free(trainingData->neurons);
+		free(trainingData->bias);
+		trainingData->neurons = NULL;
+		trainingData->bias = NULL;
+		return NULL;
+	}
+
+	return net;
+}
+
+/* Deallocate the net */
+void codebookDestroy(mlpCodebook * net)
+{
+	int layer;
+	if(net == NULL)
+		return;
+
+	for(layer=0; layer<net->nlayers; layer++)
+	{
+		if(net->centroids != NULL)
+			free(net->centroids[layer]);
+		if(net->index != NULL)
+			free(net->index[layer]);
+	}
+	free(net->k);
+	free(net->bits);
+	free(net->stride);
+	free(net->centroids);
+	free(net->index);
+	free(net);
+}
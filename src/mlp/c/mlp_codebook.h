@@ -0,0 +1,102 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MLP_CODEBOOK_H
+#define _MLP_CODEBOOK_H
+
+#include <stdint.h>
+#include "mlp.h"
+
+/* First line of the files of codebookSave */
+#define MLP_CODEBOOK_MAGIC "MLPC1"
+
+/* Iterations of k-means by layer */
+#ifndef MLP_CODEBOOK_ITERATIONS
+	#define MLP_CODEBOOK_ITERATIONS 30
+#endif
+
+/* MLP with the weights of each layer clustered in a codebook.
+ * The weight w of the neuron n of a layer is
+ * centroids[layer][ index of (n,w) ], the indexes have 4 bits (up to
+ * 16 centroids, two by byte, low nibble first) or 8 bits, 'stride'
+ * bytes by neuron, bias weight first.
+ */
+typedef struct
+{
+	int nlayers;
+	int ninputs;
+	int * neurons;
+	double * bias;
+	int * k;
+	int * bits;
+	long int * stride;
+	double ** centroids;
+	uint8_t ** index;
+} mlpCodebook;
+
+/* Codebook of the weights, k-means of each layer with 'k' centroids
+ * (2 until 256, 16 or less uses 4 bits indexes)
+ * The struct keeps pointers to neurons and bias of 'trainingData'.
+ * return NULL in error
+ */
+mlpCodebook * codebookCreate(double *** weights, training * trainingData, \
+int k);
+
+/* Bytes of the centroids and indexes */
+long int codebookBytes(mlpCodebook * net);
+
+/* Weights decoded from the codebook (weightsAlloc), NULL in error */
+double *** codebookDecode(mlpCodebook * net);
+
+/* Output of the net for in[first] until in[first+count-1], 4 examples
+ * by pass over the indexes of each neuron, the weights are looked up
+ * in the centroids of the layer
+ * The 'out' is a matrix 'count' X outputs
+ * return 0 = success, 1 = error
+ */
+int codebookOutBatch(mlpCodebook * net, char * activation, double ** in, \
+int first, int count, double ** out);
+
+/* Save the compressed MLP in a file
+ * The format is the 'MLP_CODEBOOK_MAGIC' line, the configuration lines
+ * of saveMLP and by layer: a line 'k bits', a line with the centroids
+ * and the indexes in hexadecimal, one line by neuron.
+ * return 0 on success, 1 in error
+ */
+int codebookSave(char * filename, training * trainingData, \
+mlpCodebook * net);
+
+/* Load a compressed MLP of codebookSave, the configuration is loaded in
+ * 'trainingData' like loadMLP (deallocate neurons and bias)
+ * return NULL in error
+ */
+mlpCodebook * codebookLoad(char * filename, training * trainingData);
+
+/* Deallocate the net (not neurons and bias) */
+void codebookDestroy(mlpCodebook * net);
+
+#endif /* _MLP_CODEBOOK_H */
@@ -0,0 +1,679 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mlp_dist.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdatomic.h>
+
+/* Header of the shared memory */
+typedef struct
+{
+	atomic_int ready;
+	pthread_barrier_t barrier;
+} shmHeader;
+
+/* Offset of the slots in the shared memory */
+#define SHM_DATA ((sizeof(shmHeader)+63)/64*64)
+
+/* Slot of a rank in the shared memory, slot 'size' is the result */
+static double * shmSlot(mlpComm * comm, int rank)
+{
+	return (double*) ((char*) comm->shm + SHM_DATA) + \
+	rank*comm->capacity;
+}
+
+/* Sleep some milliseconds while waiting the other processes */
+static void waitPeer(void)
+{
+	usleep(10000);
+}
+
+/* Address of a rank in TCP, "host:port" or a list of them */
+static int tcpAddress(char * address, int rank, char * host, \
+char * port)
+{
+	int i;
+	char * c = address;
+	char * sep;
+	int len;
+	int base;
+
+	if(strchr(address,',') != NULL)
+	{
+		for(i=0; i<rank && c != NULL; i++)
+		{
+			c = strchr(c,',');
+			if(c != NULL)
+				c++;
+		}
+		if(c == NULL)
+			return 1;
+	}
+
+	sep = strchr(c,':');
+	if(sep == NULL || sep-c >= 255)
+		return 1;
+	len = (int) (sep-c);
+	memcpy(host,c,len);
+	host[len] = '\0';
+	base = atoi(sep+1);
+	if(strchr(address,',') == NULL)
+		base += rank;
+	sprintf(port,"%d",base);
+
+	return 0;
+}
+
+/* Listen socket of the rank */
+static int ringListen(mlpComm * comm, char * address)
+{
+	int fd;
+	int on = 1;
+	char host[256];
+	char port[16];
+
+	if(comm->transport == MLP_DIST_UNIX)
+	{
+		struct sockaddr_un sa;
+		memset(&sa,0,sizeof(sa));
+		sa.sun_family = AF_UNIX;
+		if(strlen(address) + 12 >= sizeof(sa.sun_path))
+			return -1;
+		sprintf(sa.sun_path,"%s.%d",address,comm->rank);
+		unlink(sa.sun_path);
+		fd = socket(AF_UNIX,SOCK_STREAM,0);
+		if(fd < 0)
+			return -1;
+		if(bind(fd,(struct sockaddr*) &sa,sizeof(sa)) || listen(fd,4))
+		{
+			close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	struct sockaddr_in sa;
+	if(tcpAddress(address,comm->rank,host,port))
+		return -1;
+	memset(&sa,0,sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_ANY);
+	sa.sin_port = htons((unsigned short) atoi(port));
+	fd = socket(AF_INET,SOCK_STREAM,0);
+	if(fd < 0)
+		return -1;
+	setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+	if(bind(fd,(struct sockaddr*) &sa,sizeof(sa)) || listen(fd,4))
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* Connect to the next rank, retry until it listens */
+static int ringConnect(mlpComm * comm, char * address)
+{
+	int next = (comm->rank+1) % comm->size;
+	int fd = -1;
+	int on = 1;
+	int tries;
+	char host[256];
+	char port[16];
+	struct addrinfo hints;
+	struct addrinfo * ai = NULL;
+
+	if(comm->transport == MLP_DIST_TCP)
+	{
+		if(tcpAddress(address,next,host,port))
+			return -1;
+		memset(&hints,0,sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		if(getaddrinfo(host,port,&hints,&ai) != 0)
+			return -1;
+	}
+
+	for(tries=0; tries<MLP_DIST_TIMEOUT*100; tries++)
+	{
+		if(comm->transport == MLP_DIST_UNIX)
+		{
+			struct sockaddr_un sa;
+			memset(&sa,0,sizeof(sa));
+			sa.sun_family = AF_UNIX;
+			sprintf(sa.sun_path,"%s.%d",address,next);
+			fd = socket(AF_UNIX,SOCK_STREAM,0);
+			if(fd >= 0 && connect(fd,(struct sockaddr*) &sa,sizeof(sa)) == 0)
+				break;
+		}
+		else
+		{
+			fd = socket(AF_INET,SOCK_STREAM,0);
+			if(fd >= 0 && connect(fd,ai->ai_addr,ai->ai_addrlen) == 0)
+			{
+				setsockopt(fd,IPPROTO_TCP,TCP_NODELAY,&on,sizeof(on));
+				break;
+			}
+		}
+		if(fd >= 0)
+			close(fd);
+		fd = -1;
+		waitPeer();
+	}
+
+	if(ai != NULL)
+		freeaddrinfo(ai);
+
+	return fd;
+}
+
+/* Send to the next rank and receive from the previous at same time */
+static int ringExchange(mlpComm * comm, void * sbuf, size_t sbytes, \
+void * rbuf, size_t rbytes)
+{
+	size_t sent = 0;
+	size_t received = 0;
+	ssize_t n;
+	struct pollfd pfd[2];
+
+	while(sent < sbytes || received < rbytes)
+	{
+		pfd[0].fd = sent < sbytes ? comm->sendFd : -1;
+		pfd[0].events = POLLOUT;
+		pfd[1].fd = received < rbytes ? comm->recvFd : -1;
+		pfd[1].events = POLLIN;
+		if(poll(pfd,2,-1) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return 1;
+		}
+
+		if(sent < sbytes && (pfd[0].revents & (POLLOUT|POLLERR|POLLHUP)))
+		{
+			n = send(comm->sendFd,(char*) sbuf + sent,sbytes-sent, \
+			MSG_NOSIGNAL);
+			if(n < 0 && errno != EAGAIN && errno != EINTR)
+				return 1;
+			if(n > 0)
+				sent += n;
+		}
+		if(received < rbytes && (pfd[1].revents & (POLLIN|POLLERR|POLLHUP)))
+		{
+			n = recv(comm->recvFd,(char*) rbuf + received, \
+			rbytes-received,0);
+			if(n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+				return 1;
+			if(n > 0)
+				received += n;
+		}
+	}
+
+	return 0;
+}
+
+/* Start the ring of sockets */
+static int ringInit(mlpComm * comm, char * address)
+{
+	comm->listenFd = ringListen(comm,address);
+	if(comm->listenFd < 0)
+		return 1;
+
+	/* The connection is queued by listen before the accept */
+	comm->sendFd = ringConnect(comm,address);
+	if(comm->sendFd < 0)
+		return 1;
+	comm->recvFd = accept(comm->listenFd,NULL,NULL);
+	if(comm->recvFd < 0)
+		return 1;
+
+	fcntl(comm->sendFd,F_SETFL,fcntl(comm->sendFd,F_GETFL) | O_NONBLOCK);
+	fcntl(comm->recvFd,F_SETFL,fcntl(comm->recvFd,F_GETFL) | O_NONBLOCK);
+
+	comm->buffer = (double*) malloc(sizeof(double)*comm->capacity);
+	if(comm->buffer == NULL)
+		return 1;
+
+	return 0;
+}
+
+/* Start the shared memory, rank 0 creates it */
+static int shmInit(mlpComm * comm, char * address)
+{
+	int fd = -1;
+	int tries;
+	struct stat st;
+	shmHeader * h;
+	pthread_barrierattr_t attr;
+
+	comm->shmSize = SHM_DATA + \
+	sizeof(double)*comm->capacity*(comm->size+1);
+
+	if(comm->rank == 0)
+	{
+		shm_unlink(address);
+		fd = shm_open(address,O_CREAT|O_EXCL|O_RDWR,0600);
+		if(fd < 0 || ftruncate(fd,comm->shmSize))
+			return 1;
+	}
+	else
+	{
+		for(tries=0; tries<MLP_DIST_TIMEOUT*100; tries++)
+		{
+			fd = shm_open(address,O_RDWR,0600);
+			if(fd >= 0 && fstat(fd,&st) == 0 && \
+			(size_t) st.st_size == comm->shmSize)
+				break;
+			if(fd >= 0)
+				close(fd);
+			fd = -1;
+			waitPeer();
+		}
+		if(fd < 0)
+			return 1;
+	}
+
+	comm->shm = mmap(NULL,comm->shmSize,PROT_READ|PROT_WRITE, \
+	MAP_SHARED,fd,0);
+	close(fd);
+	if(comm->shm == MAP_FAILED)
+	{
+		comm->shm = NULL;
+		return 1;
+	}
+
+	h = (shmHeader*) comm->shm;
+	if(comm->rank == 0)
+	{
+		pthread_barrierattr_init(&attr);
+		pthread_barrierattr_setpshared(&attr,PTHREAD_PROCESS_SHARED);
+		pthread_barrier_init(&h->barrier,&attr,comm->size);
+		pthread_barrierattr_destroy(&attr);
+		atomic_store(&h->ready,1);
+	}
+	else
+	{
+		for(tries=0; tries<MLP_DIST_TIMEOUT*100; tries++)
+		{
+			if(atomic_load(&h->ready))
+				break;
+			waitPeer();
+		}
+		if(!atomic_load(&h->ready))
+			return 1;
+	}
+
+	/* All processes attached, the name is not needed anymore */
+	pthread_barrier_wait(&h->barrier);
+	if(comm->rank == 0)
+		shm_unlink(address);
+
+	return 0;
+}
+
+/* Start the communicator */
+int commInit(mlpComm * comm, int rank, int size, int transport, \
+char * address, long int capacity)
+{
+	comm->rank = rank;
+	comm->size = size;
+	comm->transport = transport;
+	comm->capacity = capacity < 1 ? 1 : capacity;
+	comm->listenFd = -1;
+	comm->sendFd = -1;
+	comm->recvFd = -1;
+	comm->buffer = NULL;
+	comm->shm = NULL;
+	comm->shmSize = 0;
+
+	if(size < 1 || rank < 0 || rank >= size)
+		return 1;
+	if(size == 1)
+		return 0;
+
+	if(transport == MLP_DIST_SHM)
+		return shmInit(comm,address);
+
+	return ringInit(comm,address);
+}
+
+/* Ring-allreduce of at most 'capacity' doubles */
+static int ringAllreduce(mlpComm * comm, double * data, long int count)
+{
+	int size = comm->size;
+	int rank = comm->rank;
+	int k;
+	int s;
+	int r;
+	long int i;
+	long int sb;
+	long int se;
+	long int rb;
+	long int re;
+
+	/* Reduce-scatter, at the end rank has the chunk rank+1 */
+	for(k=0; k<size-1; k++)
+	{
+		s = (rank - k + size) % size;
+		r = (rank - k - 1 + size) % size;
+		sb = count*s/size;
+		se = count*(s+1)/size;
+		rb = count*r/size;
+		re = count*(r+1)/size;
+		if(ringExchange(comm,data + sb,sizeof(double)*(se-sb), \
+		comm->buffer,sizeof(double)*(re-rb)))
+			return 1;
+		for(i=rb; i<re; i++)
+			data[i] += comm->buffer[i-rb];
+	}
+
+	/* Allgather of the reduced chunks */
+	for(k=0; k<size-1; k++)
+	{
+		s = (rank + 1 - k + size) % size;
+		r = (rank - k + size) % size;
+		sb = count*s/size;
+		se = count*(s+1)/size;
+		rb = count*r/size;
+		re = count*(r+1)/size;
+		if(ringExchange(comm,data + sb,sizeof(double)*(se-sb), \
+		data + rb,sizeof(double)*(re-rb)))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Allreduce in shared memory of at most 'capacity' doubles */
+static int shmAllreduce(mlpComm * comm, double * data, long int count)
+{
+	shmHeader * h = (shmHeader*) comm->shm;
+	double * result = shmSlot(comm,comm->size);
+	long int begin = count*comm->rank/comm->size;
+	long int end = count*(comm->rank+1)/comm->size;
+	long int i;
+	int r;
+	double sum;
+
+	memcpy(shmSlot(comm,comm->rank),data,sizeof(double)*count);
+	pthread_barrier_wait(&h->barrier);
+
+	/* Each rank reduces one chunk */
+	for(i=begin; i<end; i++)
+	{
+		sum = 0;
+		for(r=0; r<comm->size; r++)
+			sum += shmSlot(comm,r)[i];
+		result[i] = sum;
+	}
+	pthread_barrier_wait(&h->barrier);
+
+	memcpy(data,result,sizeof(double)*count);
+
+	/* The next operation may write the result slot (commBroadcast) */
+	pthread_barrier_wait(&h->barrier);
+
+	return 0;
+}
+
+/* Sum of 'data' of all processes */
+int commAllreduce(mlpComm * comm, double * data, long int count)
+{
+	long int n;
+	int err;
+	while(comm->size > 1 && count > 0)
+	{
+		n = count < comm->capacity ? count : comm->capacity;
+		if(comm->transport == MLP_DIST_SHM)
+			err = shmAllreduce(comm,data,n);
+		else
+			err = ringAllreduce(comm,data,n);
+		if(err)
+			return 1;
+		data += n;
+		count -= n;
+	}
+
+	return 0;
+}
+
+/* Copy 'data' of rank 0 to all processes */
+int commBroadcast(mlpComm * comm, double * data, long int count)
+{
+	shmHeader * h;
+	long int n;
+	size_t bytes = sizeof(double)*count;
+
+	if(comm->size == 1)
+		return 0;
+
+	if(comm->transport == MLP_DIST_SHM)
+	{
+		h = (shmHeader*) comm->shm;
+		while(count > 0)
+		{
+			n = count < comm->capacity ? count : comm->capacity;
+			if(comm->rank == 0)
+				memcpy(shmSlot(comm,comm->size),data,sizeof(double)*n);
+			pthread_barrier_wait(&h->barrier);
+			if(comm->rank != 0)
+				memcpy(data,shmSlot(comm,comm->size),sizeof(double)*n);
+			pthread_barrier_wait(&h->barrier);
+			data += n;
+			count -= n;
+		}
+		return 0;
+	}
+
+	/* Ring: 0 -> 1 -> ... -> size-1 */
+	if(comm->rank != 0 && ringExchange(comm,NULL,0,data,bytes))
+		return 1;
+	if(comm->rank != comm->size-1 && ringExchange(comm,data,bytes,NULL,0))
+		return 1;
+
+	return 0;
+}
+
+/* Close the communicator */
+void commEnd(mlpComm * comm)
+{
+	if(comm->sendFd >= 0)
+		close(comm->sendFd);
+	if(comm->recvFd >= 0)
+		close(comm->recvFd);
+	if(comm->listenFd >= 0)
+		close(comm->listenFd);
+	if(comm->shm != NULL)
+		munmap(comm->shm,comm->shmSize);
+	free(comm->buffer);
+	comm->sendFd = -1;
+	comm->recvFd = -1;
+	comm->listenFd = -1;
+	comm->shm = NULL;
+	comm->buffer = NULL;
+}
+
+/* MLP Distributed Data-Parallel Training */
+double * trainingMLPDist(mlpComm * comm, double *** weights, \
+training * trainingData, char * activation, int batch)
+{
+	int nlayers = trainingData->nlayers;
+	int * neurons = trainingData->neurons;
+	int ninputs = trainingData->ninputs;
+	int examples = trainingData->examples;
+	int actv = getActv(activation);
+	long int count = weightsCount(neurons,nlayers,ninputs);
+	double * w = weights[0][0];
+
+	int i;
+	int j;
+	int e;
+	int n;
+	int width = ninputs;
+	long int k;
+	double total;
+	double allExamples = 0;
+	int maxShard = 0;
+	double sse = 0;
+	double mse;
+	long int counter = 0;
+	long int mse_counter = 1;
+	int stop = 0;
+
+	if(batch < 1)
+		batch = 1;
+
+	/* Same initial weights */
+	if(commBroadcast(comm,w,count))
+		return NULL;
+
+	/* Size of all shards */
+	double * shards = (double*) calloc(comm->size,sizeof(double));
+	if(shards == NULL)
+		return NULL;
+	shards[comm->rank] = examples;
+	if(commAllreduce(comm,shards,comm->size))
+		return NULL;
+	for(i=0; i<comm->size; i++)
+	{
+		allExamples += shards[i];
+		if(shards[i] > maxShard)
+			maxShard = (int) shards[i];
+	}
+	free(shards);
+	int stepsEpoch = (maxShard + batch - 1)/batch;
+
+	/* Update of the mini-batch, its size and its squared error */
+	double * buffer = (double*) calloc(count+2,sizeof(double));
+	double * delta = (double*) calloc(count,sizeof(double));
+	double *** step = weightsMap(buffer,neurons,nlayers,ninputs);
+	int * xidx = (int*) malloc(sizeof(int)*(examples+1));
+	for(i=0; i<nlayers; i++)
+	{
+		if(neurons[i] > width)
+			width = neurons[i];
+	}
+	double ** yout = matrixAlloc(nlayers,width);
+	double * gs = (double*) malloc(sizeof(double)*width);
+	double * gsPrev = (double*) malloc(sizeof(double)*width);
+	/* The position 0 of mse_hist is the last position of history */
+	double * mse_hist = (double*) malloc(sizeof(double)* \
+	((long int) (trainingData->maxIteration/allExamples)+2));
+	if(buffer == NULL || delta == NULL || step == NULL || xidx == NULL || \
+	gs == NULL || gsPrev == NULL || mse_hist == NULL)
+		return NULL;
+	for(e=0; e<examples; e++)
+		xidx[e] = e;
+
+	while(!stop)
+	{
+		vperm(xidx,examples);
+		for(j=0; j<stepsEpoch && !stop; j++)
+		{
+			n = examples - j*batch;
+			if(n > batch)
+				n = batch;
+			for(e=0; e<n; e++)
+			{
+				i = xidx[j*batch + e];
+				buffer[count+1] += exampleAccumulate(weights,step, \
+				trainingData,actv,trainingData->x[i], \
+				trainingData->reference[i],yout,gs,gsPrev);
+			}
+			buffer[count] = n > 0 ? n : 0;
+
+			if(commAllreduce(comm,buffer,count+2))
+			{
+				stop = -1;
+				break;
+			}
+
+			/* Same update in all processes */
+			total = buffer[count];
+			for(k=0; k<count && total>0; k++)
+			{
+				delta[k] = trainingData->lrate*buffer[k]/total + \
+				trainingData->alpha*delta[k];
+				w[k] += delta[k];
+			}
+			counter += (long int) total;
+			sse += buffer[count+1];
+			memset(buffer,0,sizeof(double)*(count+2));
+
+			if(j == stepsEpoch-1)
+			{
+				mse = sse/allExamples;
+				sse = 0;
+				mse_hist[mse_counter] = mse;
+				mse_counter += 1;
+#ifdef DEBUG_MODE
+				if(comm->rank == 0)
+					printf("Rank 0 - Iterations %ld - MSE: %.4e\n", \
+					counter,mse);
+#endif
+				if(mse <= trainingData->acceptedError)
+					stop = 1;
+			}
+			if(counter >= trainingData->maxIteration)
+				stop = 1;
+		}
+	}
+
+	/* Add in the position '0' the 'mse_counter'-1 
+	 * to identify the last position of history
+	 */
+	mse_hist[0] = mse_counter-1;
+
+	weightsUnmap(step,nlayers);
+	free(buffer);
+	free(delta);
+	free(xidx);
+	free(gs);
+	free(gsPrev);
+	for(i=0; i<nlayers; i++)
+		free(yout[i]);
+	free(yout);
+
+	if(stop < 0)
+	{
+		free(mse_hist);
+		return NULL;
+	}
+
+	return mse_hist;
+}
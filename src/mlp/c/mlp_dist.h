@@ -0,0 +1,101 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MLP_DIST_H
+#define _MLP_DIST_H
+
+#include <pthread.h>
+#include "mlp.h"
+
+/* Transports between the processes */
+#define MLP_DIST_TCP 0
+#define MLP_DIST_UNIX 1
+#define MLP_DIST_SHM 2
+
+/* Seconds waiting the other processes in commInit */
+#ifndef MLP_DIST_TIMEOUT
+	#define MLP_DIST_TIMEOUT 30
+#endif
+
+/* Communicator of a group of processes */
+typedef struct
+{
+	int rank;
+	int size;
+	int transport;
+	long int capacity;
+	/* Ring: connection to rank+1 and from rank-1 */
+	int listenFd;
+	int sendFd;
+	int recvFd;
+	double * buffer;
+	/* Shared memory */
+	void * shm;
+	size_t shmSize;
+} mlpComm;
+
+/* Start the communicator of process 'rank' in a group of 'size'.
+ * transport = MLP_DIST_TCP, MLP_DIST_UNIX or MLP_DIST_SHM
+ * address:
+ *   TCP: "host:port", rank r listens in port+r of the same host,
+ *        or "host0:port0,host1:port1,..." with one address by rank
+ *   UNIX: path prefix, rank r listens in "path.r"
+ *   SHM: name of the shared memory object, like "/mlp"
+ * capacity = maximum doubles in one collective operation
+ * return 0 on success, 1 in error
+ */
+int commInit(mlpComm * comm, int rank, int size, int transport, \
+char * address, long int capacity);
+
+/* Sum of 'data' of all processes, the result in all of them.
+ * TCP and UNIX use a ring-allreduce: reduce-scatter and allgather.
+ * return 0 on success, 1 in error
+ */
+int commAllreduce(mlpComm * comm, double * data, long int count);
+
+/* Copy 'data' of rank 0 to all processes, return 1 in error */
+int commBroadcast(mlpComm * comm, double * data, long int count);
+
+/* Close the communicator */
+void commEnd(mlpComm * comm);
+
+/* MLP Distributed Data-Parallel Training
+ * Each process trains its own shard in 'trainingData' (same
+ * architecture and parameters in all of them). The weights of rank 0
+ * are copied to all processes, then each mini-batch the updates are
+ * summed with commAllreduce and applied like layerApply, so all
+ * processes keep the same weights.
+ *
+ * weights = layers X neurons X weights, from weightsAlloc or initMLP
+ * batch = examples by mini-batch in each process
+ * return History of MSE of all shards, the position 0 is the size of
+ *   history, NULL in error
+ */
+double * trainingMLPDist(mlpComm * comm, double *** weights, \
+training * trainingData, char * activation, int batch);
+
+#endif /* _MLP_DIST_H */
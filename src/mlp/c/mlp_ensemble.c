@@ -0,0 +1,345 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mlp_ensemble.h"
+
+/* Out of a block-diagonal layer for 'count' examples, neuron i of the
+ * member m = i/neurons reads the inputs [m*nin, (m+1)*nin) of an example
+ * Four examples by pass over the weights of a neuron, like layerOutBatch
+ */
+static void blockOutBatch(double * dest, double * in, int count, \
+double ** weights, int members, int nin, int neurons, int activation)
+{
+	int width = members*neurons;
+	int inWidth = members*nin;
+	int e;
+	int i;
+	int j;
+	double s0;
+	double s1;
+	double s2;
+	double s3;
+	double wj;
+	double * w;
+	double * x0;
+	double * x1;
+	double * x2;
+	double * x3;
+
+	for(e=0; e+4<=count; e+=4)
+	{
+		for(i=0; i<width; i++)
+		{
+			x0 = in + (long int) e*inWidth + (i/neurons)*nin;
+			x1 = x0 + inWidth;
+			x2 = x1 + inWidth;
+			x3 = x2 + inWidth;
+			w = weights[i];
+			s0 = 1.0 * w[0];
+			s1 = s0;
+			s2 = s0;
+			s3 = s0;
+			for(j=0; j<nin; j++)
+			{
+				wj = w[j+1];
+				s0 += x0[j] * wj;
+				s1 += x1[j] * wj;
+				s2 += x2[j] * wj;
+				s3 += x3[j] * wj;
+			}
+			dest[(long int) e*width + i] = activationOut(s0,activation);
+			dest[(long int) (e+1)*width + i] = activationOut(s1,activation);
+			dest[(long int) (e+2)*width + i] = activationOut(s2,activation);
+			dest[(long int) (e+3)*width + i] = activationOut(s3,activation);
+		}
+	}
+
+	for(; e<count; e++)
+	{
+		for(i=0; i<width; i++)
+		{
+			x0 = in + (long int) e*inWidth + (i/neurons)*nin;
+			w = weights[i];
+			s0 = 1.0 * w[0];
+			for(j=0; j<nin; j++)
+				s0 += x0[j] * w[j+1];
+			dest[(long int) e*width + i] = activationOut(s0,activation);
+		}
+	}
+}
+
+/* Combine the outputs of the members, y = members X outs */
+static void ensembleCombine(mlpEnsemble * ens, double * y, int rule, \
+double * out)
+{
+	int members = ens->members;
+	int outs = ens->neurons[ens->nlayers-1];
+	int m;
+	int o;
+	int best;
+	double total = 0;
+	double * ym;
+
+	for(o=0; o<outs; o++)
+		out[o] = 0;
+
+	for(m=0; m<members; m++)
+	{
+		ym = y + m*outs;
+		if(rule == ENSEMBLE_VOTE)
+		{
+			if(outs == 1)
+			{
+				out[0] += ym[0] >= 0.5;
+				continue;
+			}
+			best = 0;
+			for(o=1; o<outs; o++)
+			{
+				if(ym[o] > ym[best])
+					best = o;
+			}
+			out[best] += 1;
+		}
+		else if(rule == ENSEMBLE_WEIGHTED)
+		{
+			for(o=0; o<outs; o++)
+				out[o] += ens->combination[m] * ym[o];
+			total += ens->combination[m];
+		}
+		else
+		{
+			for(o=0; o<outs; o++)
+				out[o] += ym[o];
+		}
+	}
+
+	if(rule != ENSEMBLE_WEIGHTED)
+		total = members;
+	for(o=0; o<outs; o++)
+		out[o] /= total;
+}
+
+/* Fuse the members */
+mlpEnsemble * ensembleCreate(double **** weights, training ** trainingData, \
+int members)
+{
+	int nlayers;
+	int layer;
+	int nin;
+	int m;
+	int i;
+	int j;
+	double * data;
+	double ** w;
+	mlpEnsemble * ens;
+
+	if(members < 1)
+		return NULL;
+	nlayers = trainingData[0]->nlayers;
+
+	/* Same shape */
+	for(m=1; m<members; m++)
+	{
+		if(trainingData[m]->nlayers != nlayers || \
+		trainingData[m]->ninputs != trainingData[0]->ninputs || \
+		memcmp(trainingData[m]->neurons,trainingData[0]->neurons, \
+		sizeof(int)*nlayers))
+		{
+#ifdef DEBUG_MODE
+			printf("Ensemble member %d with other shape.\n",m);
+#endif
+			return NULL;
+		}
+	}
+
+	ens = (mlpEnsemble*) calloc(1,sizeof(mlpEnsemble));
+	if(ens == NULL)
+		return NULL;
+	ens->members = members;
+	ens->nlayers = nlayers;
+	ens->ninputs = trainingData[0]->ninputs;
+	ens->neurons = (int*) malloc(sizeof(int)*nlayers);
+	ens->weights = (double***) calloc(nlayers,sizeof(double**));
+	ens->combination = (double*) malloc(sizeof(double)*members);
+	if(ens->neurons == NULL || ens->weights == NULL || \
+	ens->combination == NULL)
+	{
+		ensembleDestroy(ens);
+		return NULL;
+	}
+	memcpy(ens->neurons,trainingData[0]->neurons,sizeof(int)*nlayers);
+	for(m=0; m<members; m++)
+		ens->combination[m] = 1;
+
+	for(layer=0; layer<nlayers; layer++)
+	{
+		nin = layer ? ens->neurons[layer-1] : ens->ninputs;
+		w = (double**) malloc(sizeof(double*)*members*ens->neurons[layer]);
+		data = (double*) malloc(sizeof(double)* \
+		(long int) members*ens->neurons[layer]*(nin+1));
+		if(w == NULL || data == NULL)
+		{
+			free(w);
+			free(data);
+			ensembleDestroy(ens);
+			return NULL;
+		}
+		ens->weights[layer] = w;
+
+		for(m=0; m<members; m++)
+		{
+			for(i=0; i<ens->neurons[layer]; i++)
+			{
+				w[m*ens->neurons[layer] + i] = data;
+				data[0] = trainingData[m]->bias[layer] * \
+				weights[m][layer][i][0];
+				for(j=1; j<=nin; j++)
+					data[j] = weights[m][layer][i][j];
+				data += nin+1;
+			}
+		}
+	}
+
+	return ens;
+}
+
+/* Weights of the members */
+int ensembleWeights(mlpEnsemble * ens, double * combination)
+{
+	int m;
+	double total = 0;
+
+	/* The weighted mean divides by the sum */
+	for(m=0; m<ens->members; m++)
+		total += combination[m];
+	if(total == 0 || total != total)
+		return 1;
+
+	memcpy(ens->combination,combination,sizeof(double)*ens->members);
+	return 0;
+}
+
+/* Combined output of a batch */
+int ensembleOutBatch(mlpEnsemble * ens, char * activation, double ** in, \
+int first, int count, int rule, double ** out)
+{
+	int members = ens->members;
+	int nlayers = ens->nlayers;
+	int * neurons = ens->neurons;
+	int ninputs = ens->ninputs;
+	int layer;
+	int e;
+	int n;
+	int block;
+	int width = ninputs;
+	int actv = getActv(activation);
+	double * a;
+	double * b;
+	double * tmp;
+
+	for(layer=0; layer<nlayers; layer++)
+	{
+		if(members*neurons[layer] > width)
+			width = members*neurons[layer];
+	}
+
+	/* Memory for the outputs of all members for a block of examples */
+	a = (double*) malloc(sizeof(double)*MLP_BATCH_BLOCK*width);
+	b = (double*) malloc(sizeof(double)*MLP_BATCH_BLOCK*width);
+	if(a == NULL || b == NULL)
+	{
+		free(a);
+		free(b);
+		return 1;
+	}
+
+	for(block=0; block<count; block+=MLP_BATCH_BLOCK)
+	{
+		n = count - block;
+		if(n > MLP_BATCH_BLOCK)
+			n = MLP_BATCH_BLOCK;
+
+		for(e=0; e<n; e++)
+		{
+			memcpy(a + e*ninputs,in[first+block+e], \
+			sizeof(double)*ninputs);
+		}
+
+		/* Layer 0 of all members reads the same input */
+		layerOutBatch(b,a,n,1.0,ens->weights[0],ninputs, \
+		members*neurons[0],actv);
+		tmp = a;
+		a = b;
+		b = tmp;
+
+		for(layer=1; layer<nlayers; layer++)
+		{
+			blockOutBatch(b,a,n,ens->weights[layer],members, \
+			neurons[layer-1],neurons[layer],actv);
+			tmp = a;
+			a = b;
+			b = tmp;
+		}
+
+		for(e=0; e<n; e++)
+		{
+			ensembleCombine(ens,a + e*members*neurons[nlayers-1],rule, \
+			out[block+e]);
+		}
+	}
+
+	free(a);
+	free(b);
+	return 0;
+}
+
+/* Combined output of one example */
+int ensembleOut(mlpEnsemble * ens, char * activation, double ** in, \
+int pos, int rule, double * out)
+{
+	return ensembleOutBatch(ens,activation,in,pos,1,rule,&out);
+}
+
+/* Deallocate */
+void ensembleDestroy(mlpEnsemble * ens)
+{
+	int layer;
+	if(ens == NULL)
+		return;
+
+	for(layer=0; ens->weights != NULL && layer<ens->nlayers; layer++)
+	{
+		if(ens->weights[layer] != NULL)
+			free(ens->weights[layer][0]);
+		free(ens->weights[layer]);
+	}
+	free(ens->weights);
+	free(ens->neurons);
+	free(ens->combination);
+	free(ens);
+}
@@ -0,0 +1,86 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MLP_ENSEMBLE_H
+#define _MLP_ENSEMBLE_H
+
+#include "mlp.h"
+
+/* Combination of the outputs of the members */
+#define ENSEMBLE_MEAN 0		/* mean of the outputs */
+#define ENSEMBLE_VOTE 1		/* fraction of the members voting each
+				 * output (largest output, or >= 0.5 with
+				 * one output) */
+#define ENSEMBLE_WEIGHTED 2	/* mean weighted by ensembleWeights */
+
+/* Ensemble of MLPs with the same shape fused in wider layers:
+ * layer 0 is one dense layer of members X neurons[0] over the shared
+ * input, the next layers are block-diagonal (each member only reads
+ * its own outputs of the previous layer). The bias of each member is
+ * folded in its bias weights.
+ * weights = layer X (members X neurons) X (inputs of a member + 1)
+ */
+typedef struct
+{
+	int members;
+	int nlayers;
+	int ninputs;
+	int * neurons;
+	double *** weights;
+	double * combination;
+} mlpEnsemble;
+
+/* Fuse 'members' MLPs, trainingData[m] is the configuration of
+ * weights[m], all with the same layers and inputs. The weights are
+ * copied, the members can be deallocated.
+ * return NULL in error or with different shapes
+ */
+mlpEnsemble * ensembleCreate(double **** weights, training ** trainingData, \
+int members);
+
+/* Weights of the members in ENSEMBLE_WEIGHTED (default 1), copied
+ * return 0 = success, 1 = the weights sum to zero (not changed)
+ */
+int ensembleWeights(mlpEnsemble * ens, double * combination);
+
+/* Combined output for in[first] until in[first+count-1] in one pass
+ * of all members by block of examples
+ * rule = ENSEMBLE_MEAN, ENSEMBLE_VOTE or ENSEMBLE_WEIGHTED
+ * The 'out' is a matrix 'count' X outputs
+ * return 0 = success, 1 = error
+ */
+int ensembleOutBatch(mlpEnsemble * ens, char * activation, double ** in, \
+int first, int count, int rule, double ** out);
+
+/* Combined output for in[pos] */
+int ensembleOut(mlpEnsemble * ens, char * activation, double ** in, \
+int pos, int rule, double * out);
+
+/* Deallocate */
+void ensembleDestroy(mlpEnsemble * ens);
+
+#endif /* _MLP_ENSEMBLE_H */
@@ -0,0 +1,410 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mlp_half.h"
+
+#if defined(__F16C__) && defined(__AVX2__)
+	#include <immintrin.h>
+	#define MLP_HALF_AVX
+#endif
+
+/* float to fp16 */
+mlpHalf halfFromFloat(float f)
+{
+	uint32_t x;
+	uint32_t sign;
+	uint32_t man;
+	uint32_t half;
+	uint32_t rem;
+	uint32_t halfway;
+	int e;
+	int shift;
+
+	memcpy(&x,&f,sizeof(x));
+	sign = (x >> 16) & 0x8000;
+	man = x & 0x7fffff;
+	if(((x >> 23) & 0xff) == 0xff)
+		return sign | 0x7c00 | (man ? 0x200 : 0);
+
+	e = (int) ((x >> 23) & 0xff) - 127 + 15;
+	if(e >= 0x1f)
+		return sign | 0x7c00;
+	if(e <= 0)
+	{
+		/* Subnormal or zero */
+		if(e < -10)
+			return sign;
+		man |= 0x800000;
+		shift = 14 - e;
+		half = man >> shift;
+		rem = man & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+		if(rem > halfway || (rem == halfway && (half & 1)))
+			half++;
+		return sign | half;
+	}
+
+	half = ((uint32_t) e << 10) | (man >> 13);
+	rem = man & 0x1fff;
+	if(rem > 0x1000 || (rem == 0x1000 && (half & 1)))
+		half++;
+	return sign | half;
+}
+
+/* fp16 to float */
+float halfToFloat(mlpHalf h)
+{
+	uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+	uint32_t e = (h >> 10) & 0x1f;
+	uint32_t man = h & 0x3ff;
+	uint32_t x;
+	float f;
+
+	if(e == 0)
+	{
+		if(man == 0)
+		{
+			x = sign;
+		}
+		else
+		{
+			/* Subnormal, normalize */
+			e = 113;
+			while(!(man & 0x400))
+			{
+				man <<= 1;
+				e--;
+			}
+			x = sign | (e << 23) | ((man & 0x3ff) << 13);
+		}
+	}
+	else if(e == 0x1f)
+	{
+		x = sign | 0x7f800000 | (man << 13);
+	}
+	else
+	{
+		x = sign | ((e + 112) << 23) | (man << 13);
+	}
+
+	memcpy(&f,&x,sizeof(f));
+	return f;
+}
+
+/* float to bf16 */
+mlpHalf bf16FromFloat(float f)
+{
+	uint32_t x;
+	memcpy(&x,&f,sizeof(x));
+	if((x & 0x7fffffff) > 0x7f800000)
+		return (x >> 16) | 0x40;
+	x += 0x7fff + ((x >> 16) & 1);
+	return x >> 16;
+}
+
+/* bf16 to float */
+float bf16ToFloat(mlpHalf h)
+{
+	uint32_t x = (uint32_t) h << 16;
+	float f;
+	memcpy(&f,&x,sizeof(f));
+	return f;
+}
+
+/* Half-precision copy of the weights */
+mlpHalfNet * halfNetCreate(double *** weights, training * trainingData, \
+int format)
+{
+	int layer;
+	int neuron;
+	int nin;
+	int w;
+	mlpHalf * p;
+	mlpHalfNet * net = (mlpHalfNet*) calloc(1,sizeof(mlpHalfNet));
+	if(net == NULL)
+		return NULL;
+
+	net->format = format == MLP_HALF_BF16 ? MLP_HALF_BF16 : MLP_HALF_FP16;
+	net->nlayers = trainingData->nlayers;
+	net->ninputs = trainingData->ninputs;
+	net->neurons = trainingData->neurons;
+	net->bias = trainingData->bias;
+	net->weights = (mlpHalf**) calloc(net->nlayers,sizeof(mlpHalf*));
+	if(net->weights == NULL)
+	{
+		halfNetDestroy(net);
+		return NULL;
+	}
+
+	for(layer=0; layer<net->nlayers; layer++)
+	{
+		nin = layer ? net->neurons[layer-1] : net->ninputs;
+		p = (mlpHalf*) \
+		malloc(sizeof(mlpHalf)*net->neurons[layer]*(nin+1));
+		if(p == NULL)
+		{
+			halfNetDestroy(net);
+			return NULL;
+		}
+		net->weights[layer] = p;
+		for(neuron=0; neuron<net->neurons[layer]; neuron++)
+		{
+			for(w=0; w<=nin; w++)
+			{
+				*p++ = net->format == MLP_HALF_BF16 ? \
+				bf16FromFloat((float) weights[layer][neuron][w]) : \
+				halfFromFloat((float) weights[layer][neuron][w]);
+			}
+		}
+	}
+
+	return net;
+}
+
+/* Bytes of the weights of the net */
+long int halfNetBytes(mlpHalfNet * net)
+{
+	int layer;
+	long int bytes = 0;
+	for(layer=0; layer<net->nlayers; layer++)
+	{
+		bytes += (long int) sizeof(mlpHalf)*net->neurons[layer]* \
+		((layer ? net->neurons[layer-1] : net->ninputs)+1);
+	}
+	return bytes;
+}
+
+/* Widen one weight */
+static inline float halfWiden(mlpHalf h, int format)
+{
+	return format == MLP_HALF_BF16 ? bf16ToFloat(h) : halfToFloat(h);
+}
+
+#ifdef MLP_HALF_AVX
+/* Widen 8 weights */
+static inline __m256 halfWiden8(const mlpHalf * p, int format)
+{
+	__m128i h = _mm_loadu_si128((const __m128i*) p);
+	if(format == MLP_HALF_BF16)
+	{
+		return _mm256_castsi256_ps( \
+		_mm256_slli_epi32(_mm256_cvtepu16_epi32(h),16));
+	}
+	return _mm256_cvtph_ps(h);
+}
+
+/* Sum of the 8 floats */
+static inline float halfSum8(__m256 v)
+{
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(v), \
+	_mm256_extractf128_ps(v,1));
+	s = _mm_add_ps(s,_mm_movehl_ps(s,s));
+	s = _mm_add_ss(s,_mm_movehdup_ps(s));
+	return _mm_cvtss_f32(s);
+}
+#endif
+
+/* Out of a layer for 'count' input vectors
+ * dest = count X neurons, in = count X nin
+ */
+static void halfLayerOut(float * dest, float * in, int count, float bias, \
+mlpHalf * weights, int nin, int neurons, int format, int activation)
+{
+	int e;
+	int i;
+	int j;
+	float s0;
+	float s1;
+	float s2;
+	float s3;
+	float wj;
+	mlpHalf * w;
+	float * x0;
+	float * x1;
+	float * x2;
+	float * x3;
+
+	/* Four examples by pass over the weights of a neuron */
+	for(e=0; e+4<=count; e+=4)
+	{
+		x0 = in + e*nin;
+		x1 = x0 + nin;
+		x2 = x1 + nin;
+		x3 = x2 + nin;
+		for(i=0; i<neurons; i++)
+		{
+			w = weights + (long int) i*(nin+1);
+			s0 = bias * halfWiden(w[0],format);
+			s1 = s0;
+			s2 = s0;
+			s3 = s0;
+			w++;
+			j = 0;
+#ifdef MLP_HALF_AVX
+			{
+				__m256 a0 = _mm256_setzero_ps();
+				__m256 a1 = _mm256_setzero_ps();
+				__m256 a2 = _mm256_setzero_ps();
+				__m256 a3 = _mm256_setzero_ps();
+				__m256 wv;
+				for(; j+8<=nin; j+=8)
+				{
+					wv = halfWiden8(w+j,format);
+					a0 = _mm256_add_ps(a0, \
+					_mm256_mul_ps(wv,_mm256_loadu_ps(x0+j)));
+					a1 = _mm256_add_ps(a1, \
+					_mm256_mul_ps(wv,_mm256_loadu_ps(x1+j)));
+					a2 = _mm256_add_ps(a2, \
+					_mm256_mul_ps(wv,_mm256_loadu_ps(x2+j)));
+					a3 = _mm256_add_ps(a3, \
+					_mm256_mul_ps(wv,_mm256_loadu_ps(x3+j)));
+				}
+				s0 += halfSum8(a0);
+				s1 += halfSum8(a1);
+				s2 += halfSum8(a2);
+				s3 += halfSum8(a3);
+			}
+#endif
+			for(; j<nin; j++)
+			{
+				wj = halfWiden(w[j],format);
+				s0 += x0[j] * wj;
+				s1 += x1[j] * wj;
+				s2 += x2[j] * wj;
+				s3 += x3[j] * wj;
+			}
+			dest[e*neurons + i] = activationOut(s0,activation);
+			dest[(e+1)*neurons + i] = activationOut(s1,activation);
+			dest[(e+2)*neurons + i] = activationOut(s2,activation);
+			dest[(e+3)*neurons + i] = activationOut(s3,activation);
+		}
+	}
+
+	for(; e<count; e++)
+	{
+		x0 = in + e*nin;
+		for(i=0; i<neurons; i++)
+		{
+			w = weights + (long int) i*(nin+1);
+			s0 = bias * halfWiden(w[0],format);
+			for(j=0; j<nin; j++)
+				s0 += x0[j] * halfWiden(w[j+1],format);
+			dest[e*neurons + i] = activationOut(s0,activation);
+		}
+	}
+}
+
+/* Output of the net for a batch */
+int halfNetOutBatch(mlpHalfNet * net, char * activation, double ** in, \
+int first, int count, double ** out)
+{
+	int nlayers = net->nlayers;
+	int * neurons = net->neurons;
+	int ninputs = net->ninputs;
+	int outs = neurons[nlayers-1];
+	int layer;
+	int e;
+	int j;
+	int n;
+	int block;
+	int width = ninputs;
+	int actv = getActv(activation);
+	float * a;
+	float * b;
+	float * tmp;
+
+	for(layer=0; layer<nlayers; layer++)
+	{
+		if(neurons[layer] > width)
+			width = neurons[layer];
+	}
+
+	/* Memory for the outputs of a block of examples */
+	a = (float*) malloc(sizeof(float)*MLP_BATCH_BLOCK*width);
+	b = (float*) malloc(sizeof(float)*MLP_BATCH_BLOCK*width);
+	if(a == NULL || b == NULL)
+	{
+		free(a);
+		free(b);
+		return 1;
+	}
+
+	for(block=0; block<count; block+=MLP_BATCH_BLOCK)
+	{
+		n = count - block;
+		if(n > MLP_BATCH_BLOCK)
+			n = MLP_BATCH_BLOCK;
+
+		for(e=0; e<n; e++)
+		{
+			for(j=0; j<ninputs; j++)
+				a[e*ninputs + j] = (float) in[first+block+e][j];
+		}
+
+		/* Propagation */
+		for(layer=0; layer<nlayers; layer++)
+		{
+			halfLayerOut(b,a,n,(float) net->bias[layer], \
+			net->weights[layer],layer ? neurons[layer-1] : ninputs, \
+			neurons[layer],net->format,actv);
+			tmp = a;
+			a = b;
+			b = tmp;
+		}
+
+		/* Copy output of last layer to out */
+		for(e=0; e<n; e++)
+		{
+			for(j=0; j<outs; j++)
+				out[block+e][j] = a[e*outs + j];
+		}
+	}
+
+	free(a);
+	free(b);
+	return 0;
+}
+
+/* Output of the net for in[pos] */
+int halfNetOut(mlpHalfNet * net, char * activation, double ** in, \
+int pos, double * out)
+{
+	return halfNetOutBatch(net,activation,in,pos,1,&out);
+}
+
+/* Deallocate the net */
+void halfNetDestroy(mlpHalfNet * net)
+{
+	int layer;
+	if(net == NULL)
+		return;
+
+	for(layer=0; net->weights != NULL && layer<net->nlayers; layer++)
+		free(net->weights[layer]);
+	free(net->weights);
+	free(net);
+}
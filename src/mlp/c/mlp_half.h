@@ -0,0 +1,89 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MLP_HALF_H
+#define _MLP_HALF_H
+
+#include <stdint.h>
+#include "mlp.h"
+
+/* Formats of the weights */
+#define MLP_HALF_FP16 1
+#define MLP_HALF_BF16 2
+
+/* Half-precision number (fp16 or bf16 bits) */
+typedef uint16_t mlpHalf;
+
+/* MLP with half-precision weights for inference.
+ * weights[layer] = neurons X (nin+1) halfs, neuron by neuron, bias
+ * weight first. The outputs of the layers are float and the sums are
+ * accumulated in float.
+ */
+typedef struct
+{
+	int format;
+	int nlayers;
+	int ninputs;
+	int * neurons;
+	double * bias;
+	mlpHalf ** weights;
+} mlpHalfNet;
+
+/* Conversions, round to nearest even */
+mlpHalf halfFromFloat(float f);
+float halfToFloat(mlpHalf h);
+mlpHalf bf16FromFloat(float f);
+float bf16ToFloat(mlpHalf h);
+
+/* Half-precision copy of the weights
+ * format = MLP_HALF_FP16 or MLP_HALF_BF16
+ * The struct keeps pointers to neurons and bias of 'trainingData'.
+ * return NULL in error
+ */
+mlpHalfNet * halfNetCreate(double *** weights, training * trainingData, \
+int format);
+
+/* Bytes of the weights of the net */
+long int halfNetBytes(mlpHalfNet * net);
+
+/* Output of the net for in[first] until in[first+count-1], 4 examples
+ * by pass over the weights of each neuron. The weights are widened to
+ * float in registers (F16C with -mf16c, portable code otherwise).
+ * The 'out' is a matrix 'count' X outputs
+ * return 0 = success, 1 = error
+ */
+int halfNetOutBatch(mlpHalfNet * net, char * activation, double ** in, \
+int first, int count, double ** out);
+
+/* Output of the net for in[pos] */
+int halfNetOut(mlpHalfNet * net, char * activation, double ** in, \
+int pos, double * out);
+
+/* Deallocate the net */
+void halfNetDestroy(mlpHalfNet * net);
+
+#endif /* _MLP_HALF_H */
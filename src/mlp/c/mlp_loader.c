@@ -0,0 +1,226 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mlp_loader.h"
+
+/* Doubles of a row rounded up to the alignment */
+static int loaderStride(int n)
+{
+	int m = MLP_LOADER_ALIGN/sizeof(double);
+	return (n + m - 1)/m*m;
+}
+
+/* Gather the next batch, shuffle at the start of each epoch */
+static void loaderFill(mlpLoader * loader, loaderBuffer * b)
+{
+	training * tr = loader->trainingData;
+	int outs = tr->neurons[tr->nlayers-1];
+	int e;
+	int i;
+	int sw;
+
+	if(loader->pos == 0)
+	{
+		/* Fisher-Yates */
+		for(e=tr->examples-1; e>0; e--)
+		{
+			i = rand_r(&loader->seed) % (e+1);
+			sw = loader->perm[e];
+			loader->perm[e] = loader->perm[i];
+			loader->perm[i] = sw;
+		}
+	}
+
+	b->count = tr->examples - loader->pos;
+	if(b->count > loader->batch)
+		b->count = loader->batch;
+	for(e=0; e<b->count; e++)
+	{
+		i = loader->perm[loader->pos + e];
+		b->idx[e] = i;
+		memcpy(b->x[e],tr->x[i],sizeof(double)*tr->ninputs);
+		memcpy(b->reference[e],tr->reference[i],sizeof(double)*outs);
+	}
+
+	loader->pos += b->count;
+	b->epochEnd = loader->pos == tr->examples;
+	if(b->epochEnd)
+		loader->pos = 0;
+}
+
+/* Background thread, fills the free buffers */
+static void * loaderThread(void * varg)
+{
+	mlpLoader * loader = (mlpLoader*) varg;
+	loaderBuffer * b;
+
+	pthread_mutex_lock(&loader->lock);
+	while(!loader->quit)
+	{
+		b = &loader->buffer[loader->next];
+		if(b->ready)
+		{
+			pthread_cond_wait(&loader->cond,&loader->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&loader->lock);
+
+		loaderFill(loader,b);
+
+		pthread_mutex_lock(&loader->lock);
+		b->ready = 1;
+		loader->next ^= 1;
+		pthread_cond_broadcast(&loader->cond);
+	}
+	pthread_mutex_unlock(&loader->lock);
+
+	return NULL;
+}
+
+/* Create a loader */
+mlpLoader * loaderCreate(training * trainingData, int batch, \
+unsigned int seed)
+{
+	int outs = trainingData->neurons[trainingData->nlayers-1];
+	int sx = loaderStride(trainingData->ninputs);
+	int sr = loaderStride(outs);
+	int b;
+	int e;
+	void * mem;
+	mlpLoader * loader = (mlpLoader*) calloc(1,sizeof(mlpLoader));
+	if(loader == NULL)
+		return NULL;
+
+	if(batch < 1)
+		batch = 1;
+	if(batch > trainingData->examples)
+		batch = trainingData->examples;
+	loader->trainingData = trainingData;
+	loader->batch = batch;
+	loader->seed = seed;
+	loader->perm = (int*) malloc(sizeof(int)*trainingData->examples);
+	if(loader->perm == NULL)
+	{
+		loaderDestroy(loader);
+		return NULL;
+	}
+	for(e=0; e<trainingData->examples; e++)
+		loader->perm[e] = e;
+
+	/* Inputs and references of a batch in one aligned block */
+	for(b=0; b<2; b++)
+	{
+		if(posix_memalign(&mem,MLP_LOADER_ALIGN, \
+		sizeof(double)*batch*(sx+sr)))
+			mem = NULL;
+		loader->buffer[b].data = (double*) mem;
+		loader->buffer[b].x = (double**) malloc(sizeof(double*)*batch);
+		loader->buffer[b].reference = (double**) \
+		malloc(sizeof(double*)*batch);
+		loader->buffer[b].idx = (int*) malloc(sizeof(int)*batch);
+		if(mem == NULL || loader->buffer[b].x == NULL || \
+		loader->buffer[b].reference == NULL || loader->buffer[b].idx == NULL)
+		{
+			loaderDestroy(loader);
+			return NULL;
+		}
+		for(e=0; e<batch; e++)
+		{
+			loader->buffer[b].x[e] = loader->buffer[b].data + e*sx;
+			loader->buffer[b].reference[e] = \
+			loader->buffer[b].data + batch*sx + e*sr;
+		}
+	}
+
+	pthread_mutex_init(&loader->lock,NULL);
+	pthread_cond_init(&loader->cond,NULL);
+	loader->current = -1;
+	if(pthread_create(&loader->thread,NULL,loaderThread,loader))
+	{
+		pthread_cond_destroy(&loader->cond);
+		pthread_mutex_destroy(&loader->lock);
+		loaderDestroy(loader);
+		return NULL;
+	}
+	loader->started = 1;
+
+	return loader;
+}
+
+/* Next batch */
+loaderBuffer * loaderNext(mlpLoader * loader)
+{
+	loaderBuffer * b;
+
+	pthread_mutex_lock(&loader->lock);
+	if(loader->current >= 0)
+	{
+		loader->buffer[loader->current].ready = 0;
+		pthread_cond_broadcast(&loader->cond);
+		loader->current ^= 1;
+	}
+	else
+	{
+		loader->current = 0;
+	}
+
+	b = &loader->buffer[loader->current];
+	while(!b->ready)
+		pthread_cond_wait(&loader->cond,&loader->lock);
+	pthread_mutex_unlock(&loader->lock);
+
+	return b;
+}
+
+/* Stop the thread and deallocate the loader */
+void loaderDestroy(mlpLoader * loader)
+{
+	int b;
+	if(loader == NULL)
+		return;
+
+	if(loader->started)
+	{
+		pthread_mutex_lock(&loader->lock);
+		loader->quit = 1;
+		pthread_cond_broadcast(&loader->cond);
+		pthread_mutex_unlock(&loader->lock);
+		pthread_join(loader->thread,NULL);
+		pthread_cond_destroy(&loader->cond);
+		pthread_mutex_destroy(&loader->lock);
+	}
+
+	for(b=0; b<2; b++)
+	{
+		free(loader->buffer[b].data);
+		free(loader->buffer[b].x);
+		free(loader->buffer[b].reference);
+		free(loader->buffer[b].idx);
+	}
+	free(loader->perm);
+	free(loader);
+}
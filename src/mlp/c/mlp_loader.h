@@ -0,0 +1,95 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MLP_LOADER_H
+#define _MLP_LOADER_H
+
+#include <pthread.h>
+#include "mlp.h"
+
+/* Alignment (bytes) of the rows of the staging buffers */
+#ifndef MLP_LOADER_ALIGN
+	#define MLP_LOADER_ALIGN 64
+#endif
+
+/* Examples by batch of trainingMLP when compiled with MLP_LOADER */
+#ifndef MLP_LOADER_BATCH
+	#define MLP_LOADER_BATCH 256
+#endif
+
+/* Staging buffer of a batch */
+typedef struct
+{
+	double * data;
+	double ** x;
+	double ** reference;
+	int * idx;
+	int count;
+	int epochEnd;
+	int ready;
+} loaderBuffer;
+
+/* Double-buffered shuffled mini-batch loader.
+ * A background thread shuffles the examples each epoch (Fisher-Yates)
+ * and gathers the next batch in a contiguous aligned buffer while the
+ * current batch is used.
+ */
+typedef struct
+{
+	training * trainingData;
+	int batch;
+	int * perm;
+	int pos;
+	unsigned int seed;
+	loaderBuffer buffer[2];
+	int current;
+	int next;
+	int quit;
+	int started;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} mlpLoader;
+
+/* Create a loader of the examples of 'trainingData'
+ * batch = examples by batch, the last batch of an epoch can be smaller
+ * seed = seed of the shuffle
+ * return NULL in error
+ */
+mlpLoader * loaderCreate(training * trainingData, int batch, \
+unsigned int seed);
+
+/* Next batch: release the previous one and wait the new one.
+ * The rows x[i] and reference[i] (i < count) are the examples idx[i].
+ * The buffer is valid until the next call.
+ */
+loaderBuffer * loaderNext(mlpLoader * loader);
+
+/* Stop the thread and deallocate the loader */
+void loaderDestroy(mlpLoader * loader);
+
+#endif /* _MLP_LOADER_H */
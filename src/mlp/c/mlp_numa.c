@@ -0,0 +1,726 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _GNU_SOURCE
+	#define _GNU_SOURCE
+#endif
+#include "mlp_numa.h"
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef MLP_NUMA_MBIND
+	#include <numaif.h>
+#endif
+
+#define NUMA_SYSFS "/sys/devices/system/node"
+
+/* Parse a list like "0-3,8-11", return the number of elements */
+static int parseList(char * text, int * list, int max)
+{
+	int n = 0;
+	int a;
+	int b;
+	char * c = text;
+	while(*c != '\0' && *c != '\n')
+	{
+		a = (int) strtol(c,&c,10);
+		b = a;
+		if(*c == '-')
+			b = (int) strtol(c+1,&c,10);
+		for(; a<=b; a++)
+		{
+			if(list != NULL && n < max)
+				list[n] = a;
+			n++;
+		}
+		if(*c == ',')
+			c++;
+		else
+			break;
+	}
+
+	return n;
+}
+
+/* Read a list from a file of the sysfs, NULL if it does not exist */
+static int * readList(char * filename, int * n)
+{
+	char text[4096];
+	int * list;
+	FILE * f = fopen(filename,"r");
+	if(f == NULL)
+		return NULL;
+
+	if(fgets(text,sizeof(text),f) == NULL)
+	{
+		fclose(f);
+		return NULL;
+	}
+	fclose(f);
+
+	*n = parseList(text,NULL,0);
+	if(*n < 1)
+		return NULL;
+	list = (int*) malloc(sizeof(int)*(*n));
+	if(list != NULL)
+		parseList(text,list,*n);
+
+	return list;
+}
+
+/* Read the topology */
+int numaTopology(mlpNuma * topo)
+{
+	char filename[256];
+	int * nodes;
+	int n;
+	int i;
+	int c;
+
+	topo->maxcpu = 0;
+	nodes = readList(NUMA_SYSFS "/online",&n);
+	if(nodes == NULL)
+	{
+		/* One node with all processors */
+		n = 1;
+		nodes = (int*) malloc(sizeof(int));
+		if(nodes == NULL)
+			return 1;
+		nodes[0] = 0;
+	}
+
+	topo->nnodes = n;
+	topo->nodeId = nodes;
+	topo->ncpus = (int*) malloc(sizeof(int)*n);
+	topo->cpus = (int**) malloc(sizeof(int*)*n);
+	if(topo->ncpus == NULL || topo->cpus == NULL)
+		return 1;
+
+	for(i=0; i<n; i++)
+	{
+		sprintf(filename,NUMA_SYSFS "/node%d/cpulist",nodes[i]);
+		topo->cpus[i] = readList(filename,&topo->ncpus[i]);
+		if(topo->cpus[i] == NULL)
+		{
+			/* Without sysfs, all processors in the node */
+			topo->ncpus[i] = n == 1 ? mlpThreads() : 0;
+			topo->cpus[i] = (int*) malloc(sizeof(int)*(topo->ncpus[i]+1));
+			if(topo->cpus[i] == NULL)
+				return 1;
+			for(c=0; c<topo->ncpus[i]; c++)
+				topo->cpus[i][c] = c;
+		}
+		for(c=0; c<topo->ncpus[i]; c++)
+		{
+			if(topo->cpus[i][c]+1 > topo->maxcpu)
+				topo->maxcpu = topo->cpus[i][c]+1;
+		}
+	}
+
+	topo->cpuNode = (int*) malloc(sizeof(int)*(topo->maxcpu+1));
+	if(topo->cpuNode == NULL)
+		return 1;
+	for(c=0; c<topo->maxcpu; c++)
+		topo->cpuNode[c] = 0;
+	for(i=0; i<n; i++)
+	{
+		for(c=0; c<topo->ncpus[i]; c++)
+			topo->cpuNode[topo->cpus[i][c]] = i;
+	}
+
+	return 0;
+}
+
+/* Deallocate the topology */
+void numaTopologyFree(mlpNuma * topo)
+{
+	int i;
+	for(i=0; i<topo->nnodes; i++)
+		free(topo->cpus[i]);
+	free(topo->cpus);
+	free(topo->ncpus);
+	free(topo->nodeId);
+	free(topo->cpuNode);
+}
+
+/* Node of the CPU running the calling thread */
+int numaNode(mlpNuma * topo)
+{
+	int cpu = sched_getcpu();
+	if(cpu < 0 || cpu >= topo->maxcpu)
+		return 0;
+
+	return topo->cpuNode[cpu];
+}
+
+/* Bind the calling thread to the CPUs of a node */
+int numaBind(mlpNuma * topo, int node)
+{
+	cpu_set_t set;
+	int c;
+	if(topo->ncpus[node] < 1)
+		return 1;
+
+	CPU_ZERO(&set);
+	for(c=0; c<topo->ncpus[node]; c++)
+		CPU_SET(topo->cpus[node][c],&set);
+
+	return pthread_setaffinity_np(pthread_self(),sizeof(set),&set);
+}
+
+/* First touch from a thread bound to the node */
+typedef struct
+{
+	mlpNuma * topo;
+	int node;
+	void * mem;
+	size_t size;
+} numaTouch;
+
+static void * numaTouchThread(void * varg)
+{
+	numaTouch * t = (numaTouch*) varg;
+	numaBind(t->topo,t->node);
+	memset(t->mem,0,t->size);
+
+	return NULL;
+}
+
+/* Allocate memory placed on a node */
+void * numaAlloc(mlpNuma * topo, size_t size, int node)
+{
+	pthread_t thread;
+	numaTouch t;
+	void * mem;
+
+	if(size == 0)
+		size = 1;
+	mem = mmap(NULL,size,PROT_READ|PROT_WRITE, \
+	MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+	if(mem == MAP_FAILED)
+		return NULL;
+
+#ifdef MLP_NUMA_MBIND
+	unsigned long mask[16];
+	memset(mask,0,sizeof(mask));
+	if(topo->nodeId[node] < (int) (8*sizeof(mask)))
+	{
+		mask[topo->nodeId[node]/(8*sizeof(long))] |= \
+		1UL << (topo->nodeId[node] % (8*sizeof(long)));
+		mbind(mem,size,MPOL_BIND,mask,8*sizeof(mask),0);
+	}
+#endif
+
+	/* The pages belong to the node of the first write */
+	t.topo = topo;
+	t.node = node;
+	t.mem = mem;
+	t.size = size;
+	if(topo->nnodes > 1 && \
+	pthread_create(&thread,NULL,numaTouchThread,&t) == 0)
+		pthread_join(thread,NULL);
+	else
+		memset(mem,0,size);
+
+	return mem;
+}
+
+/* Deallocate memory of numaAlloc */
+void numaFree(void * mem, size_t size)
+{
+	if(mem != NULL)
+		munmap(mem,size == 0 ? 1 : size);
+}
+
+/* Memory Allocation of the Weights on a node */
+double *** weightsAllocNode(mlpNuma * topo, int * neurons, int nlayers, \
+int ninputs, int node)
+{
+	size_t size = sizeof(double)*weightsCount(neurons,nlayers,ninputs);
+	double * data = (double*) numaAlloc(topo,size,node);
+	double *** weights = weightsMap(data,neurons,nlayers,ninputs);
+	if(weights == NULL)
+		numaFree(data,size);
+
+	return weights;
+}
+
+/* Deallocate memory of weightsAllocNode */
+void weightsFreeNode(double *** weights, int * neurons, int nlayers, \
+int ninputs)
+{
+	if(weights == NULL)
+		return;
+
+	numaFree(weights[0][0], \
+	sizeof(double)*weightsCount(neurons,nlayers,ninputs));
+	weightsUnmap(weights,nlayers);
+}
+
+/* Copy weights to a contiguous block */
+static void weightsToBlock(double *** weights, double * block, \
+int * neurons, int nlayers, int ninputs)
+{
+	int layer;
+	int neuron;
+	int nin;
+	for(layer=0; layer<nlayers; layer++)
+	{
+		nin = layer ? neurons[layer-1] : ninputs;
+		for(neuron=0; neuron<neurons[layer]; neuron++)
+		{
+			memcpy(block,weights[layer][neuron],sizeof(double)*(nin+1));
+			block += nin+1;
+		}
+	}
+}
+
+/* Copy a contiguous block to weights */
+static void blockToWeights(double * block, double *** weights, \
+int * neurons, int nlayers, int ninputs)
+{
+	int layer;
+	int neuron;
+	int nin;
+	for(layer=0; layer<nlayers; layer++)
+	{
+		nin = layer ? neurons[layer-1] : ninputs;
+		for(neuron=0; neuron<neurons[layer]; neuron++)
+		{
+			memcpy(weights[layer][neuron],block,sizeof(double)*(nin+1));
+			block += nin+1;
+		}
+	}
+}
+
+/* Create the replicas */
+mlpReplicas * replicasCreate(double *** weights, training * trainingData)
+{
+	int node;
+	mlpReplicas * r = (mlpReplicas*) malloc(sizeof(mlpReplicas));
+	if(r == NULL)
+		return NULL;
+
+	if(numaTopology(&r->topo))
+	{
+		free(r);
+		return NULL;
+	}
+	r->trainingData = trainingData;
+	r->replica = (double****) malloc(sizeof(double***)*r->topo.nnodes);
+	if(r->replica == NULL)
+		return NULL;
+
+	for(node=0; node<r->topo.nnodes; node++)
+	{
+		r->replica[node] = weightsAllocNode(&r->topo, \
+		trainingData->neurons,trainingData->nlayers, \
+		trainingData->ninputs,node);
+		if(r->replica[node] == NULL)
+			return NULL;
+	}
+	replicasUpdate(r,weights);
+
+	return r;
+}
+
+/* Copy 'weights' to all replicas */
+void replicasUpdate(mlpReplicas * r, double *** weights)
+{
+	int node;
+	training * tr = r->trainingData;
+	for(node=0; node<r->topo.nnodes; node++)
+	{
+		weightsToBlock(weights,r->replica[node][0][0], \
+		tr->neurons,tr->nlayers,tr->ninputs);
+	}
+}
+
+/* Replica of the node of the calling thread */
+double *** replicasLocal(mlpReplicas * r)
+{
+	return r->replica[numaNode(&r->topo)];
+}
+
+/* Deallocate the replicas */
+void replicasDestroy(mlpReplicas * r)
+{
+	int node;
+	training * tr = r->trainingData;
+	for(node=0; node<r->topo.nnodes; node++)
+	{
+		weightsFreeNode(r->replica[node],tr->neurons,tr->nlayers, \
+		tr->ninputs);
+	}
+	free(r->replica);
+	numaTopologyFree(&r->topo);
+	free(r);
+}
+
+/* Shared state of the NUMA training */
+typedef struct
+{
+	mlpNuma topo;
+	mlpPool * pool;
+	training * tr;
+	int actv;
+	int batch;
+	long int count;
+	int * threadNode;
+	int * nodeRank;
+	int * nodeThreads;
+	unsigned int * seeds;
+	double * master;
+	double * delta;
+	double **** replica;
+	double **** step;
+	double ** nodeStep;
+	double * sse;
+	int * counts;
+	int stop;
+	/* A thread could not allocate its memory */
+	atomic_int failed;
+	double mse;
+	long int counter;
+	double * mse_hist;
+	long int mse_counter;
+} numaTrain;
+
+/* Range of the weights for a rank among 'n' threads */
+static void numaRange(long int count, int rank, int n, \
+long int * begin, long int * end)
+{
+	*begin = count*rank/n;
+	*end = count*(rank+1)/n;
+}
+
+/* Thread of the NUMA training */
+static void numaTrainTask(void * varg, int id, int nthreads)
+{
+	numaTrain * nt = (numaTrain*) varg;
+	training * tr = nt->tr;
+	int nlayers = tr->nlayers;
+	int * neurons = tr->neurons;
+	int ninputs = tr->ninputs;
+	int outs = neurons[nlayers-1];
+	int node = nt->threadNode[id];
+	int rank = nt->nodeRank[id];
+	int nnode = nt->nodeThreads[node];
+	int first = tr->examples*id/nthreads;
+	int shard = tr->examples*(id+1)/nthreads - first;
+	int maxShard = (tr->examples + nthreads - 1)/nthreads;
+	int perThread = (nt->batch + nthreads - 1)/nthreads;
+	int stepsEpoch = (maxShard + perThread - 1)/perThread;
+	unsigned int seed = nt->seeds[id];
+
+	int i;
+	int j;
+	int e;
+	int t;
+	int n;
+	int sw;
+	int pos;
+	int total;
+	int width = ninputs;
+	long int k;
+	long int begin;
+	long int end;
+	double g;
+
+	numaBind(&nt->topo,node);
+
+	/* Shard of the examples in memory of the node */
+	size_t xsize = sizeof(double)*(shard*(ninputs+outs)+1);
+	double * xs = (double*) numaAlloc(&nt->topo,xsize,node);
+	double * refs = xs + shard*ninputs;
+
+	/* Scratch, touched by this thread */
+	int * xidx = (int*) malloc(sizeof(int)*(shard+1));
+	for(i=0; i<nlayers; i++)
+	{
+		if(neurons[i] > width)
+			width = neurons[i];
+	}
+	double * gs = (double*) malloc(sizeof(double)*width);
+	double * gsPrev = (double*) malloc(sizeof(double)*width);
+	double ** yout = (double**) calloc(nlayers,sizeof(double*));
+	int ok = xs != NULL && xidx != NULL && gs != NULL && gsPrev != NULL && \
+	yout != NULL;
+	for(i=0; i<nlayers && ok; i++)
+	{
+		yout[i] = (double*) malloc(sizeof(double)*width);
+		ok = yout[i] != NULL;
+	}
+
+	if(ok)
+	{
+		for(e=0; e<shard; e++)
+		{
+			memcpy(xs + e*ninputs,tr->x[first+e],sizeof(double)*ninputs);
+			memcpy(refs + e*outs,tr->reference[first+e], \
+			sizeof(double)*outs);
+			xidx[e] = e;
+		}
+	}
+	else
+		atomic_store(&nt->failed,1);
+
+	/* All threads stop if one of them has no memory */
+	poolBarrier(nt->pool);
+	while(!atomic_load(&nt->failed))
+	{
+		for(j=0; j<stepsEpoch; j++)
+		{
+			/* Shuffle the shard, Fisher-Yates */
+			if(j == 0)
+			{
+				for(e=shard-1; e>0; e--)
+				{
+					i = rand_r(&seed) % (e+1);
+					sw = xidx[e];
+					xidx[e] = xidx[i];
+					xidx[i] = sw;
+				}
+			}
+
+			pos = j*perThread;
+			n = shard - pos;
+			if(n > perThread)
+				n = perThread;
+			for(e=0; e<n; e++)
+			{
+				i = xidx[pos+e];
+				nt->sse[id] += exampleAccumulate(nt->replica[node], \
+				nt->step[id],tr,nt->actv,xs + i*ninputs, \
+				refs + i*outs,yout,gs,gsPrev);
+			}
+			nt->counts[id] = n > 0 ? n : 0;
+			poolBarrier(nt->pool);
+
+			/* Reduction inside the node */
+			numaRange(nt->count,rank,nnode,&begin,&end);
+			for(k=begin; k<end; k++)
+			{
+				g = 0;
+				for(t=0; t<nthreads; t++)
+				{
+					if(nt->threadNode[t] == node)
+					{
+						g += nt->step[t][0][0][k];
+						nt->step[t][0][0][k] = 0;
+					}
+				}
+				nt->nodeStep[node][k] = g;
+			}
+			poolBarrier(nt->pool);
+
+			/* Reduction among nodes and update */
+			total = 0;
+			for(t=0; t<nthreads; t++)
+				total += nt->counts[t];
+			numaRange(nt->count,id,nthreads,&begin,&end);
+			for(k=begin; k<end && total>0; k++)
+			{
+				g = 0;
+				for(t=0; t<nt->topo.nnodes; t++)
+					g += nt->nodeStep[t][k];
+				nt->delta[k] = tr->lrate*g/total + tr->alpha*nt->delta[k];
+				nt->master[k] += nt->delta[k];
+			}
+			poolBarrier(nt->pool);
+
+			/* Stopping criterion */
+			if(id == 0)
+			{
+				nt->counter += total;
+				if(j == stepsEpoch-1)
+				{
+					nt->mse = 0;
+					for(t=0; t<nthreads; t++)
+					{
+						nt->mse += nt->sse[t];
+						nt->sse[t] = 0;
+					}
+					nt->mse /= tr->examples;
+					nt->mse_hist[nt->mse_counter] = nt->mse;
+					nt->mse_counter += 1;
+				}
+				if(nt->mse <= tr->acceptedError || \
+				nt->counter >= tr->maxIteration)
+					nt->stop = 1;
+			}
+
+			/* Refresh the replica of the node */
+			numaRange(nt->count,rank,nnode,&begin,&end);
+			memcpy(nt->replica[node][0][0]+begin,nt->master+begin, \
+			sizeof(double)*(end-begin));
+			poolBarrier(nt->pool);
+
+			if(nt->stop)
+				break;
+		}
+		if(nt->stop)
+			break;
+	}
+
+	numaFree(xs,xsize);
+	free(xidx);
+	free(gs);
+	free(gsPrev);
+	if(yout != NULL)
+	{
+		for(i=0; i<nlayers; i++)
+			free(yout[i]);
+	}
+	free(yout);
+}
+
+/* MLP Data-Parallel Training by NUMA node */
+double * trainingMLPNuma(double *** weights, training * trainingData, \
+char * activation, int nthreads, int batch)
+{
+	int nlayers = trainingData->nlayers;
+	int * neurons = trainingData->neurons;
+	int ninputs = trainingData->ninputs;
+	int t;
+	int n;
+	numaTrain nt;
+
+	if(nthreads <= 0)
+		nthreads = mlpThreads();
+	if(nthreads > trainingData->examples)
+		nthreads = trainingData->examples;
+	if(batch < 1)
+		batch = 1;
+
+	if(numaTopology(&nt.topo))
+		return NULL;
+	nt.tr = trainingData;
+	nt.actv = getActv(activation);
+	nt.batch = batch;
+	nt.count = weightsCount(neurons,nlayers,ninputs);
+	nt.stop = 0;
+	atomic_init(&nt.failed,0);
+	nt.mse = trainingData->acceptedError+1;
+	nt.counter = 0;
+	nt.mse_counter = 1;
+	/* The position 0 of mse_hist is the last position of history */
+	nt.mse_hist = (double*) malloc(sizeof(double)* \
+	(trainingData->maxIteration/trainingData->examples+2));
+	nt.threadNode = (int*) malloc(sizeof(int)*nthreads);
+	nt.nodeRank = (int*) malloc(sizeof(int)*nthreads);
+	nt.nodeThreads = (int*) calloc(nt.topo.nnodes,sizeof(int));
+	nt.seeds = (unsigned int*) malloc(sizeof(unsigned int)*nthreads);
+	nt.sse = (double*) calloc(nthreads,sizeof(double));
+	nt.counts = (int*) calloc(nthreads,sizeof(int));
+	nt.step = (double****) malloc(sizeof(double***)*nthreads);
+	nt.replica = (double****) malloc(sizeof(double***)*nt.topo.nnodes);
+	nt.nodeStep = (double**) malloc(sizeof(double*)*nt.topo.nnodes);
+	if(nt.mse_hist == NULL || nt.threadNode == NULL || \
+	nt.nodeRank == NULL || nt.nodeThreads == NULL || nt.seeds == NULL || \
+	nt.sse == NULL || nt.counts == NULL || nt.step == NULL || \
+	nt.replica == NULL || nt.nodeStep == NULL)
+		return NULL;
+
+	/* Threads spread over the nodes, contiguous by node */
+	for(t=0; t<nthreads; t++)
+	{
+		nt.threadNode[t] = t*nt.topo.nnodes/nthreads;
+		nt.nodeRank[t] = nt.nodeThreads[nt.threadNode[t]];
+		nt.nodeThreads[nt.threadNode[t]] += 1;
+		nt.seeds[t] = rand();
+	}
+
+	/* Master weights and momentum in node 0, replicas and updates by node */
+	nt.master = (double*) numaAlloc(&nt.topo,sizeof(double)*nt.count,0);
+	nt.delta = (double*) numaAlloc(&nt.topo,sizeof(double)*nt.count,0);
+	if(nt.master == NULL || nt.delta == NULL)
+		return NULL;
+	weightsToBlock(weights,nt.master,neurons,nlayers,ninputs);
+	for(n=0; n<nt.topo.nnodes; n++)
+	{
+		nt.replica[n] = weightsAllocNode(&nt.topo,neurons,nlayers, \
+		ninputs,n);
+		nt.nodeStep[n] = (double*) \
+		numaAlloc(&nt.topo,sizeof(double)*nt.count,n);
+		if(nt.replica[n] == NULL || nt.nodeStep[n] == NULL)
+			return NULL;
+		memcpy(nt.replica[n][0][0],nt.master,sizeof(double)*nt.count);
+	}
+	for(t=0; t<nthreads; t++)
+	{
+		nt.step[t] = weightsAllocNode(&nt.topo,neurons,nlayers,ninputs, \
+		nt.threadNode[t]);
+		if(nt.step[t] == NULL)
+			return NULL;
+	}
+
+	nt.pool = poolCreate(nthreads);
+	if(nt.pool == NULL)
+		return NULL;
+	poolRun(nt.pool,numaTrainTask,&nt);
+	poolDestroy(nt.pool);
+
+	if(atomic_load(&nt.failed))
+	{
+		/* The weights are not changed */
+		free(nt.mse_hist);
+		nt.mse_hist = NULL;
+	}
+	else
+	{
+		blockToWeights(nt.master,weights,neurons,nlayers,ninputs);
+
+		/* Add in the position '0' the 'mse_counter'-1 
+		 * to identify the last position of history
+		 */
+		nt.mse_hist[0] = nt.mse_counter-1;
+	}
+
+	for(t=0; t<nthreads; t++)
+		weightsFreeNode(nt.step[t],neurons,nlayers,ninputs);
+	for(n=0; n<nt.topo.nnodes; n++)
+	{
+		weightsFreeNode(nt.replica[n],neurons,nlayers,ninputs);
+		numaFree(nt.nodeStep[n],sizeof(double)*nt.count);
+	}
+	numaFree(nt.master,sizeof(double)*nt.count);
+	numaFree(nt.delta,sizeof(double)*nt.count);
+	free(nt.threadNode);
+	free(nt.nodeRank);
+	free(nt.nodeThreads);
+	free(nt.seeds);
+	free(nt.sse);
+	free(nt.counts);
+	free(nt.step);
+	free(nt.replica);
+	free(nt.nodeStep);
+	numaTopologyFree(&nt.topo);
+
+	return nt.mse_hist;
+}
@@ -0,0 +1,115 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MLP_NUMA_H
+#define _MLP_NUMA_H
+
+#include "mlp.h"
+#include "mlp_thread.h"
+
+/* Memory placement by NUMA node.
+ * The topology is read from "/sys/devices/system/node", without it
+ * the machine is one node. Memory is placed by first touch from a
+ * thread bound to the node, define MLP_NUMA_MBIND and link with -lnuma
+ * to also bind the pages with mbind.
+ */
+
+/* NUMA topology */
+typedef struct
+{
+	int nnodes;
+	int * nodeId;
+	int * ncpus;
+	int ** cpus;
+	int maxcpu;
+	int * cpuNode;
+} mlpNuma;
+
+/* Read the topology, return 1 in memory error */
+int numaTopology(mlpNuma * topo);
+
+/* Deallocate the topology */
+void numaTopologyFree(mlpNuma * topo);
+
+/* Node of the CPU running the calling thread */
+int numaNode(mlpNuma * topo);
+
+/* Bind the calling thread to the CPUs of a node, return 0 on success */
+int numaBind(mlpNuma * topo, int node);
+
+/* Allocate 'size' bytes placed on a node, page aligned, NULL in error */
+void * numaAlloc(mlpNuma * topo, size_t size, int node);
+
+/* Deallocate memory of numaAlloc */
+void numaFree(void * mem, size_t size);
+
+/* Memory Allocation of the Weights on a node, see weightsMap */
+double *** weightsAllocNode(mlpNuma * topo, int * neurons, int nlayers, \
+int ninputs, int node);
+
+/* Deallocate memory of weightsAllocNode */
+void weightsFreeNode(double *** weights, int * neurons, int nlayers, \
+int ninputs);
+
+/* Read-only replicas of the weights, one by node, for inference */
+typedef struct
+{
+	mlpNuma topo;
+	training * trainingData;
+	double **** replica;
+} mlpReplicas;
+
+/* Create the replicas of 'weights', NULL in memory error */
+mlpReplicas * replicasCreate(double *** weights, training * trainingData);
+
+/* Copy 'weights' to all replicas, after training */
+void replicasUpdate(mlpReplicas * r, double *** weights);
+
+/* Replica of the node of the calling thread */
+double *** replicasLocal(mlpReplicas * r);
+
+/* Deallocate the replicas */
+void replicasDestroy(mlpReplicas * r);
+
+/* MLP Data-Parallel Training by NUMA node
+ * The threads are bound to the nodes and each one trains a shard of the
+ * examples copied to its node, with the replica of the weights of the
+ * node. The updates of a mini-batch are reduced first inside each node
+ * and then among nodes, applied like layerApply, and the replicas are
+ * refreshed by the threads of each node.
+ *
+ * weights = layers X neurons X weights
+ * trainingData = same of trainingMLP
+ * nthreads = number of threads, <= 0 uses all online processors
+ * batch = examples by mini-batch (all threads)
+ * return History of MSE, the position 0 is the size of history, NULL in
+ * memory error (the weights are not changed)
+ */
+double * trainingMLPNuma(double *** weights, training * trainingData, \
+char * activation, int nthreads, int batch);
+
+#endif /* _MLP_NUMA_H */
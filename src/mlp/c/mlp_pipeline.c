@@ -0,0 +1,560 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mlp_pipeline.h"
+#include <stdatomic.h>
+#include <sched.h>
+
+/* Lock-free single-producer single-consumer queue of micro-batches.
+ * Each slot keeps 'count' rows of 'width' doubles, the index of the
+ * examples and the stop flag carried backward.
+ */
+typedef struct
+{
+	int capacity;
+	int micro;
+	int width;
+	double * data;
+	int * idx;
+	int * count;
+	int * stop;
+	atomic_long head;
+	atomic_long tail;
+} spscQueue;
+
+/* Queue initialization, return 1 in memory error */
+static int queueInit(spscQueue * q, int capacity, int micro, int width)
+{
+	q->capacity = capacity;
+	q->micro = micro;
+	q->width = width;
+	q->data = (double*) malloc(sizeof(double)*capacity*micro*width);
+	q->idx = (int*) malloc(sizeof(int)*capacity*micro);
+	q->count = (int*) malloc(sizeof(int)*capacity);
+	q->stop = (int*) malloc(sizeof(int)*capacity);
+	atomic_init(&q->head,0);
+	atomic_init(&q->tail,0);
+	if(q->data == NULL || q->idx == NULL || \
+	q->count == NULL || q->stop == NULL)
+		return 1;
+
+	return 0;
+}
+
+static void queueFree(spscQueue * q)
+{
+	free(q->data);
+	free(q->idx);
+	free(q->count);
+	free(q->stop);
+}
+
+/* Producer: wait a free slot and return its position */
+static int queueWriteSlot(spscQueue * q)
+{
+	long int tail = atomic_load_explicit(&q->tail,memory_order_relaxed);
+	while(tail - atomic_load_explicit(&q->head,memory_order_acquire) \
+	>= q->capacity)
+		sched_yield();
+
+	return (int) (tail % q->capacity);
+}
+
+/* Producer: publish the slot written */
+static void queuePush(spscQueue * q)
+{
+	long int tail = atomic_load_explicit(&q->tail,memory_order_relaxed);
+	atomic_store_explicit(&q->tail,tail+1,memory_order_release);
+}
+
+/* Consumer: wait a filled slot and return its position */
+static int queueReadSlot(spscQueue * q)
+{
+	long int head = atomic_load_explicit(&q->head,memory_order_relaxed);
+	while(atomic_load_explicit(&q->tail,memory_order_acquire) == head)
+		sched_yield();
+
+	return (int) (head % q->capacity);
+}
+
+/* Consumer: release the slot read */
+static void queuePop(spscQueue * q)
+{
+	long int head = atomic_load_explicit(&q->head,memory_order_relaxed);
+	atomic_store_explicit(&q->head,head+1,memory_order_release);
+}
+
+/* Shared state of the pipeline */
+typedef struct
+{
+	double *** weights;
+	double *** step;
+	double *** delta;
+	training * tr;
+	int actv;
+	int stages;
+	int micro;
+	int nmicro;
+	int * first;
+	int * last;
+	spscQueue * fwd;
+	spscQueue * bwd;
+	int * xidx;
+	double * mse_hist;
+	long int mse_counter;
+	mlpPool * pool;
+	/* A stage could not allocate its memory */
+	atomic_int failed;
+} pipeline;
+
+/* Number of inputs of a layer */
+static int layerInputs(training * tr, int layer)
+{
+	return layer ? tr->neurons[layer-1] : tr->ninputs;
+}
+
+/* Split the layers among the stages, balanced by number of weights */
+static void pipelinePartition(training * tr, int stages, \
+int * first, int * last)
+{
+	int l = 0;
+	int s;
+	double remaining = 0;
+	double target;
+	double acc;
+	double cost;
+
+	for(s=0; s<tr->nlayers; s++)
+		remaining += (double) tr->neurons[s]*(layerInputs(tr,s)+1);
+
+	for(s=0; s<stages; s++)
+	{
+		first[s] = l;
+		target = remaining/(stages-s);
+		acc = 0;
+		/* At least one layer, and one layer for each next stage */
+		while(l < tr->nlayers-(stages-1-s))
+		{
+			cost = (double) tr->neurons[l]*(layerInputs(tr,l)+1);
+			if(acc > 0 && acc + cost/2 > target)
+				break;
+			acc += cost;
+			l++;
+		}
+		last[s] = l-1;
+		remaining -= acc;
+	}
+}
+
+/* Micro-batches in the mini-batch starting at example 'pos' */
+static int pipelineMicros(pipeline * pl, int pos)
+{
+	int n = pl->tr->examples - pos;
+	if(n > pl->micro*pl->nmicro)
+		n = pl->micro*pl->nmicro;
+
+	return (n + pl->micro - 1) / pl->micro;
+}
+
+/* Thread of a stage */
+static void stageTask(void * varg, int s, int nthreads)
+{
+	pipeline * pl = (pipeline*) varg;
+	training * tr = pl->tr;
+	int * neurons = tr->neurons;
+	int first = pl->first[s];
+	int last = pl->last[s];
+	int nin = layerInputs(tr,first);
+	int nout = neurons[last];
+	int S = pl->stages;
+	int micro = pl->micro;
+	int slots = pl->nmicro < S-s ? pl->nmicro : S-s;
+	spscQueue * in = s ? &pl->fwd[s-1] : NULL;
+	spscQueue * out = s < S-1 ? &pl->fwd[s] : NULL;
+	spscQueue * gin = s < S-1 ? &pl->bwd[s] : NULL;
+	spscQueue * gout = s ? &pl->bwd[s-1] : NULL;
+
+	int l;
+	int e;
+	int m;
+	int f;
+	int b;
+	int q;
+	int slot;
+	int warm;
+	int nm;
+	int maxw = nin;
+	int * off;
+	int rowWidth = 0;
+	double ** stash;
+	int ** sidx;
+	int * scount;
+	double * gs;
+	double * gsPrev;
+	double * sw;
+	double * tmp;
+	double * row;
+
+	/* Stash: for each slot and example, the input and the outputs */
+	off = (int*) malloc(sizeof(int)*(last-first+2));
+	for(l=first; l<=last; l++)
+	{
+		if(neurons[l] > maxw)
+			maxw = neurons[l];
+	}
+	if(off != NULL)
+	{
+		off[0] = 0;
+		for(l=first; l<=last; l++)
+			off[l-first+1] = off[l-first] + layerInputs(tr,l);
+		rowWidth = off[last-first+1] + nout;
+	}
+	stash = (double**) calloc(slots,sizeof(double*));
+	sidx = (int**) calloc(slots,sizeof(int*));
+	scount = (int*) malloc(sizeof(int)*slots);
+	gs = (double*) malloc(sizeof(double)*maxw);
+	gsPrev = (double*) malloc(sizeof(double)*maxw);
+	int ok = off != NULL && stash != NULL && sidx != NULL && \
+	scount != NULL && gs != NULL && gsPrev != NULL;
+	for(slot=0; slot<slots && ok; slot++)
+	{
+		stash[slot] = (double*) malloc(sizeof(double)*micro*rowWidth);
+		sidx[slot] = (int*) malloc(sizeof(int)*micro);
+		ok = stash[slot] != NULL && sidx[slot] != NULL;
+	}
+	if(!ok)
+		atomic_store(&pl->failed,1);
+
+	long int counter = 0;
+	int stop = 0;
+	int pos = 0;
+	double sse = 0;
+	long int displayed = 0;
+	long int displayStep = ceil(0.05*tr->maxIteration);
+	double mse = tr->acceptedError+1;
+	(void) nthreads;
+
+	/* All stages stop if one of them has no memory */
+	poolBarrier(pl->pool);
+	if(atomic_load(&pl->failed))
+		stop = 1;
+
+	while(!stop)
+	{
+		/* New epoch */
+		if(pos == 0 && s == 0)
+			vperm(pl->xidx,tr->examples);
+
+		nm = pipelineMicros(pl,pos);
+		warm = S-s-1 < nm ? S-s-1 : nm;
+		f = 0;
+		b = 0;
+		int count = 0;
+		/* 1F1B schedule, q = 0 forward and q = 1 backward */
+		while(b < nm)
+		{
+			if(f < warm || (f < nm && f == b+warm))
+				q = 0;
+			else
+				q = 1;
+
+			if(q == 0)
+			{
+				/* Forward of micro-batch f */
+				m = f++;
+				slot = m % slots;
+				if(s == 0)
+				{
+					scount[slot] = tr->examples - (pos + m*micro);
+					if(scount[slot] > micro)
+						scount[slot] = micro;
+					for(e=0; e<scount[slot]; e++)
+					{
+						sidx[slot][e] = pl->xidx[pos + m*micro + e];
+						memcpy(stash[slot] + e*rowWidth, \
+						tr->x[sidx[slot][e]],sizeof(double)*nin);
+					}
+				}
+				else
+				{
+					int r = queueReadSlot(in);
+					scount[slot] = in->count[r];
+					for(e=0; e<scount[slot]; e++)
+					{
+						sidx[slot][e] = in->idx[r*micro + e];
+						memcpy(stash[slot] + e*rowWidth, \
+						in->data + (r*micro + e)*nin,sizeof(double)*nin);
+					}
+					queuePop(in);
+				}
+
+				for(e=0; e<scount[slot]; e++)
+				{
+					row = stash[slot] + e*rowWidth;
+					for(l=first; l<=last; l++)
+					{
+						neuronsOut(row + off[l-first+1],tr->bias[l], \
+						row + off[l-first],layerInputs(tr,l), \
+						pl->weights[l],0,neurons[l],pl->actv);
+					}
+				}
+
+				if(out != NULL)
+				{
+					int w = queueWriteSlot(out);
+					out->count[w] = scount[slot];
+					for(e=0; e<scount[slot]; e++)
+					{
+						out->idx[w*micro + e] = sidx[slot][e];
+						memcpy(out->data + (w*micro + e)*nout, \
+						stash[slot] + e*rowWidth + off[last-first+1], \
+						sizeof(double)*nout);
+					}
+					queuePush(out);
+				}
+			}
+			else
+			{
+				/* Backward of micro-batch b */
+				m = b++;
+				slot = m % slots;
+				int r = 0;
+				int w = 0;
+				if(gin != NULL)
+				{
+					r = queueReadSlot(gin);
+					stop = gin->stop[r];
+				}
+				if(gout != NULL)
+					w = queueWriteSlot(gout);
+
+				for(e=0; e<scount[slot]; e++)
+				{
+					row = stash[slot] + e*rowWidth;
+					sw = row + off[last-first+1];
+					if(gin == NULL)
+					{
+						/* Last stage, error of the example */
+						double serror = 0;
+						int o;
+						for(o=0; o<nout; o++)
+						{
+							double d = tr->reference[sidx[slot][e]][o] - sw[o];
+							serror += d*d;
+						}
+						sse += serror/nout;
+						outputGradient(gs,tr->reference[sidx[slot][e]], \
+						sw,nout,pl->actv);
+					}
+					else
+					{
+						memcpy(gs,gin->data + (r*micro + e)*nout, \
+						sizeof(double)*nout);
+					}
+
+					for(l=last; l>=first; l--)
+					{
+						layerAccumulate(pl->step[l],gs,tr->bias[l], \
+						row + off[l-first],layerInputs(tr,l),neurons[l]);
+						if(l > first)
+						{
+							layerBackward(gsPrev,pl->weights[l],gs, \
+							row + off[l-first],neurons[l-1],neurons[l], \
+							pl->actv);
+							tmp = gs;
+							gs = gsPrev;
+							gsPrev = tmp;
+						}
+						else if(gout != NULL)
+						{
+							layerBackward(gout->data + (w*micro + e)*gout->width, \
+							pl->weights[l],gs,row,nin,neurons[l],pl->actv);
+						}
+					}
+				}
+				count += scount[slot];
+
+				if(gin != NULL)
+					queuePop(gin);
+
+				/* Last stage decides the stop at the end of the mini-batch */
+				if(gin == NULL && b == nm)
+				{
+					counter += count;
+					if(pos + count == tr->examples)
+					{
+						mse = sse/tr->examples;
+						sse = 0;
+						pl->mse_hist[pl->mse_counter] = mse;
+						pl->mse_counter += 1;
+#ifdef DEBUG_MODE
+						if(counter/displayStep > displayed)
+						{
+							displayed = counter/displayStep;
+							printf("%.2f%% of maximum iteration.\n", \
+							(float) (counter*100)/tr->maxIteration);
+							printf("MSE: %.4e\n",mse);
+						}
+#endif
+					}
+					if(mse <= tr->acceptedError || \
+					counter >= tr->maxIteration)
+						stop = 1;
+				}
+
+				if(gout != NULL)
+				{
+					gout->count[w] = scount[slot];
+					gout->stop[w] = stop;
+					queuePush(gout);
+				}
+			}
+		}
+
+		/* Flush: update the layers of this stage */
+		for(l=first; l<=last; l++)
+		{
+			layerApply(pl->weights[l],pl->delta[l],pl->step[l], \
+			tr->lrate,tr->alpha,count,layerInputs(tr,l),neurons[l]);
+		}
+
+		pos += count;
+		if(pos == tr->examples)
+			pos = 0;
+	}
+
+	for(slot=0; slot<slots; slot++)
+	{
+		if(stash != NULL)
+			free(stash[slot]);
+		if(sidx != NULL)
+			free(sidx[slot]);
+	}
+	free(stash);
+	free(sidx);
+	free(scount);
+	free(off);
+	free(gs);
+	free(gsPrev);
+}
+
+/* MLP Pipeline-Parallel Training */
+double * trainingMLPPipeline(double *** weights, training * trainingData, \
+char * activation, int stages, int micro, int nmicro)
+{
+	int nlayers = trainingData->nlayers;
+	int * neurons = trainingData->neurons;
+	int ninputs = trainingData->ninputs;
+	int examples = trainingData->examples;
+	int i;
+	pipeline pl;
+
+	if(stages > nlayers)
+		stages = nlayers;
+	if(stages < 1)
+		stages = 1;
+	if(micro < 1)
+		micro = 1;
+	if(nmicro < 1)
+		nmicro = 1;
+
+	pl.weights = weights;
+	pl.tr = trainingData;
+	pl.actv = getActv(activation);
+	pl.stages = stages;
+	pl.micro = micro;
+	pl.nmicro = nmicro;
+	pl.step = weightsAlloc(neurons,nlayers,ninputs);
+	pl.delta = weightsAlloc(neurons,nlayers,ninputs);
+	pl.first = (int*) malloc(sizeof(int)*stages);
+	pl.last = (int*) malloc(sizeof(int)*stages);
+	/* Zeroed queues are freed even if not initialized */
+	pl.fwd = (spscQueue*) calloc(stages,sizeof(spscQueue));
+	pl.bwd = (spscQueue*) calloc(stages,sizeof(spscQueue));
+	pl.xidx = (int*) malloc(sizeof(int)*examples);
+	/* The position 0 of mse_hist is the last position of history */
+	pl.mse_hist = (double*) \
+	malloc(sizeof(double)*(trainingData->maxIteration/examples+2));
+	pl.mse_counter = 1;
+	pl.pool = NULL;
+	atomic_init(&pl.failed,0);
+	int ok = pl.step != NULL && pl.delta != NULL && pl.first != NULL && \
+	pl.last != NULL && pl.fwd != NULL && pl.bwd != NULL && \
+	pl.xidx != NULL && pl.mse_hist != NULL;
+
+	if(ok)
+	{
+		weightsZero(pl.step,neurons,nlayers,ninputs);
+		weightsZero(pl.delta,neurons,nlayers,ninputs);
+		for(i=0; i<examples; i++)
+			pl.xidx[i] = i;
+
+		pipelinePartition(trainingData,stages,pl.first,pl.last);
+		for(i=0; i<stages-1 && ok; i++)
+		{
+			ok = !queueInit(&pl.fwd[i],nmicro,micro,neurons[pl.last[i]]) && \
+			!queueInit(&pl.bwd[i],nmicro,micro,neurons[pl.last[i]]);
+		}
+	}
+
+	if(ok)
+		pl.pool = poolCreate(stages);
+	if(pl.pool != NULL)
+	{
+		poolRun(pl.pool,stageTask,&pl);
+		poolDestroy(pl.pool);
+	}
+
+	if(pl.pool == NULL || atomic_load(&pl.failed))
+	{
+		/* Memory error, the weights are not changed */
+		free(pl.mse_hist);
+		pl.mse_hist = NULL;
+	}
+	else
+	{
+		/* Add in the position '0' the 'mse_counter'-1 
+		 * to identify the last position of history
+		 */
+		pl.mse_hist[0] = pl.mse_counter-1;
+	}
+
+	for(i=0; i<stages-1 && pl.fwd != NULL && pl.bwd != NULL; i++)
+	{
+		queueFree(&pl.fwd[i]);
+		queueFree(&pl.bwd[i]);
+	}
+	weightsFree(pl.step,neurons,nlayers);
+	weightsFree(pl.delta,neurons,nlayers);
+	free(pl.first);
+	free(pl.last);
+	free(pl.fwd);
+	free(pl.bwd);
+	free(pl.xidx);
+
+	return pl.mse_hist;
+}
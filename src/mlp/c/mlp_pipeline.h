@@ -0,0 +1,55 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MLP_PIPELINE_H
+#define _MLP_PIPELINE_H
+
+#include "mlp.h"
+#include "mlp_thread.h"
+
+/* MLP Pipeline-Parallel Training
+ * Each thread (stage) owns a contiguous range of layers, balanced by
+ * the number of weights. Micro-batches flow forward and local gradients
+ * flow backward between stages through lock-free single-producer
+ * single-consumer queues with a 1F1B schedule: after a warm-up of
+ * forwards, each stage alternates one forward and one backward, so a
+ * stage keeps at most (stages - stage) micro-batches in memory.
+ * The update is applied when all micro-batches of a mini-batch went
+ * back (flush), like layerApply, then it matches mini-batch training.
+ *
+ * weights = layers X neurons X weights
+ * trainingData = same of trainingMLP
+ * stages = number of threads, limited by the number of layers
+ * micro = examples by micro-batch
+ * nmicro = micro-batches by mini-batch
+ * return History of MSE, the position 0 is the size of history,
+ *   NULL in memory error (the weights are not changed)
+ */
+double * trainingMLPPipeline(double *** weights, training * trainingData, \
+char * activation, int stages, int micro, int nmicro);
+
+#endif /* _MLP_PIPELINE_H */
@@ -0,0 +1,507 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mlp_prune.h"
+
+/* Order of absolute values for qsort */
+static int absCompare(const void * a, const void * b)
+{
+	double x = fabs(*(const double*) a);
+	double y = fabs(*(const double*) b);
+	return (x > y) - (x < y);
+}
+
+/* Magnitude pruning by layer */
+long int pruneMagnitude(double *** weights, training * trainingData, \
+double sparsity)
+{
+	int nlayers = trainingData->nlayers;
+	int * neurons = trainingData->neurons;
+	int layer;
+	int neuron;
+	int nin;
+	int w;
+	long int n;
+	long int k;
+	long int cut;
+	long int zeros = 0;
+	double threshold;
+	double * values;
+
+	if(sparsity < 0.0)
+		sparsity = 0.0;
+	if(sparsity > 1.0)
+		sparsity = 1.0;
+
+	for(layer=0; layer<nlayers; layer++)
+	{
+		nin = layer ? neurons[layer-1] : trainingData->ninputs;
+		n = (long int) neurons[layer]*nin;
+		cut = (long int) (sparsity*n);
+		if(cut > 0)
+		{
+			values = (double*) malloc(sizeof(double)*n);
+			if(values == NULL)
+				return -1;
+
+			k = 0;
+			for(neuron=0; neuron<neurons[layer]; neuron++)
+			{
+				for(w=1; w<=nin; w++)
+					values[k++] = weights[layer][neuron][w];
+			}
+			qsort(values,n,sizeof(double),absCompare);
+			threshold = fabs(values[cut-1]);
+			free(values);
+
+			/* Zero up to 'cut' weights with |w| <= threshold */
+			k = 0;
+			for(neuron=0; neuron<neurons[layer]; neuron++)
+			{
+				for(w=1; w<=nin; w++)
+				{
+					if(fabs(weights[layer][neuron][w]) < threshold)
+					{
+						weights[layer][neuron][w] = 0.0;
+						k++;
+					}
+				}
+			}
+			for(neuron=0; neuron<neurons[layer] && k<cut; neuron++)
+			{
+				for(w=1; w<=nin && k<cut; w++)
+				{
+					if(weights[layer][neuron][w] != 0.0 && \
+					fabs(weights[layer][neuron][w]) == threshold)
+					{
+						weights[layer][neuron][w] = 0.0;
+						k++;
+					}
+				}
+			}
+		}
+
+		for(neuron=0; neuron<neurons[layer]; neuron++)
+		{
+			for(w=1; w<=nin; w++)
+				zeros += weights[layer][neuron][w] == 0.0;
+		}
+	}
+
+	return zeros;
+}
+
+/* Mask of the nonzero weights, the weights of the bias are kept */
+static void pruneMask(double *** weights, double *** mask, \
+training * trainingData)
+{
+	int layer;
+	int neuron;
+	int nin;
+	int w;
+	for(layer=0; layer<trainingData->nlayers; layer++)
+	{
+		nin = layer ? trainingData->neurons[layer-1] : \
+		trainingData->ninputs;
+		for(neuron=0; neuron<trainingData->neurons[layer]; neuron++)
+		{
+			mask[layer][neuron][0] = 1.0;
+			for(w=1; w<=nin; w++)
+				mask[layer][neuron][w] = \
+				weights[layer][neuron][w] != 0.0 ? 1.0 : 0.0;
+		}
+	}
+}
+
+/* Iterative pruning */
+double * trainingMLPPrune(double *** weights, training * trainingData, \
+char * activation, double sparsity, int rounds)
+{
+	int round;
+	double * hist = NULL;
+	double * mse_hist = NULL;
+	double *** mask;
+	mlpWorkspace * ws = workspaceCreate(trainingData);
+	if(ws == NULL)
+		return NULL;
+	mask = weightsAlloc(trainingData->neurons,trainingData->nlayers, \
+	trainingData->ninputs);
+	if(mask == NULL)
+	{
+		workspaceDestroy(ws);
+		return NULL;
+	}
+
+	if(rounds < 1)
+		rounds = 1;
+	/* Rounds of training and pruning, the last training fine-tunes the
+	 * weights left by the final pruning. Pruned weights are masked
+	 * in the next trainings.
+	 */
+	for(round=1; round<=rounds+1; round++)
+	{
+		hist = trainingMLPWorkspace(weights,trainingData,activation,ws);
+		if(hist == NULL || round > rounds)
+			break;
+		if(pruneMagnitude(weights,trainingData,sparsity*round/rounds) < 0)
+		{
+			hist = NULL;
+			break;
+		}
+		pruneMask(weights,mask,trainingData);
+		ws->mask = mask;
+
+	#ifdef DEBUG_MODE
+		printf("Pruning round %d: sparsity %.2f%%, MSE %.4e\n",round, \
+		100.0*sparsity*round/rounds,hist[(long int) hist[0]]);
+	#endif
+	}
+
+	/* Copy the history out of the workspace */
+	if(hist != NULL)
+	{
+		mse_hist = (double*) malloc(sizeof(double)*((long int) hist[0]+1));
+		if(mse_hist != NULL)
+			memcpy(mse_hist,hist,sizeof(double)*((long int) hist[0]+1));
+	}
+
+	weightsFree(mask,trainingData->neurons,trainingData->nlayers);
+	workspaceDestroy(ws);
+	return mse_hist;
+}
+
+/* Compressed copy of the weights */
+mlpPruned * pruneNetCreate(double *** weights, training * trainingData, \
+double density)
+{
+	int nlayers = trainingData->nlayers;
+	int * neurons = trainingData->neurons;
+	int layer;
+	int neuron;
+	int nin;
+	int w;
+	long int nnz;
+	mlpCSR * m;
+	mlpPruned * net = (mlpPruned*) calloc(1,sizeof(mlpPruned));
+	if(net == NULL)
+		return NULL;
+
+	if(density <= 0.0)
+		density = MLP_PRUNE_DENSITY;
+	net->nlayers = nlayers;
+	net->ninputs = trainingData->ninputs;
+	net->neurons = neurons;
+	net->bias = trainingData->bias;
+	net->weights = weights;
+	net->rows = (mlpCSR**) calloc(nlayers,sizeof(mlpCSR*));
+	net->biasWeight = (double**) calloc(nlayers,sizeof(double*));
+	if(net->rows == NULL || net->biasWeight == NULL)
+	{
+		pruneNetDestroy(net);
+		return NULL;
+	}
+
+	for(layer=0; layer<nlayers; layer++)
+	{
+		nin = layer ? neurons[layer-1] : net->ninputs;
+		nnz = 0;
+		for(neuron=0; neuron<neurons[layer]; neuron++)
+		{
+			for(w=1; w<=nin; w++)
+				nnz += weights[layer][neuron][w] != 0.0;
+		}
+		net->nonzeros += nnz;
+		net->total += (long int) neurons[layer]*nin;
+		if(nnz >= density*neurons[layer]*nin)
+			continue;
+
+		/* Sparse layer */
+		m = csrAlloc(neurons[layer],nin,nnz);
+		net->biasWeight[layer] = (double*) \
+		malloc(sizeof(double)*neurons[layer]);
+		if(m == NULL || net->biasWeight[layer] == NULL)
+		{
+			csrFree(m);
+			pruneNetDestroy(net);
+			return NULL;
+		}
+		nnz = 0;
+		for(neuron=0; neuron<neurons[layer]; neuron++)
+		{
+			net->biasWeight[layer][neuron] = weights[layer][neuron][0];
+			for(w=1; w<=nin; w++)
+			{
+				if(weights[layer][neuron][w] != 0.0)
+				{
+					m->col[nnz] = w-1;
+					m->val[nnz] = weights[layer][neuron][w];
+					nnz++;
+				}
+			}
+			m->ptr[neuron+1] = nnz;
+		}
+		net->rows[layer] = m;
+	}
+
+	return net;
+}
+
+/* Out of a sparse layer for 'count' input vectors
+ * dest = count X neurons, in = count X nin
+ */
+static void sparseLayerOut(double * dest, double * in, int count, \
+double bias, mlpCSR * m, double * biasWeight, int nin, int activation)
+{
+	int neurons = m->rows;
+	int e;
+	int i;
+	int k;
+	int c;
+	double v;
+	double s0;
+	double s1;
+	double s2;
+	double s3;
+	double * x0;
+	double * x1;
+	double * x2;
+	double * x3;
+
+	/* Four examples by pass over the nonzero weights of a neuron */
+	for(e=0; e+4<=count; e+=4)
+	{
+		x0 = in + e*nin;
+		x1 = x0 + nin;
+		x2 = x1 + nin;
+		x3 = x2 + nin;
+		for(i=0; i<neurons; i++)
+		{
+			s0 = bias * biasWeight[i];
+			s1 = s0;
+			s2 = s0;
+			s3 = s0;
+			for(k=m->ptr[i]; k<m->ptr[i+1]; k++)
+			{
+				c = m->col[k];
+				v = m->val[k];
+				s0 += x0[c] * v;
+				s1 += x1[c] * v;
+				s2 += x2[c] * v;
+				s3 += x3[c] * v;
+			}
+			dest[e*neurons + i] = activationOut(s0,activation);
+			dest[(e+1)*neurons + i] = activationOut(s1,activation);
+			dest[(e+2)*neurons + i] = activationOut(s2,activation);
+			dest[(e+3)*neurons + i] = activationOut(s3,activation);
+		}
+	}
+
+	for(; e<count; e++)
+	{
+		x0 = in + e*nin;
+		for(i=0; i<neurons; i++)
+		{
+			s0 = bias * biasWeight[i];
+			for(k=m->ptr[i]; k<m->ptr[i+1]; k++)
+				s0 += x0[m->col[k]] * m->val[k];
+			dest[e*neurons + i] = activationOut(s0,activation);
+		}
+	}
+}
+
+/* Output of the compressed MLP for a batch */
+int pruneNetOutBatch(mlpPruned * net, char * activation, double ** in, \
+int first, int count, double ** out)
+{
+	int nlayers = net->nlayers;
+	int * neurons = net->neurons;
+	int ninputs = net->ninputs;
+	int layer;
+	int e;
+	int n;
+	int nin;
+	int block;
+	int width = ninputs;
+	int actv = getActv(activation);
+	double * a;
+	double * b;
+	double * tmp;
+
+	for(layer=0; layer<nlayers; layer++)
+	{
+		if(neurons[layer] > width)
+			width = neurons[layer];
+	}
+
+	/* Memory for the outputs of a block of examples */
+	a = (double*) malloc(sizeof(double)*MLP_BATCH_BLOCK*width);
+	b = (double*) malloc(sizeof(double)*MLP_BATCH_BLOCK*width);
+	if(a == NULL || b == NULL)
+	{
+		free(a);
+		free(b);
+		return 1;
+	}
+
+	for(block=0; block<count; block+=MLP_BATCH_BLOCK)
+	{
+		n = count - block;
+		if(n > MLP_BATCH_BLOCK)
+			n = MLP_BATCH_BLOCK;
+
+		for(e=0; e<n; e++)
+		{
+			memcpy(a + e*ninputs,in[first+block+e], \
+			sizeof(double)*ninputs);
+		}
+
+		/* Propagation */
+		for(layer=0; layer<nlayers; layer++)
+		{
+			nin = layer ? neurons[layer-1] : ninputs;
+			if(net->rows[layer] != NULL)
+			{
+				sparseLayerOut(b,a,n,net->bias[layer], \
+				net->rows[layer],net->biasWeight[layer],nin,actv);
+			}
+			else
+			{
+				layerOutBatch(b,a,n,net->bias[layer], \
+				net->weights[layer],nin,neurons[layer],actv);
+			}
+			tmp = a;
+			a = b;
+			b = tmp;
+		}
+
+		/* Copy output of last layer to out */
+		for(e=0; e<n; e++)
+		{
+			memcpy(out[block+e],a + e*neurons[nlayers-1], \
+			sizeof(double)*neurons[nlayers-1]);
+		}
+	}
+
+	free(a);
+	free(b);
+	return 0;
+}
+
+/* Output of the compressed MLP */
+void pruneNetOut(mlpPruned * net, char * activation, double ** in, \
+int pos, double * out)
+{
+	if(pruneNetOutBatch(net,activation,in,pos,1,&out))
+	{
+		training tr;
+		memset(&tr,0,sizeof(training));
+		tr.nlayers = net->nlayers;
+		tr.neurons = net->neurons;
+		tr.ninputs = net->ninputs;
+		tr.bias = net->bias;
+		outMLP(net->weights,&tr,activation,in,pos,out);
+	}
+}
+
+/* Deallocate the compressed MLP */
+void pruneNetDestroy(mlpPruned * net)
+{
+	int layer;
+	if(net == NULL)
+		return;
+
+	for(layer=0; net->rows != NULL && layer<net->nlayers; layer++)
+		csrFree(net->rows[layer]);
+	for(layer=0; net->biasWeight != NULL && layer<net->nlayers; layer++)
+		free(net->biasWeight[layer]);
+	free(net->rows);
+	free(net->biasWeight);
+	free(net);
+}
+
+/* Seconds of a monotonic clock */
+static double pruneClock(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+/* Compare the dense and the compressed MLP */
+int pruneCompare(double *** dense, mlpPruned * net, \
+training * trainingData, char * activation, double ** x, double ** ref, \
+int count, pruneReport * report)
+{
+	int r;
+	int error = 0;
+	double t;
+	double ** out = matrixAlloc(count, \
+	trainingData->neurons[trainingData->nlayers-1]);
+	if(out == NULL)
+		return 1;
+
+	memset(report,0,sizeof(pruneReport));
+	report->sparsity = net->total ? 1.0 - (double) net->nonzeros/net->total : 0;
+
+	t = pruneClock();
+	for(r=0; r<MLP_PRUNE_REPEAT; r++)
+		outMLPBatch(dense,trainingData,activation,x,0,count,out);
+	report->denseTime = (pruneClock() - t)/MLP_PRUNE_REPEAT;
+
+	t = pruneClock();
+	for(r=0; r<MLP_PRUNE_REPEAT && !error; r++)
+		error = pruneNetOutBatch(net,activation,x,0,count,out);
+	report->sparseTime = (pruneClock() - t)/MLP_PRUNE_REPEAT;
+	if(report->sparseTime > 0)
+		report->speedup = report->denseTime/report->sparseTime;
+
+	for(r=0; r<count; r++)
+		free(out[r]);
+	free(out);
+
+	error |= evalMLP(dense,trainingData,activation,x,ref,0,count, \
+	&report->dense);
+	error |= evalMLP(net->weights,trainingData,activation,x,ref,0,count, \
+	&report->pruned);
+	report->mseDelta = report->pruned.mse - report->dense.mse;
+	report->accuracyDelta = report->pruned.accuracy - report->dense.accuracy;
+
+	return error;
+}
+
+/* Print a report */
+void prunePrint(pruneReport * report)
+{
+	printf("Sparsity: %.2f%%\n",100.0*report->sparsity);
+	printf("Time dense: %.6f s, sparse: %.6f s, speedup: %.2fx\n", \
+	report->denseTime,report->sparseTime,report->speedup);
+	printf("MSE dense: %.4e, pruned: %.4e, delta: %+.4e\n", \
+	report->dense.mse,report->pruned.mse,report->mseDelta);
+	printf("Accuracy dense: %.2f%%, pruned: %.2f%%, delta: %+.2f%%\n", \
+	100.0*report->dense.accuracy,100.0*report->pruned.accuracy, \
+	100.0*report->accuracyDelta);
+}
@@ -0,0 +1,128 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MLP_PRUNE_H
+#define _MLP_PRUNE_H
+
+#include "mlp.h"
+
+/* Layers with density of weights below this value are kept in CSR
+ * rows by pruneNetCreate, the others stay dense
+ */
+#ifndef MLP_PRUNE_DENSITY
+	#define MLP_PRUNE_DENSITY 0.5
+#endif
+
+/* Repetitions of the batch of pruneCompare to measure the time */
+#ifndef MLP_PRUNE_REPEAT
+	#define MLP_PRUNE_REPEAT 5
+#endif
+
+/* Compressed MLP for inference.
+ * Sparse layers: rows[layer] has the nonzero weights of each neuron
+ * (column = input), biasWeight[layer] the weights of the bias.
+ * Dense layers: rows[layer] is NULL and weights[layer] is used.
+ */
+typedef struct
+{
+	int nlayers;
+	int ninputs;
+	int * neurons;
+	double * bias;
+	double *** weights;
+	mlpCSR ** rows;
+	double ** biasWeight;
+	long int nonzeros;
+	long int total;
+} mlpPruned;
+
+/* Result of pruneCompare */
+typedef struct
+{
+	double sparsity;
+	double denseTime;
+	double sparseTime;
+	double speedup;
+	mlpMetrics dense;
+	mlpMetrics pruned;
+	double mseDelta;
+	double accuracyDelta;
+} pruneReport;
+
+/* Magnitude pruning: zero the fraction 'sparsity' of the weights of
+ * each layer with the smallest absolute value, the weights of the bias
+ * are kept.
+ * return number of zero weights of the MLP (bias excluded), -1 in error
+ */
+long int pruneMagnitude(double *** weights, training * trainingData, \
+double sparsity);
+
+/* Iterative pruning: 'rounds' trainings of trainingMLP, each one
+ * followed by a pruning up to 'sparsity'*round/rounds, then a last
+ * training that fine-tunes the weights after the final pruning. The
+ * pruned weights are masked (stay zero) in the next trainings.
+ * return History of MSE of the last training (deallocate with free)
+ */
+double * trainingMLPPrune(double *** weights, training * trainingData, \
+char * activation, double sparsity, int rounds);
+
+/* Compressed copy of the weights, layers with density below 'density'
+ * in CSR rows (MLP_PRUNE_DENSITY if density <= 0)
+ * The struct keeps pointers to 'weights' and 'trainingData'.
+ * return NULL in error
+ */
+mlpPruned * pruneNetCreate(double *** weights, training * trainingData, \
+double density);
+
+/* Output of the compressed MLP for in[pos] */
+void pruneNetOut(mlpPruned * net, char * activation, double ** in, \
+int pos, double * out);
+
+/* Output of the compressed MLP for in[first] until in[first+count-1],
+ * 4 examples by pass over the nonzero weights of each neuron
+ * The 'out' is a matrix 'count' X outputs
+ * return 0 = success, 1 = error
+ */
+int pruneNetOutBatch(mlpPruned * net, char * activation, double ** in, \
+int first, int count, double ** out);
+
+/* Deallocate the compressed MLP (not the weights) */
+void pruneNetDestroy(mlpPruned * net);
+
+/* Sparsity, time of outMLPBatch with 'dense' and of pruneNetOutBatch
+ * with 'net', speedup and metrics (evalMLP) of both MLPs over the
+ * 'count' examples of x/ref
+ * return 0 = success, 1 = error
+ */
+int pruneCompare(double *** dense, mlpPruned * net, \
+training * trainingData, char * activation, double ** x, double ** ref, \
+int count, pruneReport * report);
+
+/* Print a report */
+void prunePrint(pruneReport * report);
+
+#endif /* _MLP_PRUNE_H */
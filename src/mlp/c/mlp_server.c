@@ -0,0 +1,694 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mlp_server.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* Poll timeout (ms) to check the stop flag */
+#define SERVER_POLL_MS 100
+
+/* Seconds of a monotonic clock */
+static double serverClock(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+
+	return t.tv_sec + t.tv_nsec/1e9;
+}
+
+/* Write all bytes, waiting the socket if it is full */
+static int writeAll(int fd, void * buf, size_t bytes)
+{
+	size_t sent = 0;
+	ssize_t n;
+	struct pollfd pfd;
+
+	while(sent < bytes)
+	{
+		n = send(fd,(char*) buf + sent,bytes-sent,MSG_NOSIGNAL);
+		if(n > 0)
+		{
+			sent += n;
+		}
+		else if(n < 0 && (errno == EAGAIN || errno == EINTR))
+		{
+			pfd.fd = fd;
+			pfd.events = POLLOUT;
+			poll(&pfd,1,SERVER_POLL_MS);
+		}
+		else
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* Read all bytes, blocking socket */
+static int readAll(int fd, void * buf, size_t bytes)
+{
+	size_t received = 0;
+	ssize_t n;
+	while(received < bytes)
+	{
+		n = recv(fd,(char*) buf + received,bytes-received,0);
+		if(n > 0)
+			received += n;
+		else if(n < 0 && errno == EINTR)
+			continue;
+		else
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Send a response, the connection is locked by the caller */
+static int sendResponse(serverConn * conn, uint32_t status, uint32_t id, \
+double * data, int count)
+{
+	serverHeader h;
+	h.magic = SERVER_MAGIC_RESPONSE;
+	h.type = status;
+	h.id = id;
+	h.count = count;
+	if(writeAll(conn->fd,&h,sizeof(h)))
+		return 1;
+
+	return writeAll(conn->fd,data,sizeof(double)*count);
+}
+
+/* Release a reference of a connection */
+static void connRelease(serverConn * conn)
+{
+	if(atomic_fetch_sub(&conn->refs,1) == 1)
+	{
+		close(conn->fd);
+		pthread_mutex_destroy(&conn->lock);
+		free(conn->in);
+		free(conn);
+	}
+}
+
+/* Bin of the latency histogram */
+static int latencyBin(double us)
+{
+	int b = 0;
+	while(us >= 2 && b < SERVER_LATENCY_BINS-1)
+	{
+		us /= 2;
+		b++;
+	}
+
+	return b;
+}
+
+/* Inference thread: dynamic batching of the requests */
+static void * serverWorker(void * varg)
+{
+	mlpServer * server = (mlpServer*) varg;
+	int nout = server->trainingData->neurons[server->trainingData->nlayers-1];
+	int n;
+	int i;
+	double deadline;
+	double now;
+	double us;
+	uint32_t status;
+	mlpCache * cache;
+	mlpCodebook * codebook;
+	struct timespec ts;
+	serverRequest * req;
+	serverRequest * batch;
+	double ** in = (double**) malloc(sizeof(double*)*server->maxBatch);
+	double ** out = matrixAlloc(server->maxBatch,nout);
+
+	pthread_mutex_lock(&server->lock);
+	while(!atomic_load(&server->stop))
+	{
+		while(server->pending == 0 && !atomic_load(&server->stop))
+			pthread_cond_wait(&server->ready,&server->lock);
+		if(atomic_load(&server->stop))
+			break;
+
+		/* Wait a full batch or the deadline of the oldest request */
+		deadline = server->head->arrival + server->maxWait/1e6;
+		now = serverClock();
+		while(server->pending > 0 && server->pending < server->maxBatch && \
+		now < deadline && !atomic_load(&server->stop))
+		{
+			ts.tv_sec = (time_t) deadline;
+			ts.tv_nsec = (long int) ((deadline - ts.tv_sec)*1e9);
+			pthread_cond_timedwait(&server->ready,&server->lock,&ts);
+			now = serverClock();
+		}
+		if(server->pending == 0)
+			continue;
+
+		/* Take the batch */
+		batch = server->head;
+		n = 0;
+		req = batch;
+		while(n < server->maxBatch && req != NULL)
+		{
+			in[n++] = req->in;
+			server->head = req->next;
+			if(n == server->maxBatch || req->next == NULL)
+				req->next = NULL;
+			req = server->head;
+		}
+		if(server->head == NULL)
+			server->tail = NULL;
+		server->pending -= n;
+		if(server->pending > 0)
+			pthread_cond_signal(&server->ready);
+		cache = server->cache;
+		codebook = server->codebook;
+		pthread_mutex_unlock(&server->lock);
+
+		status = SERVER_OK;
+		if(cache != NULL)
+		{
+			if(cacheOutBatch(cache,in,0,n,out))
+				status = SERVER_ERROR;
+		}
+		else if(codebook != NULL)
+		{
+			if(codebookOutBatch(codebook,server->activation,in,0,n,out))
+				status = SERVER_ERROR;
+		}
+		else
+		{
+			outMLPBatch(server->weights,server->trainingData, \
+			server->activation,in,0,n,out);
+		}
+
+		/* Responses */
+		i = 0;
+		us = 0;
+		while(batch != NULL)
+		{
+			req = batch;
+			batch = batch->next;
+			pthread_mutex_lock(&req->conn->lock);
+			sendResponse(req->conn,status,req->id,out[i], \
+			status == SERVER_OK ? nout : 0);
+			pthread_mutex_unlock(&req->conn->lock);
+			now = serverClock();
+			us = (now - req->arrival)*1e6;
+
+			pthread_mutex_lock(&server->lock);
+			server->latency[latencyBin(us)] += 1;
+			server->latencySum += us;
+			pthread_mutex_unlock(&server->lock);
+
+			connRelease(req->conn);
+			free(req->in);
+			free(req);
+			i++;
+		}
+
+		pthread_mutex_lock(&server->lock);
+		server->requests += n;
+		server->batches += 1;
+		server->batchSizes[n-1] += 1;
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	free(in);
+	for(i=0; i<server->maxBatch; i++)
+		free(out[i]);
+	free(out);
+
+	return NULL;
+}
+
+/* Create a server */
+mlpServer * serverCreate(char * path, double *** weights, \
+training * trainingData, char * activation, int maxBatch, \
+long int maxWait, int workers)
+{
+	struct sockaddr_un sa;
+	pthread_condattr_t attr;
+	mlpServer * server;
+	int i;
+
+	if(strlen(path) >= sizeof(sa.sun_path))
+		return NULL;
+
+	server = (mlpServer*) calloc(1,sizeof(mlpServer));
+	if(server == NULL)
+		return NULL;
+
+	server->weights = weights;
+	server->trainingData = trainingData;
+	server->activation = activation;
+	server->maxBatch = maxBatch < 1 ? 1 : maxBatch;
+	server->maxWait = maxWait < 0 ? 0 : maxWait;
+	server->workers = workers < 1 ? 1 : workers;
+	server->path = path;
+	server->start = serverClock();
+	atomic_init(&server->stop,0);
+	server->batchSizes = (long int*) \
+	calloc(server->maxBatch,sizeof(long int));
+	server->threads = (pthread_t*) \
+	malloc(sizeof(pthread_t)*server->workers);
+	if(server->batchSizes == NULL || server->threads == NULL)
+	{
+		free(server->batchSizes);
+		free(server->threads);
+		free(server);
+		return NULL;
+	}
+
+	memset(&sa,0,sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	strcpy(sa.sun_path,path);
+	unlink(path);
+	server->listenFd = socket(AF_UNIX,SOCK_STREAM,0);
+	if(server->listenFd < 0 || \
+	bind(server->listenFd,(struct sockaddr*) &sa,sizeof(sa)) || \
+	listen(server->listenFd,64))
+	{
+		if(server->listenFd >= 0)
+			close(server->listenFd);
+		free(server->batchSizes);
+		free(server->threads);
+		free(server);
+		return NULL;
+	}
+	fcntl(server->listenFd,F_SETFL, \
+	fcntl(server->listenFd,F_GETFL) | O_NONBLOCK);
+
+	/* Deadlines in the monotonic clock */
+	pthread_mutex_init(&server->lock,NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr,CLOCK_MONOTONIC);
+	pthread_cond_init(&server->ready,&attr);
+	pthread_condattr_destroy(&attr);
+
+	for(i=0; i<server->workers; i++)
+		pthread_create(&server->threads[i],NULL,serverWorker,server);
+
+	return server;
+}
+
+/* Read what is available of a connection, return 1 to close it */
+static int connRead(mlpServer * server, serverConn * conn)
+{
+	int ninputs = server->trainingData->ninputs;
+	size_t need;
+	ssize_t n;
+	char * dest;
+	serverRequest * req;
+	double stats[8+SERVER_LATENCY_BINS+1024];
+	int count;
+
+	while(1)
+	{
+		/* Header and then the doubles */
+		if(conn->received < sizeof(serverHeader))
+		{
+			need = sizeof(serverHeader) - conn->received;
+			dest = (char*) &conn->header + conn->received;
+		}
+		else
+		{
+			need = sizeof(serverHeader) + sizeof(double)*ninputs - \
+			conn->received;
+			dest = (char*) conn->in + \
+			(conn->received - sizeof(serverHeader));
+		}
+
+		n = recv(conn->fd,dest,need,0);
+		if(n == 0)
+			return 1;
+		if(n < 0)
+			return errno == EAGAIN || errno == EINTR ? 0 : 1;
+		conn->received += n;
+
+		if(conn->received == sizeof(serverHeader))
+		{
+			if(conn->header.magic != SERVER_MAGIC_REQUEST)
+				return 1;
+
+			if(conn->header.type == SERVER_STATS && conn->header.count == 0)
+			{
+				count = serverStatistics(server,stats, \
+				sizeof(stats)/sizeof(double));
+				conn->received = 0;
+				pthread_mutex_lock(&conn->lock);
+				sendResponse(conn,SERVER_OK,conn->header.id,stats,count);
+				pthread_mutex_unlock(&conn->lock);
+			}
+			else if(conn->header.type != SERVER_OUT || \
+			conn->header.count != (uint32_t) ninputs)
+			{
+				pthread_mutex_lock(&conn->lock);
+				sendResponse(conn,SERVER_ERROR,conn->header.id,NULL,0);
+				pthread_mutex_unlock(&conn->lock);
+				return 1;
+			}
+		}
+		else if(conn->received == sizeof(serverHeader) + \
+		sizeof(double)*ninputs)
+		{
+			/* Complete request, to the queue */
+			req = (serverRequest*) malloc(sizeof(serverRequest));
+			if(req == NULL)
+				return 1;
+			req->conn = conn;
+			req->id = conn->header.id;
+			req->arrival = serverClock();
+			req->in = conn->in;
+			req->next = NULL;
+			conn->in = (double*) malloc(sizeof(double)*ninputs);
+			conn->received = 0;
+			atomic_fetch_add(&conn->refs,1);
+
+			pthread_mutex_lock(&server->lock);
+			if(server->tail != NULL)
+				server->tail->next = req;
+			else
+				server->head = req;
+			server->tail = req;
+			server->pending += 1;
+			pthread_cond_signal(&server->ready);
+			pthread_mutex_unlock(&server->lock);
+
+			if(conn->in == NULL)
+				return 1;
+		}
+	}
+}
+
+/* Serve the requests until serverStop */
+int serverRun(mlpServer * server)
+{
+	int nconn = 0;
+	int maxconn = 16;
+	int i;
+	int fd;
+	serverConn * conn;
+	serverConn ** conns = (serverConn**) malloc(sizeof(serverConn*)*maxconn);
+	struct pollfd * pfd = (struct pollfd*) \
+	malloc(sizeof(struct pollfd)*(maxconn+1));
+	if(conns == NULL || pfd == NULL)
+		return 1;
+
+	while(!atomic_load(&server->stop))
+	{
+		pfd[0].fd = server->listenFd;
+		pfd[0].events = POLLIN;
+		for(i=0; i<nconn; i++)
+		{
+			pfd[i+1].fd = conns[i]->fd;
+			pfd[i+1].events = POLLIN;
+		}
+		if(poll(pfd,nconn+1,SERVER_POLL_MS) <= 0)
+			continue;
+
+		/* Requests of the connections */
+		for(i=nconn-1; i>=0; i--)
+		{
+			if(pfd[i+1].revents == 0)
+				continue;
+			if(connRead(server,conns[i]))
+			{
+				connRelease(conns[i]);
+				conns[i] = conns[nconn-1];
+				nconn--;
+			}
+		}
+
+		/* New connections */
+		if(pfd[0].revents & POLLIN)
+		{
+			while((fd = accept(server->listenFd,NULL,NULL)) >= 0)
+			{
+				if(nconn == maxconn)
+				{
+					maxconn *= 2;
+					conns = (serverConn**) \
+					realloc(conns,sizeof(serverConn*)*maxconn);
+					pfd = (struct pollfd*) \
+					realloc(pfd,sizeof(struct pollfd)*(maxconn+1));
+					if(conns == NULL || pfd == NULL)
+						return 1;
+				}
+				conn = (serverConn*) calloc(1,sizeof(serverConn));
+				if(conn == NULL)
+				{
+					close(fd);
+					continue;
+				}
+				fcntl(fd,F_SETFL,fcntl(fd,F_GETFL) | O_NONBLOCK);
+				conn->fd = fd;
+				atomic_init(&conn->refs,1);
+				pthread_mutex_init(&conn->lock,NULL);
+				conn->in = (double*) \
+				malloc(sizeof(double)*server->trainingData->ninputs);
+				conns[nconn++] = conn;
+			}
+		}
+	}
+
+	/* Stop the workers, the requests not served are dropped */
+	pthread_mutex_lock(&server->lock);
+	pthread_cond_broadcast(&server->ready);
+	pthread_mutex_unlock(&server->lock);
+	for(i=0; i<server->workers; i++)
+		pthread_join(server->threads[i],NULL);
+
+	while(server->head != NULL)
+	{
+		serverRequest * req = server->head;
+		server->head = req->next;
+		connRelease(req->conn);
+		free(req->in);
+		free(req);
+	}
+	server->tail = NULL;
+	server->pending = 0;
+
+	for(i=0; i<nconn; i++)
+		connRelease(conns[i]);
+	free(conns);
+	free(pfd);
+
+	return 0;
+}
+
+/* Ask the server to stop */
+void serverStop(mlpServer * server)
+{
+	atomic_store(&server->stop,1);
+}
+
+/* Percentile of the latency histogram, upper bound of the bin */
+static double latencyPercentile(long int * bins, long int total, double p)
+{
+	long int acc = 0;
+	int b;
+	for(b=0; b<SERVER_LATENCY_BINS; b++)
+	{
+		acc += bins[b];
+		if(acc >= p*total)
+			return pow(2.0,b+1);
+	}
+
+	return pow(2.0,SERVER_LATENCY_BINS);
+}
+
+/* Statistics */
+int serverStatistics(mlpServer * server, double * stats, int max)
+{
+	int i;
+	int n = 0;
+	double all[8+SERVER_LATENCY_BINS];
+	long int served;
+
+	pthread_mutex_lock(&server->lock);
+	served = 0;
+	for(i=0; i<SERVER_LATENCY_BINS; i++)
+		served += server->latency[i];
+	all[0] = server->requests;
+	all[1] = server->batches;
+	all[2] = serverClock() - server->start;
+	all[3] = all[2] > 0 ? server->requests/all[2] : 0;
+	all[4] = served ? server->latencySum/served : 0;
+	all[5] = served ? latencyPercentile(server->latency,served,0.5) : 0;
+	all[6] = served ? latencyPercentile(server->latency,served,0.9) : 0;
+	all[7] = served ? latencyPercentile(server->latency,served,0.99) : 0;
+	for(i=0; i<SERVER_LATENCY_BINS; i++)
+		all[8+i] = server->latency[i];
+
+	for(i=0; i<8+SERVER_LATENCY_BINS && n<max; i++)
+		stats[n++] = all[i];
+	for(i=0; i<server->maxBatch && n<max; i++)
+		stats[n++] = server->batchSizes[i];
+	pthread_mutex_unlock(&server->lock);
+
+	return n;
+}
+
+/* Print the statistics */
+void serverPrint(mlpServer * server)
+{
+	int i;
+	long int hits;
+	long int misses;
+	double stats[8+SERVER_LATENCY_BINS];
+	serverStatistics(server,stats,8+SERVER_LATENCY_BINS);
+
+	printf("Requests: %.0f\nBatches: %.0f\n",stats[0],stats[1]);
+	printf("Mean batch: %.2f\n",stats[1] > 0 ? stats[0]/stats[1] : 0);
+	printf("Throughput: %.1f requests/s\n",stats[3]);
+	printf("Latency (us): mean %.1f p50 %.0f p90 %.0f p99 %.0f\n", \
+	stats[4],stats[5],stats[6],stats[7]);
+	printf("Latency histogram (us):\n");
+	for(i=0; i<SERVER_LATENCY_BINS; i++)
+	{
+		if(stats[8+i] > 0)
+			printf("  [%.0f, %.0f): %.0f\n",pow(2.0,i),pow(2.0,i+1), \
+			stats[8+i]);
+	}
+	printf("Batch size histogram:\n");
+	for(i=0; i<server->maxBatch; i++)
+	{
+		if(server->batchSizes[i] > 0)
+			printf("  %d: %ld\n",i+1,server->batchSizes[i]);
+	}
+	if(server->cache != NULL)
+	{
+		cacheStats(server->cache,&hits,&misses);
+		printf("Cache: %ld hits, %ld misses\n",hits,misses);
+	}
+}
+
+/* Cache of the outputs of the server */
+void serverCache(mlpServer * server, mlpCache * cache)
+{
+	pthread_mutex_lock(&server->lock);
+	server->cache = cache;
+	pthread_mutex_unlock(&server->lock);
+}
+
+/* Compressed model */
+void serverCodebook(mlpServer * server, mlpCodebook * codebook)
+{
+	pthread_mutex_lock(&server->lock);
+	server->codebook = codebook;
+	pthread_mutex_unlock(&server->lock);
+}
+
+/* Close the socket and deallocate the server */
+void serverDestroy(mlpServer * server)
+{
+	close(server->listenFd);
+	unlink(server->path);
+	pthread_cond_destroy(&server->ready);
+	pthread_mutex_destroy(&server->lock);
+	free(server->batchSizes);
+	free(server->threads);
+	free(server);
+}
+
+/* Client: connect to a server */
+int serverConnect(char * path)
+{
+	struct sockaddr_un sa;
+	int fd;
+	if(strlen(path) >= sizeof(sa.sun_path))
+		return -1;
+
+	memset(&sa,0,sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	strcpy(sa.sun_path,path);
+	fd = socket(AF_UNIX,SOCK_STREAM,0);
+	if(fd < 0)
+		return -1;
+	if(connect(fd,(struct sockaddr*) &sa,sizeof(sa)))
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* Client: send a request and read the response */
+static int clientRequest(int fd, uint32_t type, double * in, int nin, \
+double * out, int max)
+{
+	static atomic_uint ids;
+	serverHeader h;
+	double d;
+	uint32_t i;
+
+	h.magic = SERVER_MAGIC_REQUEST;
+	h.type = type;
+	h.id = atomic_fetch_add(&ids,1);
+	h.count = nin;
+	if(writeAll(fd,&h,sizeof(h)) || \
+	writeAll(fd,in,sizeof(double)*nin) || \
+	readAll(fd,&h,sizeof(h)) || h.magic != SERVER_MAGIC_RESPONSE)
+		return -1;
+
+	for(i=0; i<h.count; i++)
+	{
+		if(readAll(fd,&d,sizeof(double)))
+			return -1;
+		if((int) i < max)
+			out[i] = d;
+	}
+	if(h.type != SERVER_OK)
+		return -1;
+
+	return (int) h.count < max ? (int) h.count : max;
+}
+
+/* Client: output of MLP for one input */
+int serverOut(int fd, double * in, int ninputs, double * out, \
+int noutputs)
+{
+	if(clientRequest(fd,SERVER_OUT,in,ninputs,out,noutputs) != noutputs)
+		return 1;
+
+	return 0;
+}
+
+/* Client: statistics of the server */
+int serverStats(int fd, double * stats, int max)
+{
+	return clientRequest(fd,SERVER_STATS,NULL,0,stats,max);
+}
@@ -0,0 +1,173 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MLP_SERVER_H
+#define _MLP_SERVER_H
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "mlp.h"
+#include "mlp_cache.h"
+#include "mlp_codebook.h"
+
+/* Inference server over a Unix-domain socket with dynamic batching.
+ *
+ * Protocol, native byte order, each message is a header followed by
+ * 'count' doubles:
+ *   Request SERVER_OUT: the inputs of one example
+ *   Request SERVER_STATS: no doubles
+ *   Response: status SERVER_OK or SERVER_ERROR, same 'id' of the
+ *     request, the outputs or the statistics (see serverStats)
+ */
+#define SERVER_MAGIC_REQUEST 0x514C504D
+#define SERVER_MAGIC_RESPONSE 0x524C504D
+#define SERVER_OUT 1
+#define SERVER_STATS 2
+#define SERVER_OK 0
+#define SERVER_ERROR 1
+
+/* Bins of the latency histogram, bin 0 counts [0,2) us, bin b > 0
+ * counts [2^b,2^(b+1)) us and the last bin all above
+ */
+#define SERVER_LATENCY_BINS 32
+
+/* Message header */
+typedef struct
+{
+	uint32_t magic;
+	uint32_t type;
+	uint32_t id;
+	uint32_t count;
+} serverHeader;
+
+/* Request waiting a batch */
+typedef struct serverRequest
+{
+	struct serverConn * conn;
+	uint32_t id;
+	double arrival;
+	double * in;
+	struct serverRequest * next;
+} serverRequest;
+
+/* Client connection */
+typedef struct serverConn
+{
+	int fd;
+	atomic_int refs;
+	pthread_mutex_t lock;
+	size_t received;
+	serverHeader header;
+	double * in;
+} serverConn;
+
+/* Inference server */
+typedef struct
+{
+	double *** weights;
+	/* Compressed model served instead of the weights (NULL = weights) */
+	mlpCodebook * codebook;
+	training * trainingData;
+	char * activation;
+	/* Optional cache of the outputs (NULL = none) */
+	mlpCache * cache;
+	int maxBatch;
+	long int maxWait;
+	int workers;
+	int listenFd;
+	char * path;
+	atomic_int stop;
+	pthread_t * threads;
+	/* Queue of requests */
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	serverRequest * head;
+	serverRequest * tail;
+	int pending;
+	/* Statistics */
+	double start;
+	long int requests;
+	long int batches;
+	double latencySum;
+	long int latency[SERVER_LATENCY_BINS];
+	long int * batchSizes;
+} mlpServer;
+
+/* Create a server listening in 'path'
+ * maxBatch = maximum requests by batch
+ * maxWait = maximum microseconds that a request waits for a batch
+ * workers = inference threads
+ * return NULL in error
+ */
+mlpServer * serverCreate(char * path, double *** weights, \
+training * trainingData, char * activation, int maxBatch, \
+long int maxWait, int workers);
+
+/* Put the cache 'cache' (of the same weights) in front of the
+ * inference of the server, NULL removes it
+ */
+void serverCache(mlpServer * server, mlpCache * cache);
+
+/* Serve the compressed model 'codebook' (codebookOutBatch) instead of
+ * the weights, NULL serves the weights. A cache of the server must use
+ * the same model (cacheCodebook).
+ */
+void serverCodebook(mlpServer * server, mlpCodebook * codebook);
+
+/* Serve the requests until serverStop */
+int serverRun(mlpServer * server);
+
+/* Ask the server to stop, safe in a signal handler */
+void serverStop(mlpServer * server);
+
+/* Statistics, returns the number of doubles written in 'stats':
+ *   0: requests, 1: batches, 2: seconds since start,
+ *   3: requests by second, 4: mean latency (us),
+ *   5, 6, 7: latency percentiles 50, 90 and 99 (us, upper bound of bin),
+ *   8 until 8+SERVER_LATENCY_BINS-1: latency histogram,
+ *   next maxBatch: histogram of batch sizes 1 until maxBatch
+ */
+int serverStatistics(mlpServer * server, double * stats, int max);
+
+/* Print the statistics */
+void serverPrint(mlpServer * server);
+
+/* Close the socket and deallocate the server */
+void serverDestroy(mlpServer * server);
+
+/* Client: connect to a server, return the socket or -1 */
+int serverConnect(char * path);
+
+/* Client: output of MLP for one input, return 0 on success */
+int serverOut(int fd, double * in, int ninputs, double * out, \
+int noutputs);
+
+/* Client: statistics of the server, return the number of doubles */
+int serverStats(int fd, double * stats, int max);
+
+#endif /* _MLP_SERVER_H */
@@ -0,0 +1,649 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mlp_sweep.h"
+#include <stdatomic.h>
+#include <sys/time.h>
+
+/* Status names in the results table */
+static const char * sweepStatus[] = \
+{"running","converged","iterations","time","halved","diverged"};
+
+/* State of a sweep job */
+typedef struct
+{
+	sweepResult * result;
+	training tr;
+	double *** weights;
+	double *** step;
+	double * delta;
+	long int count;
+	int * xidx;
+	double ** yout;
+	double * gs;
+	double * gsPrev;
+	unsigned int seed;
+	/* Workspace of trainingMLPWorkspace (batch 1), budget of the rung
+	 * and start of the training
+	 */
+	mlpWorkspace * ws;
+	mlpSweep * sweep;
+	long int budget;
+	double begin;
+} sweepJob;
+
+/* Shared state of a rung */
+typedef struct
+{
+	mlpSweep * sweep;
+	sweepJob ** jobs;
+	int njobs;
+	long int budget;
+	atomic_int next;
+} sweepRung;
+
+/* Default sweep */
+void sweepDefault(mlpSweep * sweep, training * trainingData)
+{
+	int i;
+	memset(sweep,0,sizeof(mlpSweep));
+	sweep->nlrate = 1;
+	sweep->lrate[0] = trainingData->lrate;
+	sweep->nalpha = 1;
+	sweep->alpha[0] = trainingData->alpha;
+	sweep->nbias = 1;
+	sweep->bias[0] = trainingData->bias[0];
+	sweep->narch = 1;
+	sweep->nlayers[0] = trainingData->nlayers;
+	for(i=0; i<trainingData->nlayers && i<SWEEP_MAX_LAYERS; i++)
+		sweep->neurons[0][i] = trainingData->neurons[i];
+	sweep->seed = time(NULL);
+	sweep->maxIteration = trainingData->maxIteration;
+	sweep->rungs = 1;
+	sweep->eta = 3;
+	sweep->batch = 1;
+}
+
+/* Read the values of a line */
+static int readValues(char * c, double * values, int max)
+{
+	int n = 0;
+	char * end;
+	double v;
+	while(n < max)
+	{
+		v = strtod(c,&end);
+		if(end == c)
+			break;
+		values[n++] = v;
+		c = end;
+	}
+
+	return n;
+}
+
+/* Load a sweep specification from a file */
+int sweepLoad(char * filename, mlpSweep * sweep)
+{
+	char line[1024];
+	char key[32];
+	double values[SWEEP_MAX_VALUES];
+	int n;
+	int i;
+	int offset;
+	int nline = 0;
+	int archLoaded = 0;
+	FILE * f = fopen(filename,"r");
+	if(f == NULL)
+		return -1;
+
+	while(fgets(line,sizeof(line),f) != NULL)
+	{
+		nline++;
+		if(sscanf(line," %31s%n",key,&offset) != 1 || key[0] == '#')
+			continue;
+
+		n = readValues(line+offset,values,SWEEP_MAX_VALUES);
+		if(n < 1)
+		{
+			fclose(f);
+			return nline;
+		}
+
+		if(strcmp(key,"lrate") == 0)
+		{
+			sweep->nlrate = n;
+			memcpy(sweep->lrate,values,sizeof(double)*n);
+		}
+		else if(strcmp(key,"alpha") == 0)
+		{
+			sweep->nalpha = n;
+			memcpy(sweep->alpha,values,sizeof(double)*n);
+		}
+		else if(strcmp(key,"bias") == 0)
+		{
+			sweep->nbias = n;
+			memcpy(sweep->bias,values,sizeof(double)*n);
+		}
+		else if(strcmp(key,"layers") == 0 && n <= SWEEP_MAX_LAYERS)
+		{
+			/* The first 'layers' line replaces the default */
+			if(!archLoaded)
+				sweep->narch = 0;
+			archLoaded = 1;
+			if(sweep->narch >= SWEEP_MAX_VALUES)
+			{
+				fclose(f);
+				return nline;
+			}
+			sweep->nlayers[sweep->narch] = n;
+			for(i=0; i<n; i++)
+				sweep->neurons[sweep->narch][i] = (int) values[i];
+			sweep->narch += 1;
+		}
+		else if(strcmp(key,"samples") == 0)
+			sweep->samples = (int) values[0];
+		else if(strcmp(key,"seed") == 0)
+			sweep->seed = (unsigned int) values[0];
+		else if(strcmp(key,"iterations") == 0)
+			sweep->maxIteration = (long int) values[0];
+		else if(strcmp(key,"seconds") == 0)
+			sweep->maxSeconds = values[0];
+		else if(strcmp(key,"rungs") == 0)
+			sweep->rungs = (int) values[0];
+		else if(strcmp(key,"eta") == 0)
+			sweep->eta = (int) values[0];
+		else if(strcmp(key,"batch") == 0)
+			sweep->batch = (int) values[0];
+		else if(strcmp(key,"threads") == 0)
+			sweep->threads = (int) values[0];
+		else
+		{
+			fclose(f);
+			return nline;
+		}
+	}
+	fclose(f);
+
+	return 0;
+}
+
+/* Seconds of a monotonic clock */
+static double sweepClock(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+
+	return t.tv_sec + t.tv_nsec/1e9;
+}
+
+/* Uniform random number in [0,1] */
+static double sweepRand(unsigned int * seed)
+{
+	return (double) rand_r(seed)/RAND_MAX;
+}
+
+/* Minimum and maximum of values */
+static void sweepBounds(double * values, int n, double * min, double * max)
+{
+	int i;
+	*min = values[0];
+	*max = values[0];
+	for(i=1; i<n; i++)
+	{
+		if(values[i] < *min)
+			*min = values[i];
+		if(values[i] > *max)
+			*max = values[i];
+	}
+}
+
+/* Configurations of the grid or of the random search */
+static sweepResult * sweepConfigs(mlpSweep * sweep, int * njobs)
+{
+	int i;
+	int n;
+	double min;
+	double max;
+	unsigned int seed = sweep->seed;
+	sweepResult * r;
+
+	if(sweep->samples > 0)
+		n = sweep->samples;
+	else
+		n = sweep->nlrate*sweep->nalpha*sweep->nbias*sweep->narch;
+
+	r = (sweepResult*) calloc(n,sizeof(sweepResult));
+	if(r == NULL)
+		return NULL;
+
+	for(i=0; i<n; i++)
+	{
+		if(sweep->samples > 0)
+		{
+			sweepBounds(sweep->lrate,sweep->nlrate,&min,&max);
+			if(min > 0)
+				r[i].lrate = min*pow(max/min,sweepRand(&seed));
+			else
+				r[i].lrate = min + (max-min)*sweepRand(&seed);
+			sweepBounds(sweep->alpha,sweep->nalpha,&min,&max);
+			r[i].alpha = min + (max-min)*sweepRand(&seed);
+			r[i].bias = sweep->bias[rand_r(&seed) % sweep->nbias];
+			r[i].arch = rand_r(&seed) % sweep->narch;
+		}
+		else
+		{
+			/* Index of the grid: lrate, alpha, bias, architecture */
+			r[i].lrate = sweep->lrate[i % sweep->nlrate];
+			r[i].alpha = sweep->alpha[(i/sweep->nlrate) % sweep->nalpha];
+			r[i].bias = sweep->bias[(i/(sweep->nlrate*sweep->nalpha)) \
+			% sweep->nbias];
+			r[i].arch = i/(sweep->nlrate*sweep->nalpha*sweep->nbias);
+		}
+		r[i].mse = HUGE_VAL;
+		r[i].status = SWEEP_RUNNING;
+	}
+	*njobs = n;
+
+	return r;
+}
+
+/* Status of a job after an epoch */
+static void jobStatus(sweepJob * job, double seconds)
+{
+	sweepResult * r = job->result;
+	if(r->mse != r->mse)
+		r->status = SWEEP_DIVERGED;
+	else if(r->mse <= job->tr.acceptedError)
+		r->status = SWEEP_CONVERGED;
+	else if(r->iterations >= job->sweep->maxIteration)
+		r->status = SWEEP_ITERATIONS;
+	else if(job->sweep->maxSeconds > 0 && seconds >= job->sweep->maxSeconds)
+		r->status = SWEEP_TIME;
+}
+
+/* Evaluator of the epochs of trainingMLPWorkspace, stops the training
+ * at the end of the status or of the budget of the rung
+ */
+static int jobEvaluate(void * arg, double *** weights, \
+training * trainingData, char * activation, double ** x, double ** ref, \
+int count, mlpMetrics * metrics)
+{
+	sweepJob * job = (sweepJob*) arg;
+	sweepResult * r = job->result;
+	if(evalMLP(weights,trainingData,activation,x,ref,0,count,metrics))
+		return 1;
+
+	r->iterations += trainingData->examples;
+	r->mse = metrics->mse;
+	jobStatus(job,r->seconds + sweepClock() - job->begin);
+
+	return r->status != SWEEP_RUNNING || r->iterations >= job->budget;
+}
+
+/* Deallocate a job */
+static void jobFree(sweepJob * job)
+{
+	int i;
+	if(job == NULL)
+		return;
+
+	weightsFree(job->weights,job->tr.neurons,job->tr.nlayers);
+	weightsUnmap(job->step,job->tr.nlayers);
+	free(job->delta);
+	if(job->yout != NULL)
+	{
+		for(i=0; i<job->tr.nlayers; i++)
+			free(job->yout[i]);
+	}
+	free(job->yout);
+	free(job->xidx);
+	free(job->gs);
+	free(job->gsPrev);
+	if(job->ws != NULL)
+		workspaceDestroy(job->ws);
+	free(job->tr.neurons);
+	free(job->tr.bias);
+	free(job);
+}
+
+/* Create a job of a configuration */
+static sweepJob * jobCreate(mlpSweep * sweep, training * trainingData, \
+sweepResult * result, unsigned int seed)
+{
+	int i;
+	int nlayers = sweep->nlayers[result->arch];
+	int width = trainingData->ninputs;
+	long int k;
+	sweepJob * job = (sweepJob*) calloc(1,sizeof(sweepJob));
+	if(job == NULL)
+		return NULL;
+
+	job->result = result;
+	job->seed = seed;
+	job->tr = *trainingData;
+	job->tr.nlayers = nlayers;
+	job->tr.neurons = (int*) malloc(sizeof(int)*nlayers);
+	job->tr.bias = (double*) malloc(sizeof(double)*nlayers);
+	if(job->tr.neurons == NULL || job->tr.bias == NULL)
+	{
+		jobFree(job);
+		return NULL;
+	}
+	for(i=0; i<nlayers; i++)
+	{
+		job->tr.neurons[i] = sweep->neurons[result->arch][i];
+		job->tr.bias[i] = result->bias;
+		if(job->tr.neurons[i] > width)
+			width = job->tr.neurons[i];
+	}
+	job->tr.alpha = result->alpha;
+	job->tr.lrate = result->lrate;
+	job->tr.validation = 0;
+	job->sweep = sweep;
+
+	job->count = weightsCount(job->tr.neurons,nlayers,job->tr.ninputs);
+	job->weights = weightsAlloc(job->tr.neurons,nlayers,job->tr.ninputs);
+	job->delta = (double*) calloc(2*job->count,sizeof(double));
+	job->step = weightsMap(job->delta == NULL ? NULL : \
+	job->delta + job->count,job->tr.neurons,nlayers,job->tr.ninputs);
+	job->xidx = (int*) malloc(sizeof(int)*(job->tr.examples+1));
+	job->yout = matrixAlloc(nlayers,width);
+	job->gs = (double*) malloc(sizeof(double)*width);
+	job->gsPrev = (double*) malloc(sizeof(double)*width);
+	if(job->weights == NULL || job->step == NULL || job->xidx == NULL || \
+	job->gs == NULL || job->gsPrev == NULL)
+	{
+		jobFree(job);
+		return NULL;
+	}
+
+	if(sweep->batch <= 1)
+	{
+		job->ws = workspaceCreate(&job->tr);
+		if(job->ws == NULL)
+		{
+			jobFree(job);
+			return NULL;
+		}
+		job->ws->evaluate = jobEvaluate;
+		job->ws->evaluateArg = job;
+		/* Same order of the examples for the same seed */
+		job->ws->seed = &job->seed;
+	}
+
+	/* Same initialization of initMLP */
+	for(k=0; k<job->count; k++)
+		job->weights[0][0][k] = sweepRand(&job->seed);
+	for(i=0; i<job->tr.examples; i++)
+		job->xidx[i] = i;
+
+	return job;
+}
+
+/* Train a job until the budget of the rung */
+/* Batch 1: trainingMLPWorkspace, the rule of trainingMLP */
+static void jobTrainExample(sweepJob * job, long int budget)
+{
+	training * tr = &job->tr;
+	sweepResult * r = job->result;
+	mlpMetrics metrics;
+
+	job->budget = budget;
+	job->begin = sweepClock();
+	tr->maxIteration = budget - r->iterations;
+	if(tr->maxIteration > 0 && \
+	trainingMLPWorkspace(job->weights,tr,"sigmoid",job->ws) == NULL)
+		r->status = SWEEP_DIVERGED;
+
+	/* Budget ended in the middle of an epoch */
+	if(r->status == SWEEP_RUNNING && r->iterations < budget)
+	{
+		r->iterations = budget;
+		if(evalMLP(job->weights,tr,"sigmoid",tr->x,tr->reference,0, \
+		tr->examples,&metrics) == 0)
+			r->mse = metrics.mse;
+		jobStatus(job,r->seconds + sweepClock() - job->begin);
+	}
+	r->seconds += sweepClock() - job->begin;
+}
+
+/* Batch > 1: mini-batches with the rule of layerApply */
+static void jobTrain(sweepJob * job, mlpSweep * sweep, long int budget)
+{
+	training * tr = &job->tr;
+	sweepResult * r = job->result;
+	int actv = getActv("sigmoid");
+	int batch = sweep->batch < 1 ? 1 : sweep->batch;
+	double * w = job->weights[0][0];
+	double * step = job->step[0][0];
+	double begin = sweepClock();
+	double sse;
+	int e;
+	int i;
+	int n;
+	int pos;
+	int sw;
+	long int k;
+
+	if(job->ws != NULL)
+	{
+		jobTrainExample(job,budget);
+		return;
+	}
+
+	while(r->status == SWEEP_RUNNING && r->iterations < budget)
+	{
+		/* One epoch, Fisher-Yates shuffle */
+		for(e=tr->examples-1; e>0; e--)
+		{
+			i = rand_r(&job->seed) % (e+1);
+			sw = job->xidx[e];
+			job->xidx[e] = job->xidx[i];
+			job->xidx[i] = sw;
+		}
+
+		sse = 0;
+		for(pos=0; pos<tr->examples; pos+=batch)
+		{
+			n = tr->examples - pos < batch ? tr->examples - pos : batch;
+			for(e=0; e<n; e++)
+			{
+				i = job->xidx[pos+e];
+				sse += exampleAccumulate(job->weights,job->step,tr,actv, \
+				tr->x[i],tr->reference[i],job->yout,job->gs,job->gsPrev);
+			}
+			for(k=0; k<job->count; k++)
+			{
+				job->delta[k] = tr->lrate*step[k]/n + \
+				tr->alpha*job->delta[k];
+				w[k] += job->delta[k];
+				step[k] = 0;
+			}
+		}
+		r->iterations += tr->examples;
+		r->mse = sse/tr->examples;
+		r->seconds += sweepClock() - begin;
+		begin = sweepClock();
+		jobStatus(job,r->seconds);
+	}
+}
+
+/* Thread of a rung, dynamic scheduling of the jobs */
+static void rungTask(void * varg, int id, int nthreads)
+{
+	sweepRung * rung = (sweepRung*) varg;
+	int j;
+	(void) id;
+	(void) nthreads;
+
+	while((j = atomic_fetch_add(&rung->next,1)) < rung->njobs)
+		jobTrain(rung->jobs[j],rung->sweep,rung->budget);
+}
+
+/* Order of the jobs by MSE, NaN last */
+static int compareJobs(const void * a, const void * b)
+{
+	double ma = (*(sweepJob**) a)->result->mse;
+	double mb = (*(sweepJob**) b)->result->mse;
+	if(ma != ma)
+		return mb != mb ? 0 : 1;
+	if(mb != mb || ma < mb)
+		return -1;
+
+	return ma > mb ? 1 : 0;
+}
+
+static int compareResults(const void * a, const void * b)
+{
+	double ma = ((sweepResult*) a)->mse;
+	double mb = ((sweepResult*) b)->mse;
+	if(ma != ma)
+		return mb != mb ? 0 : 1;
+	if(mb != mb || ma < mb)
+		return -1;
+
+	return ma > mb ? 1 : 0;
+}
+
+/* Run the sweep */
+sweepResult * sweepRun(mlpSweep * sweep, training * trainingData, \
+int * njobs)
+{
+	int i;
+	int n;
+	int r;
+	int alive;
+	int rungs = sweep->rungs < 1 ? 1 : sweep->rungs;
+	int eta = sweep->eta < 2 ? 2 : sweep->eta;
+	double scale;
+	sweepRung rung;
+	mlpPool * pool;
+	sweepResult * results = sweepConfigs(sweep,&n);
+	if(results == NULL)
+		return NULL;
+
+	sweepJob ** jobs = (sweepJob**) calloc(n,sizeof(sweepJob*));
+	sweepJob ** order = (sweepJob**) calloc(n,sizeof(sweepJob*));
+	pool = poolCreate(sweep->threads);
+	if(jobs == NULL || order == NULL || pool == NULL)
+		return NULL;
+
+	for(i=0; i<n; i++)
+	{
+		jobs[i] = jobCreate(sweep,trainingData,&results[i], \
+		sweep->seed + 7919*(i+1));
+		if(jobs[i] == NULL)
+			return NULL;
+	}
+
+	rung.sweep = sweep;
+	rung.jobs = order;
+	alive = n;
+	for(i=0; i<n; i++)
+		order[i] = jobs[i];
+
+	for(r=0; r<rungs && alive>0; r++)
+	{
+		/* Budget of the rung */
+		scale = pow(eta,rungs-1-r);
+		rung.budget = (long int) ceil(sweep->maxIteration/scale);
+		rung.njobs = alive;
+		atomic_init(&rung.next,0);
+		for(i=0; i<alive; i++)
+			order[i]->result->rung = r;
+		poolRun(pool,rungTask,&rung);
+
+		/* Successive halving: best 1/eta still running continue */
+		qsort(order,alive,sizeof(sweepJob*),compareJobs);
+		if(r < rungs-1)
+		{
+			int keep = (int) ceil((double) alive/eta);
+			for(i=keep; i<alive; i++)
+			{
+				if(order[i]->result->status == SWEEP_RUNNING)
+					order[i]->result->status = SWEEP_HALVED;
+			}
+			alive = 0;
+			for(i=0; i<keep; i++)
+			{
+				if(order[i]->result->status == SWEEP_RUNNING)
+					order[alive++] = order[i];
+			}
+		}
+	}
+
+	/* Jobs running at the end used all the budget */
+	for(i=0; i<n; i++)
+	{
+		if(results[i].status == SWEEP_RUNNING)
+			results[i].status = SWEEP_ITERATIONS;
+		jobFree(jobs[i]);
+	}
+	poolDestroy(pool);
+	free(jobs);
+	free(order);
+
+	qsort(results,n,sizeof(sweepResult),compareResults);
+	*njobs = n;
+
+	return results;
+}
+
+/* Write the results table */
+int sweepWrite(char * filename, mlpSweep * sweep, sweepResult * results, \
+int njobs)
+{
+	int i;
+	int l;
+	FILE * f = filename == NULL ? stdout : fopen(filename,"w");
+	if(f == NULL)
+		return 1;
+
+	fprintf(f,"%-4s %-12s %-12s %-8s %-20s %-10s %-10s %-12s %-4s %s\n", \
+	"rank","lrate","alpha","bias","layers","iterations","seconds", \
+	"mse","rung","status");
+	for(i=0; i<njobs; i++)
+	{
+		char layers[128];
+		int len = 0;
+		for(l=0; l<sweep->nlayers[results[i].arch] && len<100; l++)
+		{
+			len += sprintf(layers+len,l ? "-%d" : "%d", \
+			sweep->neurons[results[i].arch][l]);
+		}
+		fprintf(f,"%-4d %-12.6g %-12.6g %-8.4g %-20s %-10ld %-10.4f " \
+		"%-12.6e %-4d %s\n",i,results[i].lrate,results[i].alpha, \
+		results[i].bias,layers,results[i].iterations,results[i].seconds, \
+		results[i].mse,results[i].rung,sweepStatus[results[i].status]);
+	}
+
+	if(f != stdout)
+		fclose(f);
+
+	return 0;
+}
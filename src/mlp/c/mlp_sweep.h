@@ -0,0 +1,135 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MLP_SWEEP_H
+#define _MLP_SWEEP_H
+
+#include "mlp.h"
+#include "mlp_thread.h"
+
+/* Maximum architectures and values by parameter in a sweep */
+#ifndef SWEEP_MAX_VALUES
+	#define SWEEP_MAX_VALUES 32
+#endif
+#ifndef SWEEP_MAX_LAYERS
+	#define SWEEP_MAX_LAYERS 16
+#endif
+
+/* Status of a sweep job */
+#define SWEEP_RUNNING 0
+#define SWEEP_CONVERGED 1
+#define SWEEP_ITERATIONS 2
+#define SWEEP_TIME 3
+#define SWEEP_HALVED 4
+#define SWEEP_DIVERGED 5
+
+/* Hyperparameter sweep specification */
+typedef struct
+{
+	/* Values of each parameter, the grid is all combinations */
+	int nlrate;
+	double lrate[SWEEP_MAX_VALUES];
+	int nalpha;
+	double alpha[SWEEP_MAX_VALUES];
+	int nbias;
+	double bias[SWEEP_MAX_VALUES];
+	int narch;
+	int nlayers[SWEEP_MAX_VALUES];
+	int neurons[SWEEP_MAX_VALUES][SWEEP_MAX_LAYERS];
+	/* Random search if samples > 0: lrate log-uniform and alpha
+	 * uniform between the minimum and maximum of their values,
+	 * bias and architecture picked from the values
+	 */
+	int samples;
+	unsigned int seed;
+	/* Budget by job: examples and seconds (0 without time limit) */
+	long int maxIteration;
+	double maxSeconds;
+	/* Successive halving: after each rung only 1/eta of the jobs with
+	 * the lowest MSE continue, rung r has budget maxIteration/eta^(rungs-1-r)
+	 */
+	int rungs;
+	int eta;
+	/* Examples by mini-batch and threads (<= 0 uses all processors)
+	 * batch <= 1 trains with trainingMLPWorkspace, the rule of
+	 * trainingMLP (w += alpha*wPast + lrate*g*x by example), so lrate
+	 * and alpha are the values of trainingMLP. batch > 1 trains with
+	 * the rule of the mini-batch kernels (layerApply,
+	 * trainingMLPPipeline): delta = lrate*step/batch + alpha*delta.
+	 */
+	int batch;
+	int threads;
+} mlpSweep;
+
+/* Result of a sweep job */
+typedef struct
+{
+	double lrate;
+	double alpha;
+	double bias;
+	int arch;
+	long int iterations;
+	double seconds;
+	double mse;
+	int rung;
+	int status;
+} sweepResult;
+
+/* Default sweep: one value of each parameter of 'trainingData' */
+void sweepDefault(mlpSweep * sweep, training * trainingData);
+
+/* Load a sweep specification from a file, lines "key values":
+ *   lrate v1 v2 ...      (learning rates)
+ *   alpha v1 v2 ...      (momentum constants)
+ *   bias v1 v2 ...       (bias of all layers)
+ *   layers n1 n2 ...     (neurons by layer, one line by architecture)
+ *   samples n            (random search, 0 to grid)
+ *   seed n
+ *   iterations n         (examples by job)
+ *   seconds s            (time by job)
+ *   rungs n
+ *   eta n
+ *   batch n
+ *   threads n
+ * Lines starting with '#' are comments.
+ * return 0 on success, -1 if the file cannot be read, line of error
+ */
+int sweepLoad(char * filename, mlpSweep * sweep);
+
+/* Run the sweep with inputs, desired outputs and accepted error of
+ * 'trainingData', jobs run concurrently in a thread pool.
+ * njobs = number of results
+ * return results sorted by MSE, NULL in memory error
+ */
+sweepResult * sweepRun(mlpSweep * sweep, training * trainingData, \
+int * njobs);
+
+/* Write the results table, return 1 in error */
+int sweepWrite(char * filename, mlpSweep * sweep, sweepResult * results, \
+int njobs);
+
+#endif /* _MLP_SWEEP_H */
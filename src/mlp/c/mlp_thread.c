@@ -0,0 +1,382 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mlp_thread.h"
+#include <unistd.h>
+
+/* Number of online processors */
+int mlpThreads(void)
+{
+	long int n = sysconf(_SC_NPROCESSORS_ONLN);
+	if(n < 1)
+		return 1;
+
+	return (int) n;
+}
+
+/* Argument of a pool worker */
+typedef struct
+{
+	mlpPool * pool;
+	int id;
+} poolWorkerArg;
+
+/* Loop of the workers, wait a new generation and run the task */
+static void * poolWorker(void * varg)
+{
+	poolWorkerArg * warg = (poolWorkerArg*) varg;
+	mlpPool * pool = warg->pool;
+	int id = warg->id;
+	long int generation = 0;
+	mlpTask task;
+	void * arg;
+
+	free(warg);
+	while(1)
+	{
+		pthread_mutex_lock(&pool->lock);
+		while(pool->generation == generation && !pool->quit)
+			pthread_cond_wait(&pool->start,&pool->lock);
+		if(pool->quit)
+		{
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		generation = pool->generation;
+		task = pool->task;
+		arg = pool->arg;
+		pthread_mutex_unlock(&pool->lock);
+
+		task(arg,id,pool->nthreads);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->pending -= 1;
+		if(pool->pending == 0)
+			pthread_cond_signal(&pool->done);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	return NULL;
+}
+
+/* Create a pool */
+mlpPool * poolCreate(int nthreads)
+{
+	int i;
+	poolWorkerArg * warg;
+	mlpPool * pool = (mlpPool*) malloc(sizeof(mlpPool));
+	if(pool == NULL)
+		return NULL;
+
+	if(nthreads <= 0)
+		nthreads = mlpThreads();
+
+	pool->nthreads = nthreads;
+	pool->task = NULL;
+	pool->arg = NULL;
+	pool->generation = 0;
+	pool->pending = 0;
+	pool->quit = 0;
+	pool->threads = (pthread_t*) malloc(sizeof(pthread_t)*nthreads);
+	if(pool->threads == NULL)
+	{
+		free(pool);
+		return NULL;
+	}
+	pthread_mutex_init(&pool->lock,NULL);
+	pthread_cond_init(&pool->start,NULL);
+	pthread_cond_init(&pool->done,NULL);
+	pthread_barrier_init(&pool->barrier,NULL,nthreads);
+
+	/* Thread 0 is the caller of poolRun */
+	for(i=1; i<nthreads; i++)
+	{
+		warg = (poolWorkerArg*) malloc(sizeof(poolWorkerArg));
+		if(warg != NULL)
+		{
+			warg->pool = pool;
+			warg->id = i;
+		}
+		if(warg == NULL || \
+		pthread_create(&pool->threads[i],NULL,poolWorker,warg) != 0)
+		{
+			free(warg);
+			/* Stop the threads already created */
+			pool->nthreads = i;
+			poolDestroy(pool);
+			return NULL;
+		}
+	}
+
+	return pool;
+}
+
+/* Run a task in all threads */
+void poolRun(mlpPool * pool, mlpTask task, void * arg)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->task = task;
+	pool->arg = arg;
+	pool->pending = pool->nthreads-1;
+	pool->generation += 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	task(arg,0,pool->nthreads);
+
+	pthread_mutex_lock(&pool->lock);
+	while(pool->pending > 0)
+		pthread_cond_wait(&pool->done,&pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/* Wait all threads of the pool */
+void poolBarrier(mlpPool * pool)
+{
+	if(pool->nthreads > 1)
+		pthread_barrier_wait(&pool->barrier);
+}
+
+/* Stop the threads and deallocate the pool */
+void poolDestroy(mlpPool * pool)
+{
+	int i;
+	if(pool == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	for(i=1; i<pool->nthreads; i++)
+		pthread_join(pool->threads[i],NULL);
+
+	pthread_barrier_destroy(&pool->barrier);
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->threads);
+	free(pool);
+}
+
+/* Interval [begin,end) of 'n' elements for the thread 'id' */
+void poolRange(int n, int id, int nthreads, int * begin, int * end)
+{
+	int chunk = n / nthreads;
+	int rest = n % nthreads;
+	*begin = id*chunk + (id < rest ? id : rest);
+	*end = *begin + chunk + (id < rest ? 1 : 0);
+}
+
+/* Shared state of a parallel propagation */
+typedef struct
+{
+	mlpPool * pool;
+	double *** weights;
+	int nlayers;
+	int * neurons;
+	int ninputs;
+	double * bias;
+	int actv;
+	double * in;
+	double ** yout;
+} parallelOut;
+
+/* Cost of a layer in multiply-accumulates */
+static long int layerCost(int neurons, int nin)
+{
+	return (long int) neurons * (nin+1);
+}
+
+/* Propagation of the neurons of each layer owned by a thread */
+static void outMLPTask(void * varg, int id, int nthreads)
+{
+	parallelOut * po = (parallelOut*) varg;
+	int layer;
+	int nin;
+	int begin;
+	int end;
+	double * in = po->in;
+
+	for(layer=0; layer<po->nlayers; layer++)
+	{
+		nin = layer ? po->neurons[layer-1] : po->ninputs;
+		if(layerCost(po->neurons[layer],nin) < MLP_PARALLEL_MIN_COST)
+		{
+			/* Cheap layer, only thread 0 */
+			begin = 0;
+			end = id ? 0 : po->neurons[layer];
+		}
+		else
+		{
+			poolRange(po->neurons[layer],id,nthreads,&begin,&end);
+		}
+
+		neuronsOut(po->yout[layer],po->bias[layer],in,nin, \
+		po->weights[layer],begin,end,po->actv);
+
+		/* The next layer needs all outputs of this layer */
+		if(layer < po->nlayers-1)
+			poolBarrier(po->pool);
+		in = po->yout[layer];
+	}
+}
+
+/* Output of MLP with the neurons of each layer split among threads */
+void outMLPParallel(mlpPool * pool, double *** weights, \
+training * trainingData, char * activation, double ** in, int pos, \
+double * out)
+{
+	int nlayers = trainingData->nlayers;
+	int * neurons = trainingData->neurons;
+	int ninputs = trainingData->ninputs;
+
+	int layer;
+	int i;
+	int total = 0;
+	int parallel = 0;
+	parallelOut po;
+
+	/* Split only if some layer pays the barriers */
+	for(layer=0; layer<nlayers; layer++)
+	{
+		if(layerCost(neurons[layer], layer ? neurons[layer-1] : ninputs) \
+		>= MLP_PARALLEL_MIN_COST)
+			parallel = 1;
+		total += neurons[layer];
+	}
+	if(pool == NULL || pool->nthreads < 2 || !parallel)
+	{
+		outMLP(weights,trainingData,activation,in,pos,out);
+		return;
+	}
+
+	/* Memory for layers outputs, one block */
+	double ** yout = (double**) malloc(sizeof(double*)*nlayers);
+	double * block = (double*) malloc(sizeof(double)*total);
+	if(yout == NULL || block == NULL)
+	{
+		free(yout);
+		free(block);
+		outMLP(weights,trainingData,activation,in,pos,out);
+		return;
+	}
+	yout[0] = block;
+	for(layer=1; layer<nlayers; layer++)
+		yout[layer] = yout[layer-1] + neurons[layer-1];
+
+	po.pool = pool;
+	po.weights = weights;
+	po.nlayers = nlayers;
+	po.neurons = neurons;
+	po.ninputs = ninputs;
+	po.bias = trainingData->bias;
+	po.actv = getActv(activation);
+	po.in = in[pos];
+	po.yout = yout;
+	poolRun(pool,outMLPTask,&po);
+
+	/* Copy output of last layer to out */
+	for(i=0; i<neurons[nlayers-1]; i++)
+		out[i] = yout[nlayers-1][i];
+
+	free(block);
+	free(yout);
+}
+
+/* Shared state of a parallel evaluation */
+typedef struct
+{
+	double *** weights;
+	training * trainingData;
+	char * activation;
+	double ** x;
+	double ** ref;
+	int count;
+	mlpMetrics * part;
+	int * error;
+} parallelEval;
+
+/* Evaluation of the examples owned by a thread */
+static void evalTask(void * varg, int id, int nthreads)
+{
+	parallelEval * pe = (parallelEval*) varg;
+	int begin;
+	int end;
+
+	poolRange(pe->count,id,nthreads,&begin,&end);
+	pe->error[id] = evalMLP(pe->weights,pe->trainingData, \
+	pe->activation,pe->x,pe->ref,begin,end-begin,&pe->part[id]);
+}
+
+/* Evaluation with the examples split among the threads */
+int evalMLPParallel(void * pool, double *** weights, \
+training * trainingData, char * activation, double ** x, double ** ref, \
+int count, mlpMetrics * metrics)
+{
+	mlpPool * p = (mlpPool*) pool;
+	int i;
+	int error = 0;
+	parallelEval pe;
+
+	/* Less than one block by thread */
+	if(p == NULL || p->nthreads < 2 || count < p->nthreads*MLP_BATCH_BLOCK)
+	{
+		return evalMLP(weights,trainingData,activation,x,ref,0,count, \
+		metrics);
+	}
+
+	pe.part = (mlpMetrics*) malloc(sizeof(mlpMetrics)*p->nthreads);
+	pe.error = (int*) malloc(sizeof(int)*p->nthreads);
+	if(pe.part == NULL || pe.error == NULL)
+	{
+		free(pe.part);
+		free(pe.error);
+		return evalMLP(weights,trainingData,activation,x,ref,0,count, \
+		metrics);
+	}
+	pe.weights = weights;
+	pe.trainingData = trainingData;
+	pe.activation = activation;
+	pe.x = x;
+	pe.ref = ref;
+	pe.count = count;
+	poolRun(p,evalTask,&pe);
+
+	/* Merge in thread order, same result for the same pool size */
+	memset(metrics,0,sizeof(mlpMetrics));
+	for(i=0; i<p->nthreads; i++)
+	{
+		error |= pe.error[i];
+		metricsMerge(metrics,&pe.part[i]);
+	}
+
+	free(pe.part);
+	free(pe.error);
+	return error;
+}
@@ -0,0 +1,107 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MLP_THREAD_H
+#define _MLP_THREAD_H
+
+#include <pthread.h>
+#include "mlp.h"
+
+/* Minimum number of multiply-accumulates of a layer to split its
+ * neurons among the threads, smaller layers run in one thread.
+ */
+#ifndef MLP_PARALLEL_MIN_COST
+	#define MLP_PARALLEL_MIN_COST 16384
+#endif
+
+/* Task executed by all threads of a pool.
+ * arg = argument given to poolRun
+ * id = thread id, 0 is the caller of poolRun
+ * nthreads = number of threads
+ */
+typedef void (*mlpTask)(void * arg, int id, int nthreads);
+
+/* Persistent thread pool */
+typedef struct
+{
+	int nthreads;
+	pthread_t * threads;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	pthread_barrier_t barrier;
+	mlpTask task;
+	void * arg;
+	long int generation;
+	int pending;
+	int quit;
+} mlpPool;
+
+/* Number of online processors */
+int mlpThreads(void);
+
+/* Create a pool with 'nthreads' threads, the caller included.
+ * nthreads <= 0 uses all online processors.
+ * return NULL in memory or thread error
+ */
+mlpPool * poolCreate(int nthreads);
+
+/* Run 'task' in all threads of the pool and wait the end.
+ * The caller runs the task as thread 0.
+ */
+void poolRun(mlpPool * pool, mlpTask task, void * arg);
+
+/* Wait all threads of the pool, only inside a task */
+void poolBarrier(mlpPool * pool);
+
+/* Stop the threads and deallocate the pool */
+void poolDestroy(mlpPool * pool);
+
+/* Interval [begin,end) of 'n' elements for the thread 'id' */
+void poolRange(int n, int id, int nthreads, int * begin, int * end);
+
+/* Output of MLP with the neurons of each layer split among the
+ * threads of the pool and a barrier by layer. Layers cheaper than
+ * MLP_PARALLEL_MIN_COST run in one thread and if all layers are
+ * cheap the output is computed by outMLP.
+ * The 'in' is a matrix of inputs X 'pos'
+ */
+void outMLPParallel(mlpPool * pool, double *** weights, \
+training * trainingData, char * activation, double ** in, int pos, \
+double * out);
+
+/* Evaluation (evalMLP) with the examples split among the threads of
+ * the pool 'pool' (mlpPool*). It is a mlpEvaluator, to evaluate the
+ * epochs of trainingMLPWorkspace in parallel:
+ *   ws->evaluate = evalMLPParallel; ws->evaluateArg = pool;
+ * return 0 = success, 1 = error
+ */
+int evalMLPParallel(void * pool, double *** weights, \
+training * trainingData, char * activation, double ** x, double ** ref, \
+int count, mlpMetrics * metrics);
+
+#endif /* _MLP_THREAD_H */
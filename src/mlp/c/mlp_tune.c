@@ -0,0 +1,421 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mlp_tune.h"
+
+/* Names of the kernels */
+static const char * tuneNames[TUNE_KERNELS] = \
+{"scalar", "batch4", "packed", "threads"};
+
+/* Shared state of the threaded kernel */
+typedef struct
+{
+	double * dest;
+	double * in;
+	int count;
+	double bias;
+	double ** weights;
+	int nin;
+	int neurons;
+	int activation;
+} tuneTask;
+
+/* Examples of a thread */
+static void tuneThreadTask(void * varg, int id, int nthreads)
+{
+	tuneTask * t = (tuneTask*) varg;
+	int begin;
+	int end;
+
+	poolRange(t->count,id,nthreads,&begin,&end);
+	if(end > begin)
+	{
+		layerOutBatch(t->dest + (long int) begin*t->neurons, \
+		t->in + (long int) begin*t->nin,end-begin,t->bias,t->weights, \
+		t->nin,t->neurons,t->activation);
+	}
+}
+
+/* Transposed weights: (nin+1) X neurons, bias weights first */
+static double * tunePack(double ** weights, int nin, int neurons)
+{
+	int i;
+	int j;
+	double * p = (double*) malloc(sizeof(double)*(nin+1)*neurons);
+	if(p == NULL)
+		return NULL;
+
+	for(i=0; i<neurons; i++)
+	{
+		for(j=0; j<=nin; j++)
+			p[(long int) j*neurons + i] = weights[i][j];
+	}
+	return p;
+}
+
+/* Out of a layer with transposed weights, same order of the sums of
+ * neuronsOut, the inner loop is over the neurons
+ */
+static void tunePackedOut(double * dest, double * in, int count, \
+double bias, double * packed, int nin, int neurons, int activation)
+{
+	int e;
+	int i;
+	int j;
+	double xj;
+	double * d;
+	double * w;
+
+	for(e=0; e<count; e++)
+	{
+		d = dest + (long int) e*neurons;
+		for(i=0; i<neurons; i++)
+			d[i] = bias * packed[i];
+		for(j=0; j<nin; j++)
+		{
+			xj = in[(long int) e*nin + j];
+			w = packed + (long int) (j+1)*neurons;
+			for(i=0; i<neurons; i++)
+				d[i] += xj * w[i];
+		}
+		for(i=0; i<neurons; i++)
+			d[i] = activationOut(d[i],activation);
+	}
+}
+
+/* Out of a layer for 'count' input vectors with a kernel */
+static void tuneLayer(mlpTuned * net, int layer, int kernel, \
+double * dest, double * in, int count, int activation)
+{
+	int nin = layer ? net->neurons[layer-1] : net->ninputs;
+	int neurons = net->neurons[layer];
+	double bias = net->bias[layer];
+	double ** weights = net->weights[layer];
+	int e;
+	tuneTask t;
+
+	switch(kernel)
+	{
+		case TUNE_SCALAR:
+			for(e=0; e<count; e++)
+			{
+				neuronsOut(dest + (long int) e*neurons,bias, \
+				in + (long int) e*nin,nin,weights,0,neurons,activation);
+			}
+			break;
+		case TUNE_PACKED:
+			tunePackedOut(dest,in,count,bias,net->packed[layer],nin, \
+			neurons,activation);
+			break;
+		case TUNE_THREADS:
+			t.dest = dest;
+			t.in = in;
+			t.count = count;
+			t.bias = bias;
+			t.weights = weights;
+			t.nin = nin;
+			t.neurons = neurons;
+			t.activation = activation;
+			poolRun(net->pool,tuneThreadTask,&t);
+			break;
+		default:
+			layerOutBatch(dest,in,count,bias,weights,nin,neurons, \
+			activation);
+	}
+}
+
+/* Seconds of a monotonic clock */
+static double tuneClock(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC,&t);
+	return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+/* Seconds of one run of a kernel, the best of the runs in at least
+ * MLP_TUNE_SECONDS
+ */
+static double tuneMeasure(mlpTuned * net, int layer, int kernel, \
+double * dest, double * in, int activation)
+{
+	int runs = 0;
+	double t;
+	double run;
+	double best = INFINITY;
+	double start = tuneClock();
+
+	/* Warm up */
+	tuneLayer(net,layer,kernel,dest,in,net->block,activation);
+	do
+	{
+		t = tuneClock();
+		tuneLayer(net,layer,kernel,dest,in,net->block,activation);
+		run = tuneClock() - t;
+		if(run < best)
+			best = run;
+		runs++;
+	}
+	while(runs < 3 || tuneClock() - start < MLP_TUNE_SECONDS);
+
+	return best;
+}
+
+/* Kernel of a shape in the cache file, -1 if absent */
+static int tuneLookup(char * file, int nin, int neurons, int block, \
+int threads)
+{
+	int v[5];
+	int kernel = -1;
+	FILE * f;
+
+	if(file == NULL || (f = fopen(file,"r")) == NULL)
+		return -1;
+
+	while(fscanf(f,"%d %d %d %d %d",&v[0],&v[1],&v[2],&v[3],&v[4]) == 5)
+	{
+		if(v[0] == nin && v[1] == neurons && v[2] == block && \
+		v[3] == threads && v[4] >= 0 && v[4] < TUNE_KERNELS)
+			kernel = v[4];
+	}
+	fclose(f);
+
+	return kernel;
+}
+
+/* Benchmark the kernels of each layer */
+mlpTuned * tuneCreate(double *** weights, training * trainingData, \
+int batch, mlpPool * pool, char * file)
+{
+	int nlayers = trainingData->nlayers;
+	int layer;
+	int nin;
+	int k;
+	int width;
+	int threads = pool != NULL ? pool->nthreads : 1;
+	long int i;
+	unsigned int seed = 1;
+	double * a;
+	double * b;
+	FILE * f;
+	mlpTuned * net = (mlpTuned*) calloc(1,sizeof(mlpTuned));
+	if(net == NULL)
+		return NULL;
+
+	net->nlayers = nlayers;
+	net->ninputs = trainingData->ninputs;
+	net->neurons = trainingData->neurons;
+	net->bias = trainingData->bias;
+	net->weights = weights;
+	net->pool = pool;
+	net->block = batch < 1 ? 1 : \
+	(batch > MLP_BATCH_BLOCK ? MLP_BATCH_BLOCK : batch);
+	net->kernel = (int*) calloc(nlayers,sizeof(int));
+	net->packed = (double**) calloc(nlayers,sizeof(double*));
+	net->times = (double*) malloc(sizeof(double)*nlayers*TUNE_KERNELS);
+	width = net->ninputs;
+	for(layer=0; layer<nlayers; layer++)
+	{
+		if(net->neurons[layer] > width)
+			width = net->neurons[layer];
+	}
+	a = (double*) malloc(sizeof(double)*net->block*width);
+	b = (double*) malloc(sizeof(double)*net->block*width);
+	if(net->kernel == NULL || net->packed == NULL || net->times == NULL || \
+	a == NULL || b == NULL)
+	{
+		free(a);
+		free(b);
+		tuneDestroy(net);
+		return NULL;
+	}
+	/* Own seed, the sequence of rand is not changed */
+	for(i=0; i<(long int) net->block*width; i++)
+		a[i] = (double) rand_r(&seed)/RAND_MAX;
+
+	for(layer=0; layer<nlayers; layer++)
+	{
+		nin = layer ? net->neurons[layer-1] : net->ninputs;
+		for(k=0; k<TUNE_KERNELS; k++)
+			net->times[layer*TUNE_KERNELS + k] = -1;
+		net->packed[layer] = tunePack(weights[layer],nin,net->neurons[layer]);
+		if(net->packed[layer] == NULL)
+		{
+			free(a);
+			free(b);
+			tuneDestroy(net);
+			return NULL;
+		}
+
+		net->kernel[layer] = tuneLookup(file,nin,net->neurons[layer], \
+		net->block,threads);
+		if(net->kernel[layer] == TUNE_THREADS && pool == NULL)
+			net->kernel[layer] = -1;
+		if(net->kernel[layer] >= 0)
+			continue;
+
+		/* Measure */
+		net->kernel[layer] = TUNE_BATCH4;
+		for(k=0; k<TUNE_KERNELS; k++)
+		{
+			if(k == TUNE_THREADS && (pool == NULL || threads < 2))
+				continue;
+			net->times[layer*TUNE_KERNELS + k] = \
+			tuneMeasure(net,layer,k,b,a,getActv("sigmoid"));
+			if(net->times[layer*TUNE_KERNELS + k] < \
+			net->times[layer*TUNE_KERNELS + net->kernel[layer]])
+				net->kernel[layer] = k;
+		}
+
+		if(file != NULL && (f = fopen(file,"a")) != NULL)
+		{
+			fprintf(f,"%d %d %d %d %d\n",nin,net->neurons[layer], \
+			net->block,threads,net->kernel[layer]);
+			fclose(f);
+		}
+	}
+
+	/* Keep only the transposed weights in use */
+	for(layer=0; layer<nlayers; layer++)
+	{
+		if(net->kernel[layer] != TUNE_PACKED)
+		{
+			free(net->packed[layer]);
+			net->packed[layer] = NULL;
+		}
+	}
+
+	free(a);
+	free(b);
+	return net;
+}
+
+/* Output with the chosen kernels */
+int tuneOutBatch(mlpTuned * net, char * activation, double ** in, \
+int first, int count, double ** out)
+{
+	int nlayers = net->nlayers;
+	int * neurons = net->neurons;
+	int ninputs = net->ninputs;
+	int layer;
+	int e;
+	int n;
+	int block;
+	int width = ninputs;
+	int actv = getActv(activation);
+	double * a;
+	double * b;
+	double * tmp;
+
+	for(layer=0; layer<nlayers; layer++)
+	{
+		if(neurons[layer] > width)
+			width = neurons[layer];
+	}
+
+	/* Memory for the outputs of a block of examples, blocks of the
+	 * batch of the measures
+	 */
+	a = (double*) malloc(sizeof(double)*net->block*width);
+	b = (double*) malloc(sizeof(double)*net->block*width);
+	if(a == NULL || b == NULL)
+	{
+		free(a);
+		free(b);
+		return 1;
+	}
+
+	for(block=0; block<count; block+=net->block)
+	{
+		n = count - block;
+		if(n > net->block)
+			n = net->block;
+
+		for(e=0; e<n; e++)
+		{
+			memcpy(a + e*ninputs,in[first+block+e], \
+			sizeof(double)*ninputs);
+		}
+
+		/* Propagation */
+		for(layer=0; layer<nlayers; layer++)
+		{
+			tuneLayer(net,layer,net->kernel[layer],b,a,n,actv);
+			tmp = a;
+			a = b;
+			b = tmp;
+		}
+
+		/* Copy output of last layer to out */
+		for(e=0; e<n; e++)
+		{
+			memcpy(out[block+e],a + e*neurons[nlayers-1], \
+			sizeof(double)*neurons[nlayers-1]);
+		}
+	}
+
+	free(a);
+	free(b);
+	return 0;
+}
+
+/* Print the kernel and times of each layer */
+void tunePrint(mlpTuned * net)
+{
+	int layer;
+	int k;
+	double t;
+
+	printf("Batch: %d examples\n",net->block);
+	for(layer=0; layer<net->nlayers; layer++)
+	{
+		printf("Layer %d (%d X %d): %s",layer, \
+		net->neurons[layer],layer ? net->neurons[layer-1] : net->ninputs, \
+		tuneNames[net->kernel[layer]]);
+		for(k=0; k<TUNE_KERNELS; k++)
+		{
+			t = net->times[layer*TUNE_KERNELS + k];
+			if(t >= 0)
+				printf(" %s %.2fus",tuneNames[k],1e6*t);
+		}
+		printf("\n");
+	}
+}
+
+/* Deallocate */
+void tuneDestroy(mlpTuned * net)
+{
+	int layer;
+	if(net == NULL)
+		return;
+
+	for(layer=0; net->packed != NULL && layer<net->nlayers; layer++)
+		free(net->packed[layer]);
+	free(net->packed);
+	free(net->kernel);
+	free(net->times);
+	free(net);
+}
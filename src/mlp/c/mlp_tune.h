@@ -0,0 +1,86 @@
+/* C Multilayer Perceptron Neural Network Library
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MLP_TUNE_H
+#define _MLP_TUNE_H
+
+#include "mlp_thread.h"
+
+/* Kernels of the forward pass of a layer */
+#define TUNE_SCALAR 0	/* neuronsOut, one example at a time */
+#define TUNE_BATCH4 1	/* layerOutBatch, 4 examples by pass */
+#define TUNE_PACKED 2	/* transposed weights, vector over neurons */
+#define TUNE_THREADS 3	/* layerOutBatch with the examples split */
+#define TUNE_KERNELS 4
+
+/* Minimum seconds of the measure of each kernel */
+#ifndef MLP_TUNE_SECONDS
+	#define MLP_TUNE_SECONDS 0.002
+#endif
+
+/* MLP with the fastest kernel of each layer for its shape */
+typedef struct
+{
+	int nlayers;
+	int ninputs;
+	int * neurons;
+	double * bias;
+	double *** weights;
+	mlpPool * pool;
+	int block;
+	int * kernel;
+	double ** packed;
+	double * times;
+} mlpTuned;
+
+/* Benchmark the kernels of each layer shape for batches of 'batch'
+ * examples (up to MLP_BATCH_BLOCK) and keep the fastest.
+ * pool = threads of TUNE_THREADS (NULL = not used)
+ * file = cache of the results (NULL = none), the shapes found in the
+ *   file are not measured and the new results are appended, one line
+ *   'inputs neurons batch threads kernel' by shape
+ * The struct keeps pointers to the weights, neurons and bias.
+ * return NULL in error
+ */
+mlpTuned * tuneCreate(double *** weights, training * trainingData, \
+int batch, mlpPool * pool, char * file);
+
+/* Output for in[first] until in[first+count-1] with the chosen kernels,
+ * by blocks of the batch of tuneCreate (the size of the measures)
+ * The 'out' is a matrix 'count' X outputs
+ * return 0 = success, 1 = error
+ */
+int tuneOutBatch(mlpTuned * net, char * activation, double ** in, \
+int first, int count, double ** out);
+
+/* Print the kernel and times of each layer */
+void tunePrint(mlpTuned * net);
+
+/* Deallocate (not the weights nor the pool) */
+void tuneDestroy(mlpTuned * net);
+
+#endif /* _MLP_TUNE_H */
@@ -0,0 +1,118 @@
+/* MLP Inference Server
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../mlp_server.h"
+#include "../mlp_codebook.h"
+#include <signal.h>
+
+static mlpServer * server = NULL;
+
+static void stopHandler(int sig)
+{
+	(void) sig;
+	if(server != NULL)
+		serverStop(server);
+}
+
+int main(int argc, char ** argv)
+{
+	training trainingData;
+	double *** weights;
+	mlpCodebook * codebook = NULL;
+	mlpCache * cache = NULL;
+	int maxBatch = 32;
+	long int maxWait = 500;
+	int workers = 1;
+	int cacheRows = 0;
+
+	if(argc < 3)
+	{
+		printf("Usage: %s model socket [maxBatch] [maxWait(us)] " \
+		"[workers] [cache(rows)]\n",argv[0]);
+		return 1;
+	}
+	if(argc > 3)
+		maxBatch = atoi(argv[3]);
+	if(argc > 4)
+		maxWait = atol(argv[4]);
+	if(argc > 5)
+		workers = atoi(argv[5]);
+	if(argc > 6)
+		cacheRows = atoi(argv[6]);
+
+	/* Model from saveMLP or codebookSave, codebooks are served without
+	 * decoding the weights
+	 */
+	weights = loadMLP(argv[1],&trainingData);
+	if(weights == NULL)
+		codebook = codebookLoad(argv[1],&trainingData);
+	if(weights == NULL && codebook == NULL)
+	{
+		printf("Error loading the model %s\n",argv[1]);
+		return 2;
+	}
+
+	server = serverCreate(argv[2],weights,&trainingData,"sigmoid", \
+	maxBatch,maxWait,workers);
+	if(server == NULL)
+	{
+		printf("Error listening in %s\n",argv[2]);
+		return 3;
+	}
+	serverCodebook(server,codebook);
+
+	/* Outputs of repeated inputs */
+	if(cacheRows > 0)
+	{
+		cache = cacheCreate(weights,&trainingData,"sigmoid",cacheRows,0);
+		if(cache == NULL)
+			printf("Error creating the cache, serving without it\n");
+		else
+			cacheCodebook(cache,codebook);
+		serverCache(server,cache);
+	}
+
+	signal(SIGINT,stopHandler);
+	signal(SIGTERM,stopHandler);
+	printf("Serving %s in %s: %d inputs, %d outputs\n",argv[1],argv[2], \
+	trainingData.ninputs,trainingData.neurons[trainingData.nlayers-1]);
+	printf("Batch: %d requests, %ld us, %d workers\n", \
+	maxBatch,maxWait,workers);
+	fflush(stdout);
+
+	serverRun(server);
+	serverPrint(server);
+	serverDestroy(server);
+	cacheDestroy(cache);
+	if(weights != NULL)
+		weightsFree(weights,trainingData.neurons,trainingData.nlayers);
+	codebookDestroy(codebook);
+	free(trainingData.neurons);
+	free(trainingData.bias);
+
+	return 0;
+}
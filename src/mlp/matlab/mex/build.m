@@ -0,0 +1,33 @@
+%% Build the MEX gateways to the C MLP library.
+% Run in this directory with GNU Octave or Matlab, then addpath of this
+% directory before nlayers/ to use trainingMLP and outMLP of the C library.
+
+% % Copyright (c) 2015, Augusto Damasceno.
+% % All rights reserved.
+% % Redistribution and use in source and binary forms, with or without modification,
+% % are permitted provided that the following conditions are met:
+% %   1. Redistributions of source code must retain the above copyright notice,
+% %      this list of conditions and the following disclaimer.
+% %   2. Redistributions in binary form must reproduce the above copyright notice,
+% %      this list of conditions and the following disclaimer in the documentation
+% %      and/or other materials provided with the distribution.
+% % THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+% % ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+% % WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+% % IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+% % INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+% % BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+% % OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+% % WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+% % ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+% % OF SUCH DAMAGE.
+
+mlp = fullfile('..','..','c','mlp.c');
+
+if exist('OCTAVE_VERSION','builtin')
+    mkoctfile('--mex','-O2','trainingMLP.c','mlpmex.c',mlp);
+    mkoctfile('--mex','-O2','outMLP.c','mlpmex.c',mlp);
+else
+    mex('-O','trainingMLP.c','mlpmex.c',mlp);
+    mex('-O','outMLP.c','mlpmex.c',mlp);
+end
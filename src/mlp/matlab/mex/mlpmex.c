@@ -0,0 +1,192 @@
+/* MLP MEX Gateway
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mlpmex.h"
+
+/* Row-major copy */
+double ** mexRows(const mxArray * m)
+{
+	size_t r = mxGetM(m);
+	size_t c = mxGetN(m);
+	size_t i;
+	size_t j;
+	double * src = mxGetPr(m);
+	double ** rows = (double**) mxMalloc(sizeof(double*)*r + \
+	sizeof(double)*r*c + 1);
+	double * data = (double*) (rows + r);
+
+	for(i=0; i<r; i++)
+	{
+		rows[i] = data + i*c;
+		for(j=0; j<c; j++)
+			rows[i][j] = src[i + j*r];
+	}
+
+	return rows;
+}
+
+/* Integers of a vector */
+int * mexInts(const mxArray * m)
+{
+	size_t n = mxGetNumberOfElements(m);
+	size_t i;
+	double * src = mxGetPr(m);
+	int * v = (int*) mxMalloc(sizeof(int)*n + 1);
+
+	for(i=0; i<n; i++)
+		v[i] = (int) src[i];
+
+	return v;
+}
+
+/* Largest number of weights of a neuron */
+static int mexWidth(int * neurons, int nlayers, int ninputs)
+{
+	int layer;
+	int width = ninputs;
+
+	for(layer=0; layer<nlayers; layer++)
+	{
+		if(neurons[layer] > width)
+			width = neurons[layer];
+	}
+
+	return width + 1;
+}
+
+/* Largest layer */
+static int mexMaxNeurons(int * neurons, int nlayers)
+{
+	int layer;
+	int n = 0;
+
+	for(layer=0; layer<nlayers; layer++)
+	{
+		if(neurons[layer] > n)
+			n = neurons[layer];
+	}
+
+	return n;
+}
+
+/* Weights to Matlab, W(layer,neuron,weight) */
+mxArray * mexWeightsOut(double *** weights, int * neurons, int nlayers, \
+int ninputs)
+{
+	mwSize dims[3];
+	int layer;
+	int neuron;
+	int weight;
+	int nin;
+	double * w;
+	mxArray * out;
+
+	dims[0] = nlayers;
+	dims[1] = mexMaxNeurons(neurons,nlayers);
+	dims[2] = mexWidth(neurons,nlayers,ninputs);
+	out = mxCreateNumericArray(3,dims,mxDOUBLE_CLASS,mxREAL);
+	w = mxGetPr(out);
+
+	for(layer=0; layer<nlayers; layer++)
+	{
+		nin = layer ? neurons[layer-1] : ninputs;
+		for(neuron=0; neuron<neurons[layer]; neuron++)
+		{
+			for(weight=0; weight<=nin; weight++)
+			{
+				w[layer + neuron*dims[0] + weight*dims[0]*dims[1]] = \
+				weights[layer][neuron][weight];
+			}
+		}
+	}
+
+	return out;
+}
+
+/* Weights from Matlab */
+double *** mexWeightsIn(const mxArray * w, int * neurons, int nlayers, \
+int ninputs)
+{
+	const mwSize * dims = mxGetDimensions(w);
+	mwSize d2 = mxGetNumberOfDimensions(w) > 2 ? dims[2] : 1;
+	int layer;
+	int neuron;
+	int weight;
+	int nin;
+	double * src = mxGetPr(w);
+	double *** weights;
+
+	/* Every neuron must fit in the array */
+	for(layer=0; layer<nlayers; layer++)
+	{
+		nin = layer ? neurons[layer-1] : ninputs;
+		if(dims[0] < (mwSize) nlayers || dims[1] < (mwSize) neurons[layer] \
+		|| d2 < (mwSize) nin+1)
+			return NULL;
+	}
+
+	weights = weightsAlloc(neurons,nlayers,ninputs);
+	if(weights == NULL)
+		return NULL;
+
+	for(layer=0; layer<nlayers; layer++)
+	{
+		nin = layer ? neurons[layer-1] : ninputs;
+		for(neuron=0; neuron<neurons[layer]; neuron++)
+		{
+			for(weight=0; weight<=nin; weight++)
+			{
+				weights[layer][neuron][weight] = \
+				src[layer + neuron*dims[0] + weight*dims[0]*dims[1]];
+			}
+		}
+	}
+
+	return weights;
+}
+
+/* Random weights in [0,1] by rand of Octave/Matlab, in the array of
+ * trainingMLP.m, so the seed of rand gives the same initial weights
+ */
+double *** mexWeightsRand(int * neurons, int nlayers, int ninputs)
+{
+	mxArray * dims[3];
+	mxArray * w;
+	double *** weights;
+
+	dims[0] = mxCreateDoubleScalar(nlayers);
+	dims[1] = mxCreateDoubleScalar(mexMaxNeurons(neurons,nlayers));
+	dims[2] = mxCreateDoubleScalar(mexWidth(neurons,nlayers,ninputs));
+	mexCallMATLAB(1,&w,3,dims,"rand");
+	weights = mexWeightsIn(w,neurons,nlayers,ninputs);
+
+	mxDestroyArray(w);
+	mxDestroyArray(dims[0]);
+	mxDestroyArray(dims[1]);
+	mxDestroyArray(dims[2]);
+	return weights;
+}
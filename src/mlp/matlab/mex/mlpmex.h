@@ -0,0 +1,57 @@
+/* MLP MEX Gateway
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MLP_MEX_H
+#define _MLP_MEX_H
+
+#include "mex.h"
+#include "../../c/mlp.h"
+
+/* Row pointers over a row-major copy of an examples X columns matrix of
+ * Matlab (column-major), one block freed by mxFree
+ */
+double ** mexRows(const mxArray * m);
+
+/* Integer vector of a Matlab vector, freed by mxFree */
+int * mexInts(const mxArray * m);
+
+/* Copy the weights to the Matlab format of trainingMLP.m:
+ * layers X max(neurons) X max(neurons,inputs)+1
+ */
+mxArray * mexWeightsOut(double *** weights, int * neurons, int nlayers, \
+int ninputs);
+
+/* Weights from the Matlab format, NULL with a smaller array */
+double *** mexWeightsIn(const mxArray * w, int * neurons, int nlayers, \
+int ninputs);
+
+/* Random weights of rand(layers,max(neurons),max(neurons,inputs)+1),
+ * the initial weights of trainingMLP.m with the same seed of rand
+ */
+double *** mexWeightsRand(int * neurons, int nlayers, int ninputs);
+
+#endif /* _MLP_MEX_H */
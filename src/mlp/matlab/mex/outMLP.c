@@ -0,0 +1,89 @@
+/* MLP MEX Gateway
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* [O] = outMLP(neurons,bias,input,w)
+ * Same arguments and result of nlayers/outMLP.m, with 'input' of one or
+ * more examples by row computed in batch by the C library, O has one
+ * row by example.
+ */
+
+#include "mlpmex.h"
+
+void mexFunction(int nlhs, mxArray * plhs[], int nrhs, \
+const mxArray * prhs[])
+{
+	training tr;
+	double *** weights;
+	double ** in;
+	double ** out;
+	double * o;
+	int e;
+	int j;
+	int outs;
+
+	if(nrhs != 4)
+		mexErrMsgIdAndTxt("MLP:outMLP","Usage: O = outMLP(neurons,bias,input,w)");
+
+	memset(&tr,0,sizeof(training));
+	tr.nlayers = (int) mxGetNumberOfElements(prhs[0]);
+	tr.examples = (int) mxGetM(prhs[2]);
+	tr.ninputs = (int) mxGetN(prhs[2]);
+	if(tr.nlayers < 1 || \
+	mxGetNumberOfElements(prhs[1]) < (size_t) tr.nlayers || \
+	!mxIsDouble(prhs[2]) || !mxIsDouble(prhs[3]))
+		mexErrMsgIdAndTxt("MLP:outMLP","neurons and bias with different sizes");
+	tr.neurons = mexInts(prhs[0]);
+	tr.bias = mxGetPr(prhs[1]);
+	outs = tr.neurons[tr.nlayers-1];
+
+	weights = mexWeightsIn(prhs[3],tr.neurons,tr.nlayers,tr.ninputs);
+	if(weights == NULL)
+		mexErrMsgIdAndTxt("MLP:outMLP","w is smaller than the MLP");
+
+	in = mexRows(prhs[2]);
+	out = (double**) mxMalloc(sizeof(double*)*tr.examples + 1);
+	plhs[0] = mxCreateDoubleMatrix(tr.examples,outs,mxREAL);
+	o = mxGetPr(plhs[0]);
+	for(e=0; e<tr.examples; e++)
+		out[e] = (double*) mxMalloc(sizeof(double)*outs);
+
+	outMLPBatch(weights,&tr,"sigmoid",in,0,tr.examples,out);
+
+	/* Column-major result */
+	for(e=0; e<tr.examples; e++)
+	{
+		for(j=0; j<outs; j++)
+			o[e + j*tr.examples] = out[e][j];
+		mxFree(out[e]);
+	}
+
+	weightsFree(weights,tr.neurons,tr.nlayers);
+	mxFree(out);
+	mxFree(in);
+	mxFree(tr.neurons);
+	(void) nlhs;
+}
@@ -0,0 +1,107 @@
+%% Test of the MEX gateways against nlayers/*.m on a fixed seed of rand.
+% Run in this directory after build, with GNU Octave or Matlab: the MEX
+% trainingMLP and outMLP must give the weights and outputs of
+% nlayers/trainingMLP.m and nlayers/outMLP.m, an error otherwise.
+
+% % Copyright (c) 2015, Augusto Damasceno.
+% % All rights reserved.
+% % Redistribution and use in source and binary forms, with or without modification,
+% % are permitted provided that the following conditions are met:
+% %   1. Redistributions of source code must retain the above copyright notice,
+% %      this list of conditions and the following disclaimer.
+% %   2. Redistributions in binary form must reproduce the above copyright notice,
+% %      this list of conditions and the following disclaimer in the documentation
+% %      and/or other materials provided with the distribution.
+% % THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+% % ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+% % WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+% % IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+% % INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+% % BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+% % OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+% % WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+% % ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+% % OF SUCH DAMAGE.
+
+here = pwd;
+nl = fullfile(here,'..','nlayers');
+tol = 1e-10;
+failed = 0;
+
+neurons = [3 2 1];
+bias = [1 1 1];
+layers = numel(neurons);
+
+%% trainingMLP: one example keeps the same order of examples.
+% Same initial weights by the seed, 5 updates with momentum.
+x = [0 1];
+yref = 1;
+rand('state',42);
+cd(nl);
+Wm = trainingMLP(neurons,0.5,bias,x,yref,0.3,0,5);
+cd(here);
+rand('state',42);
+Wc = trainingMLP(neurons,0.5,bias,x,yref,0.3,0,5);
+
+% Weights of the MLP in the arrays, the others are not used.
+used = false(size(Wc));
+nin = numel(x);
+for k=1:layers
+    used(k,1:neurons(k),1:(nin+1)) = true;
+    nin = neurons(k);
+end
+d = max(abs(Wm(used) - Wc(used)));
+fprintf('trainingMLP: max |W(m) - W(mex)| = %.3e\n',d);
+if ~(d < tol)
+    failed = failed + 1;
+end
+
+%% outMLP of the weights of nlayers/trainingMLP.m.
+Oc = outMLP(neurons,bias,x,Wm);
+cd(nl);
+Om = outMLP(neurons,bias,x,Wm);
+cd(here);
+d = max(abs(Om - Oc));
+fprintf('outMLP: max |O(m) - O(mex)| = %.3e\n',d);
+if ~(d < tol)
+    failed = failed + 1;
+end
+
+%% XOR: the weights of the MEX work in nlayers/outMLP.m.
+x = [0 0; 0 1; 1 0; 1 1];
+yref = [0; 1; 1; 0];
+rand('state',7);
+[Wc,Ec] = trainingMLP(neurons,0.1,bias,x,yref,0.5,1e-3,4000);
+Oc = outMLP(neurons,bias,x,Wc);
+cd(nl);
+Om = zeros(size(Oc));
+for e=1:size(x,1)
+    Om(e,:) = outMLP(neurons,bias,x(e,:),Wc);
+end
+cd(here);
+d = max(abs(Om - Oc));
+fprintf('XOR outMLP: max |O(m) - O(mex)| = %.3e\n',d);
+if ~(d < tol)
+    failed = failed + 1;
+end
+
+% E is the MSE of the weights at the end of the last epoch.
+d = abs(Ec - mean(mean((yref - Oc).^2)));
+fprintf('XOR trainingMLP: |E - MSE(O(mex))| = %.3e\n',d);
+if ~(d < tol)
+    failed = failed + 1;
+end
+
+% The seed of rand repeats the training.
+rand('state',7);
+Wr = trainingMLP(neurons,0.1,bias,x,yref,0.5,1e-3,4000);
+d = max(abs(Wr(:) - Wc(:)));
+fprintf('XOR trainingMLP: same seed, max |W1 - W2| = %.3e\n',d);
+if d ~= 0
+    failed = failed + 1;
+end
+
+if failed
+    error('MLP:testMLP','%d of 5 tests failed',failed);
+end
+disp('All tests passed.');
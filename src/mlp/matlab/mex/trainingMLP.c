@@ -0,0 +1,122 @@
+/* MLP MEX Gateway
+ *
+ * Copyright (c) 2016, Augusto Damasceno.
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* [W,E] = trainingMLP(neurons,a,bias,x,yref,lr,error,maxIt)
+ * Same arguments and results of nlayers/trainingMLP.m, trained by the
+ * C library. The history of MSE is set in 'mse_hist' of the base
+ * workspace. E and mse_hist are the MSE of the weights at the end of
+ * each epoch, nlayers/trainingMLP.m uses the outputs of the examples
+ * during the epoch: the same weights give different values, and the
+ * stop by 'error' can happen in another epoch.
+ */
+
+#include "mlpmex.h"
+
+void mexFunction(int nlhs, mxArray * plhs[], int nrhs, \
+const mxArray * prhs[])
+{
+	training tr;
+	double *** weights;
+	double * hist;
+	double * h;
+	long int i;
+	long int n;
+	mxArray * mseHist;
+	mxArray * seed;
+
+	if(nrhs != 8)
+	{
+		mexErrMsgIdAndTxt("MLP:trainingMLP", \
+		"Usage: [W,E] = trainingMLP(neurons,a,bias,x,yref,lr,error,maxIt)");
+	}
+
+	memset(&tr,0,sizeof(training));
+	tr.nlayers = (int) mxGetNumberOfElements(prhs[0]);
+	tr.alpha = mxGetScalar(prhs[1]);
+	tr.examples = (int) mxGetM(prhs[3]);
+	tr.ninputs = (int) mxGetN(prhs[3]);
+	tr.lrate = mxGetScalar(prhs[5]);
+	tr.acceptedError = mxGetScalar(prhs[6]);
+	tr.maxIteration = (long int) mxGetScalar(prhs[7]);
+	if(tr.nlayers < 1 || \
+	mxGetNumberOfElements(prhs[2]) < (size_t) tr.nlayers || \
+	!mxIsDouble(prhs[3]) || !mxIsDouble(prhs[4]) || \
+	mxGetM(prhs[4]) != (size_t) tr.examples)
+	{
+		mexErrMsgIdAndTxt("MLP:trainingMLP", \
+		"neurons, bias, x and yref with different sizes");
+	}
+	tr.neurons = mexInts(prhs[0]);
+	tr.bias = mxGetPr(prhs[2]);
+	if(mxGetN(prhs[4]) != (size_t) tr.neurons[tr.nlayers-1])
+	{
+		mexErrMsgIdAndTxt("MLP:trainingMLP", \
+		"yref must have one column by neuron of the last layer");
+	}
+
+	/* Examples by row, like the rows of the C library */
+	tr.x = mexRows(prhs[3]);
+	tr.reference = mexRows(prhs[4]);
+
+	/* Random weights of trainingMLP.m, the order of the examples
+	 * seeded by rand too: a seed of rand repeats the training
+	 */
+	weights = mexWeightsRand(tr.neurons,tr.nlayers,tr.ninputs);
+	if(weights == NULL)
+		mexErrMsgIdAndTxt("MLP:trainingMLP","Memory error");
+	mexCallMATLAB(1,&seed,0,NULL,"rand");
+	srand((unsigned int) (mxGetScalar(seed)*RAND_MAX));
+	mxDestroyArray(seed);
+
+	hist = trainingMLP(weights,&tr,"sigmoid");
+	if(hist == NULL)
+	{
+		weightsFree(weights,tr.neurons,tr.nlayers);
+		mexErrMsgIdAndTxt("MLP:trainingMLP","Memory error");
+	}
+
+	plhs[0] = mexWeightsOut(weights,tr.neurons,tr.nlayers,tr.ninputs);
+	if(nlhs > 1)
+	{
+		n = (long int) hist[0];
+		plhs[1] = mxCreateDoubleScalar(n > 0 ? hist[n] : mxGetInf());
+	}
+
+	n = (long int) hist[0];
+	mseHist = mxCreateDoubleMatrix(n,1,mxREAL);
+	h = mxGetPr(mseHist);
+	for(i=0; i<n; i++)
+		h[i] = hist[i+1];
+	mexPutVariable("base","mse_hist",mseHist);
+	mxDestroyArray(mseHist);
+
+	free(hist);
+	weightsFree(weights,tr.neurons,tr.nlayers);
+	mxFree(tr.neurons);
+	mxFree(tr.x);
+	mxFree(tr.reference);
+}
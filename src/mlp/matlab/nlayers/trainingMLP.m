@@ -167,13 +167,13 @@ while (mse > error && counter < maxIt)
     clear w;
     clear wPast;
     % Copy weights of first layer from memory of weights.
-    w(1:neurons(1),1:nInputs+1) = wm(k,1:neurons(1),1:nInputs+1);
+    w(1:neurons(1),1:nInputs+1) = wm(1,1:neurons(1),1:nInputs+1);
     % Copy past weights of first layer from memory of past weights.
     wPast(1:neurons(1),1:nInputs+1) = wmPast(1,1:neurons(1),1:nInputs+1);
     % Save weights before update.
     wtmp = w;
     % Update first layer.
-    w = w + a*wPast + lr*Gs'*[bias(k) x(xidx(ex),:)];
+    w = w + a*wPast + lr*Gs'*[bias(1) x(xidx(ex),:)];
     % Save new weights of first layer.
     wm(1,1:neurons(1),1:nInputs+1) = w;
     % Save weights before update to memory of past weights.
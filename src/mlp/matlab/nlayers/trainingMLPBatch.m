@@ -0,0 +1,135 @@
+%% n-Layer Multilayer Perceptron Batch Training.
+% [W,E] = trainingMLPBatch(neurons,a,bias,x,yref,lr,error,maxIt,batch)
+
+% % Copyright (c) 2015, Augusto Damasceno.
+% % All rights reserved.
+% % Redistribution and use in source and binary forms, with or without modification,
+% % are permitted provided that the following conditions are met:
+% %   1. Redistributions of source code must retain the above copyright notice,
+% %      this list of conditions and the following disclaimer.
+% %   2. Redistributions in binary form must reproduce the above copyright notice,
+% %      this list of conditions and the following disclaimer in the documentation
+% %      and/or other materials provided with the distribution.
+% % THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+% % ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+% % WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+% % IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+% % INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+% % BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+% % OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+% % WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+% % ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+% % OF SUCH DAMAGE.
+
+function [W,E] = trainingMLPBatch(neurons,a,bias,x,yref,lr,error,maxIt,batch)
+%% n-Layer Multilayer Perceptron Batch Training.
+
+% neurons = 1 X layers.
+% a = momentum constant.
+% bias(layer) = 1 X layers.
+% x = examples X inputs.
+% yref = examples X desired outputs.
+% lr = learning-rate.
+% error = acceptable error.
+% maxIt = maximum iteration (examples).
+% batch = examples by mini-batch, all examples if omitted.
+% W{layer} = neurons(layer) X (inputs of the layer + 1).
+
+%% Configuration and architecture.
+
+layers = numel(neurons);
+[examples,nInputs] = size(x);
+if nargin < 9
+    batch = examples;
+end
+
+% Weights and past updates of each layer, exactly sized.
+W = cell(layers,1);
+dW = cell(layers,1);
+nIn = nInputs;
+for k=1:layers
+    W{k} = rand(neurons(k),nIn+1);
+    dW{k} = zeros(neurons(k),nIn+1);
+    nIn = neurons(k);
+end
+
+% Outs of each layer for a mini-batch.
+Y = cell(layers,1);
+
+%% Training.
+
+counter = 0;
+epoch = 0;
+displayStep = max(1,ceil(0.05*maxIt/examples));
+
+% Mean Square Error.
+mse = +Inf;
+
+% Memory of Mean Square Error.
+mse_hist = zeros(ceil(maxIt/examples),1);
+
+while (mse > error && counter < maxIt)
+
+    % Random order of inputs - desired outputs.
+    xidx = randperm(examples);
+
+    for first=1:batch:examples
+        idx = xidx(first:min(first+batch-1,examples));
+        n = numel(idx);
+
+        % Propagation of the mini-batch, one row by example.
+        ypre = x(idx,:);
+        for k=1:layers
+            Y{k} = sigmoid([repmat(bias(k),n,1) ypre]*W{k}',1);
+            ypre = Y{k};
+        end
+
+        % Backpropagation.
+
+        % Local gradient. Last layer = Error * df.
+        Gs = (yref(idx,:) - Y{layers}).*Y{layers}.*(1-Y{layers});
+        for k=layers:-1:1
+            if k > 1
+                ypre = Y{k-1};
+            else
+                ypre = x(idx,:);
+            end
+            % Sum of the updates of the examples.
+            step = Gs'*[repmat(bias(k),n,1) ypre];
+            % Local gradient of the previous layer with the weights
+            % before the update.
+            if k > 1
+                Gs = (Gs*W{k}(:,2:end)).*ypre.*(1-ypre);
+            end
+            % Update with momentum: mean of the mini-batch + a*past update.
+            dW{k} = lr*step/n + a*dW{k};
+            W{k} = W{k} + dW{k};
+        end
+
+        counter = counter + n;
+        if counter >= maxIt
+            break;
+        end
+    end
+
+    % Mean Square Error of all examples.
+    mse = mseb(outMLPBatch(neurons,bias,x,W),yref);
+    epoch = epoch + 1;
+    mse_hist(epoch) = mse;
+
+    % Display the progress.
+    if mod(epoch,displayStep) == 0
+        message = sprintf('%.2f%% of maximum iteration.\n',(counter*100)/maxIt);
+        disp(message);
+        message = sprintf('MSE: %.4e\n',mse);
+        disp(message);
+        drawnow();
+    end
+end
+
+fprintf('\nTotal Iterations: %d\nError: %.4e\n',counter,mse);
+
+assignin('base','mse_hist',mse_hist(1:epoch));
+
+E = mse;
+end